@@ -0,0 +1,50 @@
+"""
+Pre-compresses web assets in data/ before the LittleFS image is built.
+
+For every compressible file (html, js, css, ...) a sibling <name>.gz is
+written when it is missing or older than the source. The web server sends
+the .gz with Content-Encoding: gzip to clients that accept it and falls
+back to the plain file otherwise. Berry scripts are read by the VM and are
+left alone.
+
+Runs as a PlatformIO pre-script, or standalone: python gzip_data.py [dir]
+"""
+import gzip
+import os
+import shutil
+import sys
+
+COMPRESSIBLE = (".html", ".htm", ".js", ".css", ".json", ".svg", ".txt", ".ico", ".map")
+MIN_SIZE = 256  # smaller files don't gain anything over the header overhead
+
+
+def gzip_tree(data_dir):
+    written = 0
+    for root, _dirs, files in os.walk(data_dir):
+        for name in files:
+            if not name.endswith(COMPRESSIBLE):
+                continue
+            src = os.path.join(root, name)
+            dst = src + ".gz"
+            if os.path.getsize(src) < MIN_SIZE:
+                continue
+            if os.path.isfile(dst) and os.path.getmtime(dst) >= os.path.getmtime(src):
+                continue
+            # mtime=0 keeps the output byte-identical across rebuilds
+            with open(src, "rb") as fin, open(dst, "wb") as raw:
+                with gzip.GzipFile(filename="", mode="wb", fileobj=raw, compresslevel=9, mtime=0) as fout:
+                    shutil.copyfileobj(fin, fout)
+            print("gzip: %s (%d -> %d bytes)" % (os.path.relpath(src, data_dir), os.path.getsize(src),
+                                                  os.path.getsize(dst)))
+            written += 1
+    return written
+
+
+try:
+    Import("env")  # noqa: F821 (provided by SCons)
+    data_dir = env.subst("$PROJECT_DATA_DIR")  # noqa: F821
+except NameError:
+    data_dir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), "data")
+
+if os.path.isdir(data_dir):
+    gzip_tree(data_dir)
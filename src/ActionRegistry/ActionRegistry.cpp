@@ -2,46 +2,238 @@
 
 ActionRegistry *actionRegistryInstance = new ActionRegistry();
 
+// 0.1 ms to 5 s
+static const uint32_t ACTION_DURATION_US[] = {100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000};
+
+#define ACTION_DURATION(transport)                                                                                     \
+    {"action_duration_seconds", "Time spent in action handlers", "transport=\"" transport "\"", ACTION_DURATION_US,    \
+     1e-6}
+
+// Indexed by Transport
+static Histogram s_actionDuration[] = {ACTION_DURATION("cli"), ACTION_DURATION("rest"), ACTION_DURATION("ws"),
+                                       ACTION_DURATION("scripting")};
+
+Histogram &actionDuration(Transport transport)
+{
+    return s_actionDuration[(size_t)transport];
+}
+
+void ActionRegistry::executeBatch(const CommandBatch &batch, Transport transport, JsonWriter &out)
+{
+    const std::vector<CommandArgs> &commands = batch.commands;
+    size_t executed = 0;
+    size_t failed = 0;
+    bool stopped = false;
+
+    auto onUiTask = [&](const CommandArgs &args)
+    {
+        FeatureAction *action = findAction(args);
+        return action != nullptr && action->uiTask && isTransportEnabled(action, transport);
+    };
+
+    // Handlers signal failure with an "error" field; an unknown action fails too
+    auto isFailure = [&](const CommandArgs &args, const BatchResultShape &shape)
+    { return shape.failed || findAction(args) == nullptr; };
+
+    // Writes one result as soon as it is known, returns false once a failure ends the batch.
+    // Results that are not JSON are passed on as a string.
+    auto emit = [&](const CommandArgs &args, const std::string &text)
+    {
+        BatchResultShape shape = inspectBatchResult(text);
+        if (shape.json)
+            out.raw(text);
+        else
+            out.value(text);
+        executed++;
+        bool fail = isFailure(args, shape);
+        failed += fail;
+        return !(fail && batch.stopOnError);
+    };
+
+    out.beginObject().key("results").beginArray();
+    size_t i = 0;
+    while (i < commands.size() && !stopped)
+    {
+        if (_uiTaskRunner != nullptr && onUiTask(commands[i]))
+        {
+            // the handlers' own hops run inline once on the UI task; their (small)
+            // results are written afterwards, so a slow client never stalls the UI task
+            size_t end = i + 1;
+            while (end < commands.size() && onUiTask(commands[end]))
+                end++;
+            std::vector<std::string> texts;
+            texts.reserve(end - i);
+            _uiTaskRunner(
+                [&]()
+                {
+                    for (size_t j = i; j < end; j++)
+                    {
+                        texts.push_back(execute(commands[j], transport));
+                        if (batch.stopOnError && isFailure(commands[j], inspectBatchResult(texts.back())))
+                            break;
+                    }
+                });
+            for (size_t j = 0; j < texts.size() && !stopped; j++)
+                stopped = !emit(commands[i + j], texts[j]);
+            i = end;
+        }
+        else
+        {
+            stopped = !emit(commands[i], execute(commands[i], transport));
+            i++;
+        }
+    }
+
+    out.endArray()
+        .field("executed", executed)
+        .field("failed", failed)
+        .field("skipped", commands.size() - executed)
+        .endObject();
+}
+
 #if ENABLE_WEBSERVER
 
 #include "../mime.h"
 
 #include "../services/WebServer.h"
+#include "../services/HttpWorkers.h"
+#include "RestArgs.h"
 
-static esp_err_t actionRestHandler(httpd_req_t *req)
+static esp_err_t sendRestError(httpd_req_t *req, const char *status, const std::string &message)
 {
-    FeatureAction *action = static_cast<FeatureAction *>(req->user_ctx);
-    std::string result = action->handler(action->name);
+    std::string body =
+        JsonWriter::toString([&](JsonWriter &out) { out.beginObject().field("error", message).endObject(); });
+    httpd_resp_set_status(req, status);
     httpd_resp_set_type(req, MIME_JSON);
+    return httpd_resp_send(req, body.c_str(), body.length());
+}
+
+// Reads up to len bytes of the body, -1 if the connection failed
+static int recvBody(httpd_req_t *req, char *buf, size_t len)
+{
+    while (true)
+    {
+        int received = httpd_req_recv(req, buf, len);
+        if (received != HTTPD_SOCK_ERR_TIMEOUT)
+            return received < 0 ? -1 : received;
+    }
+}
+
+static bool recvWholeBody(httpd_req_t *req, std::string &body)
+{
+    body.resize(req->content_len);
+    for (size_t done = 0; done < body.size();)
+    {
+        int received = recvBody(req, &body[done], body.size() - done);
+        if (received <= 0)
+            return false;
+        done += received;
+    }
+    return true;
+}
+
+// The query string and body become the words after the action name, see
+// RestArgs.h. A body for a bodyHandler is left unread for the handler.
+static esp_err_t runRestAction(httpd_req_t *req)
+{
+    FeatureAction *action = static_cast<FeatureAction *>(req->user_ctx);
+    std::string command = action->name;
+
+    size_t queryLen = httpd_req_get_url_query_len(req);
+    if (queryLen > 0)
+    {
+        std::string query(queryLen + 1, '\0');
+        httpd_req_get_url_query_str(req, &query[0], query.size());
+        query.resize(queryLen);
+        appendQueryArgs(command, query);
+    }
+
+    bool streamBody = action->bodyHandler != nullptr && req->content_len > 0;
+    if (req->content_len > 0 && !streamBody)
+    {
+        if (req->content_len > REST_BODY_MAX)
+            return sendRestError(req, "413 Payload Too Large", "Request body too large");
+        std::string body;
+        std::string error;
+        if (!recvWholeBody(req, body))
+            return ESP_FAIL;
+        if (!appendBodyArgs(command, getRequestHeader(req, "Content-Type"), body, error))
+            return sendRestError(req, "400 Bad Request", error);
+    }
+
+    CommandArgs args(std::move(command));
+    WireFormat format = acceptedWireFormat(req);
+    httpd_resp_set_type(req, format == WireFormat::CBOR ? MIME_CBOR : MIME_JSON);
+    if (streamBody)
+    {
+        size_t remaining = req->content_len;
+        RequestBody body = {req->content_len, [req, &remaining](char *buf, size_t len)
+                            {
+                                if (remaining == 0)
+                                    return 0;
+                                int received = recvBody(req, buf, len < remaining ? len : remaining);
+                                if (received > 0)
+                                    remaining -= received;
+                                return received == 0 ? -1 : received;
+                            }};
+        JsonWriter out(httpdChunkSink(req), JSON_BUFFER_SIZE, format);
+        {
+            ActionTimer timer(Transport::REST);
+            action->bodyHandler(args, body, out);
+        }
+        return out.finish() ? ESP_OK : ESP_FAIL;
+    }
+    if (action->streamHandler != nullptr || format == WireFormat::CBOR)
+    {
+        JsonWriter out(httpdChunkSink(req), JSON_BUFFER_SIZE, format);
+        actionRegistryInstance->executeStream(args, Transport::REST, out);
+        return out.finish() ? ESP_OK : ESP_FAIL;
+    }
+    std::string result;
+    {
+        ActionTimer timer(Transport::REST);
+        result = action->handler(args);
+    }
     return httpd_resp_send(req, result.c_str(), HTTPD_RESP_USE_STRLEN);
 }
 
+static esp_err_t actionRestHandler(httpd_req_t *req)
+{
+    FeatureAction *action = static_cast<FeatureAction *>(req->user_ctx);
+    if (action->async)
+    {
+        return httpdRunAsync(req, runRestAction);
+    }
+    return runRestAction(req);
+}
+
 void ActionRegistry::wireRestEndpoints()
 {
     httpd_handle_t server = getHttpServer();
     if (!server)
         return;
 
-    for (uint8_t i = 0; i < _registeredActionsCount; i++)
-    {
-        FeatureAction *action = _actions[i];
-        if (!action->transports.rest)
-            continue;
+    _actions.forEach(
+        [server](FeatureAction *action)
+        {
+            if (!action->transports.rest)
+                return;
 
-        std::string pathStr = "/" + action->name;
-        char *uri = strdup(pathStr.c_str());
+            std::string pathStr = "/" + action->name;
+            char *uri = strdup(pathStr.c_str());
 
-        httpd_method_t method = HTTP_GET;
-        if (action->type == "POST")
-            method = HTTP_POST;
-        else if (action->type == "PUT")
-            method = HTTP_PUT;
-        else if (action->type == "DELETE")
-            method = HTTP_DELETE;
+            httpd_method_t method = HTTP_GET;
+            if (action->type == "POST")
+                method = HTTP_POST;
+            else if (action->type == "PUT")
+                method = HTTP_PUT;
+            else if (action->type == "DELETE")
+                method = HTTP_DELETE;
 
-        const httpd_uri_t uriHandler = {.uri = uri, .method = method, .handler = actionRestHandler, .user_ctx = action};
-        httpd_register_uri_handler(server, &uriHandler);
-    }
+            const httpd_uri_t uriHandler = {
+                .uri = uri, .method = method, .handler = actionRestHandler, .user_ctx = action};
+            httpd_register_uri_handler(server, &uriHandler);
+        });
 }
 
 #endif // ENABLE_WEBSERVER
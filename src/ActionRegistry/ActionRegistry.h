@@ -2,21 +2,67 @@
 
 #include <cstdint>
 #include "esp_log.h"
-#include <mutex>
+#include "esp_timer.h"
+#include <functional>
 #include <string>
 #include "../config.h"
+#include "ActionTable.h"
 #include "FeatureAction.h"
-#include "../CommandInterpreter/CommandParser.h"
+#include "CommandBatch.h"
+#include "../CommandInterpreter/CommandArgs.h"
+#include "../utils/Metrics.h"
 #include "../utils/StringUtil.h"
 
-#define ACTIONS_SIZE 24
+// action_duration_seconds of one transport; its count is the number of runs
+Histogram &actionDuration(Transport transport);
+
+// Records one handler run, the lifetime of the scope, in actionDuration()
+class ActionTimer
+{
+public:
+    explicit ActionTimer(Transport transport) : _transport(transport), _start(esp_timer_get_time())
+    {
+    }
+
+    ~ActionTimer()
+    {
+        if (!_cancelled)
+            actionDuration(_transport).observe(esp_timer_get_time() - _start);
+    }
+
+    // The handler declined and another one produces the result; that one is timed instead
+    void cancel()
+    {
+        _cancelled = true;
+    }
+
+private:
+    Transport _transport;
+    int64_t _start;
+    bool _cancelled = false;
+};
+
+// Runs fn on another task and waits for it to finish
+using ActionTaskRunner = void (*)(const std::function<void()> &fn);
 
 class ActionRegistry
 {
 private:
-    uint8_t _registeredActionsCount = 0;
-    FeatureAction *_actions[ACTIONS_SIZE] = {};
-    std::mutex _mutex;
+    ActionTable<FeatureAction> _actions;
+    ActionTaskRunner _uiTaskRunner = nullptr;
+
+    // The command name is the first word; the lookup takes no lock
+    FeatureAction *findAction(const CommandArgs &args) const
+    {
+        std::string_view name = args.name();
+        return _actions.findName(name.data(), name.size());
+    }
+
+    std::string unknownActionResponse(const CommandArgs &args, Transport transport) const
+    {
+        return "{\"message\": \"Unknown action: " + args.str(0) + ".\", \"availableActions\": \"" +
+               getAvailableActions(transport) + "\"}";
+    }
 
     bool isTransportEnabled(const FeatureAction *action, Transport transport) const
     {
@@ -37,53 +83,129 @@ private:
 public:
     void registerAction(FeatureAction *action)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
-        if (_registeredActionsCount >= ACTIONS_SIZE)
+        if (!_actions.insert(action))
         {
-            ESP_LOGE("ActionRegistry", "Action registry full, cannot register");
-            return;
+            ESP_LOGE("ActionRegistry", "Action %s already registered", action->name.c_str());
         }
-        _actions[_registeredActionsCount] = action;
-        _registeredActionsCount++;
+    }
+
+    // The command is split into words once here and handed to the handler as
+    // CommandArgs; the overloads taking a string are for callers that have not
+    // parsed it yet.
+    std::string execute(const CommandArgs &args, Transport transport)
+    {
+        FeatureAction *action = findAction(args);
+        if (action == nullptr)
+        {
+            return unknownActionResponse(args, transport);
+        }
+        if (!isTransportEnabled(action, transport))
+        {
+            return "{\"error\": \"Action '" + action->name + "' not available on this transport\"}";
+        }
+        ActionTimer timer(transport);
+        return action->handler(args);
     }
 
     std::string execute(const std::string &command, Transport transport)
     {
-        ActionHandler handler = nullptr;
+        return execute(CommandArgs(command), transport);
+    }
+
+    // Same as execute(), but returns the result as a cJSON tree owned by the
+    // caller. Actions with an objectHandler skip the print/parse round-trip.
+    cJSON *executeObject(const CommandArgs &args, Transport transport)
+    {
+        FeatureAction *action = findAction(args);
+        if (action != nullptr && action->objectHandler != nullptr && isTransportEnabled(action, transport))
         {
-            std::lock_guard<std::mutex> lock(_mutex);
-            for (uint8_t i = 0; i < _registeredActionsCount; i++)
+            ActionTimer timer(transport);
+            cJSON *result = action->objectHandler(args);
+            if (result != nullptr)
             {
-                const std::string &name = _actions[i]->name;
-                if (command == name || StringUtil::startsWith(command, name + " "))
-                {
-                    if (!isTransportEnabled(_actions[i], transport))
-                    {
-                        return "{\"error\": \"Action '" + name + "' not available on this transport\"}";
-                    }
-                    handler = _actions[i]->handler;
-                    break;
-                }
+                return result;
             }
+            timer.cancel(); // execute() below times the string handler
         }
-        if (handler != nullptr)
+
+        std::string text = execute(args, transport);
+        cJSON *parsed = cJSON_ParseWithLength(text.c_str(), text.length());
+        if (parsed == nullptr)
         {
-            return handler(command);
+            parsed = cJSON_CreateObject();
+            cJSON_AddStringToObject(parsed, "result", text.c_str());
         }
-        return "{\"message\": \"Unknown action: " + CommandParser::getCommandName(command) +
-               ".\", \"availableActions\": \"" + getAvailableActions(transport) + "\"}";
+        return parsed;
     }
 
-    std::string getAvailableActions(Transport transport) const
+    cJSON *executeObject(const std::string &command, Transport transport)
     {
-        std::string actions;
-        for (uint8_t i = 0; i < _registeredActionsCount; i++)
+        return executeObject(CommandArgs(command), transport);
+    }
+
+    // Same as execute(), but writes the result into out, in whichever format
+    // out encodes. Actions with a streamHandler never materialize the whole
+    // response; an objectHandler's tree is encoded without printing it first.
+    void executeStream(const CommandArgs &args, Transport transport, JsonWriter &out)
+    {
+        FeatureAction *action = findAction(args);
+        if (action != nullptr && isTransportEnabled(action, transport))
         {
-            if (isTransportEnabled(_actions[i], transport))
+            if (action->streamHandler != nullptr)
             {
-                actions += _actions[i]->name + ", ";
+                ActionTimer timer(transport);
+                action->streamHandler(args, out);
+                return;
+            }
+            if (action->objectHandler != nullptr)
+            {
+                ActionTimer timer(transport);
+                cJSON *result = action->objectHandler(args);
+                if (result != nullptr)
+                {
+                    out.value((const cJSON *)result);
+                    cJSON_Delete(result);
+                    return;
+                }
+                timer.cancel(); // execute() below times the string handler
             }
         }
+        out.raw(execute(args, transport));
+    }
+
+    void executeStream(const std::string &command, Transport transport, JsonWriter &out)
+    {
+        executeStream(CommandArgs(command), transport, out);
+    }
+
+    bool isAsync(const CommandArgs &args) const
+    {
+        FeatureAction *action = findAction(args);
+        return action != nullptr && action->async;
+    }
+
+    // Runs the commands in order and writes all results as one response:
+    // {"results": [...], "executed": n, "failed": n, "skipped": n}
+    void executeBatch(const CommandBatch &batch, Transport transport, JsonWriter &out);
+
+    // How batches reach the UI task, set by the UI feature. Consecutive
+    // uiTask actions in a batch then share one hop.
+    void setUiTaskRunner(ActionTaskRunner runner)
+    {
+        _uiTaskRunner = runner;
+    }
+
+    std::string getAvailableActions(Transport transport) const
+    {
+        std::string actions;
+        _actions.forEach(
+            [&](const FeatureAction *action)
+            {
+                if (isTransportEnabled(action, transport))
+                {
+                    actions += action->name + ", ";
+                }
+            });
         return actions;
     }
 
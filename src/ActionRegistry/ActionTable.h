@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Name lookup for the action registry: an open-addressing hash table that
+ * readers probe without taking a lock.
+ *
+ * Writers (registration, normally during setup) serialize on a mutex and fill
+ * empty slots in place. Once the table is half full, a copy twice the size is
+ * published instead. Replaced tables stay allocated until the registry is
+ * destroyed because a reader may still be probing one; with doubling they add
+ * up to less than the live table.
+ *
+ * T needs a std::string member `name`.
+ */
+template <typename T> class ActionTable
+{
+public:
+    ActionTable()
+    {
+        _tables.emplace_back(new Slots(16));
+        _current.store(_tables.back().get(), std::memory_order_release);
+    }
+
+    ActionTable(const ActionTable &) = delete;
+    ActionTable &operator=(const ActionTable &) = delete;
+
+    // Looks up the first word of command, i.e. everything up to the first space
+    T *find(const char *command, size_t len) const
+    {
+        const char *space = (const char *)memchr(command, ' ', len);
+        return findName(command, space ? (size_t)(space - command) : len);
+    }
+
+    T *find(const std::string &command) const
+    {
+        return find(command.data(), command.size());
+    }
+
+    T *findName(const char *name, size_t len) const
+    {
+        const Slots *table = _current.load(std::memory_order_acquire);
+        size_t mask = table->capacity - 1;
+        for (size_t i = hash(name, len) & mask;; i = (i + 1) & mask)
+        {
+            T *entry = table->slots[i].load(std::memory_order_acquire);
+            if (entry == nullptr)
+                return nullptr;
+            if (entry->name.size() == len && memcmp(entry->name.data(), name, len) == 0)
+                return entry;
+        }
+    }
+
+    // Returns false if an entry with the same name is already registered
+    bool insert(T *entry)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (findName(entry->name.data(), entry->name.size()) != nullptr)
+            return false;
+
+        Slots *table = _tables.back().get();
+        if ((_entries.size() + 1) * 2 > table->capacity)
+        {
+            Slots *bigger = new Slots(table->capacity * 2);
+            for (T *existing : _entries)
+                place(bigger, existing);
+            _tables.emplace_back(bigger);
+            table = bigger;
+            _current.store(table, std::memory_order_release);
+        }
+        place(table, entry);
+        _entries.push_back(entry);
+        return true;
+    }
+
+    // Calls fn for every entry in registration order
+    template <typename Fn> void forEach(Fn fn) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (T *entry : _entries)
+            fn(entry);
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _entries.size();
+    }
+
+private:
+    struct Slots
+    {
+        explicit Slots(size_t n) : capacity(n), slots(new std::atomic<T *>[n])
+        {
+            for (size_t i = 0; i < n; i++)
+                slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        size_t capacity; // power of two
+        std::unique_ptr<std::atomic<T *>[]> slots;
+    };
+
+    mutable std::mutex _mutex;
+    std::vector<std::unique_ptr<Slots>> _tables; // the last one is current
+    std::atomic<Slots *> _current{nullptr};
+    std::vector<T *> _entries;
+
+    // FNV-1a
+    static uint32_t hash(const char *s, size_t len)
+    {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; i++)
+            h = (h ^ (uint8_t)s[i]) * 16777619u;
+        return h;
+    }
+
+    static void place(Slots *table, T *entry)
+    {
+        size_t mask = table->capacity - 1;
+        size_t i = hash(entry->name.data(), entry->name.size()) & mask;
+        while (table->slots[i].load(std::memory_order_relaxed) != nullptr)
+            i = (i + 1) & mask;
+        table->slots[i].store(entry, std::memory_order_release);
+    }
+};
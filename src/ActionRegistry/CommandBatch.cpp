@@ -0,0 +1,50 @@
+#include "CommandBatch.h"
+#include "../utils/CJsonHelper.h"
+
+static bool parseJsonBatch(const std::string &text, CommandBatch &batch, std::string &error)
+{
+    CJsonPtr root(cJSON_ParseWithLength(text.c_str(), text.length()));
+    if (!root)
+    {
+        error = "Invalid batch JSON";
+        return false;
+    }
+
+    const cJSON *commands = root.get();
+    if (cJSON_IsObject(root.get()))
+    {
+        commands = cJSON_GetObjectItem(root.get(), "commands");
+        const cJSON *onError = cJSON_GetObjectItem(root.get(), "onError");
+        if (onError != nullptr && (!cJSON_IsString(onError) || !setBatchOnError(batch, onError->valuestring)))
+        {
+            error = "onError must be \"stop\" or \"continue\"";
+            return false;
+        }
+    }
+    if (!cJSON_IsArray(commands))
+    {
+        error = "Batch needs an array of commands";
+        return false;
+    }
+
+    const cJSON *command;
+    cJSON_ArrayForEach(command, commands)
+    {
+        if (!cJSON_IsString(command))
+        {
+            error = "Batch commands must be strings";
+            return false;
+        }
+        if (!addBatchCommand(batch, CommandArgs(command->valuestring), error))
+            return false;
+    }
+    return true;
+}
+
+bool parseCommandBatch(const std::string &text, CommandBatch &batch, std::string &error)
+{
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start != std::string::npos && (text[start] == '[' || text[start] == '{'))
+        return parseJsonBatch(text, batch, error);
+    return parseCommandLines(text, batch, error);
+}
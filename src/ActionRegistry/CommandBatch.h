@@ -0,0 +1,237 @@
+#pragma once
+
+#include <cctype>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../config.h"
+#include "../CommandInterpreter/CommandArgs.h"
+
+/**
+ * Several commands sent as one request and answered with one response. Accepted
+ * forms:
+ *
+ *     ["screen clear", "screen text 0 0 0xFFFF 0 2 \"Hi\""]
+ *     {"commands": ["page info", "info"], "onError": "continue"}
+ *
+ * or one command per line, headed by a "batch" line:
+ *
+ *     batch onError=continue
+ *     screen clear
+ *     page info
+ *
+ * With onError=stop (the default) the first failing command ends the batch.
+ * The header is what marks the line form: without it, text spanning several
+ * lines is a single command whose last argument holds the newlines (berry
+ * eval, write).
+ */
+struct CommandBatch
+{
+    std::vector<CommandArgs> commands;
+    bool stopOnError = true;
+};
+
+// A JSON array or envelope, or lines headed by "batch"
+inline bool isCommandBatch(const std::string &text)
+{
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos)
+        return false;
+    if (text[start] == '[' || text[start] == '{')
+        return true;
+    return text.compare(start, 5, "batch") == 0 &&
+           (start + 5 == text.size() || strchr(" \t\r\n", text[start + 5]) != nullptr);
+}
+
+inline bool setBatchOnError(CommandBatch &batch, const std::string &mode)
+{
+    if (mode == "stop")
+        batch.stopOnError = true;
+    else if (mode == "continue")
+        batch.stopOnError = false;
+    else
+        return false;
+    return true;
+}
+
+inline bool addBatchCommand(CommandBatch &batch, CommandArgs args, std::string &error)
+{
+    if (batch.commands.size() >= COMMAND_BATCH_MAX)
+    {
+        error = "Too many commands in batch, the limit is " + std::to_string(COMMAND_BATCH_MAX);
+        return false;
+    }
+    batch.commands.push_back(std::move(args));
+    return true;
+}
+
+// The one-command-per-line form
+inline bool parseCommandLines(const std::string &text, CommandBatch &batch, std::string &error)
+{
+    size_t pos = 0;
+    bool first = true;
+    while (pos < text.size())
+    {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string line = text.substr(pos, end - pos);
+        pos = end + 1;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        CommandArgs args(std::move(line));
+        if (args.size() == 0)
+            continue;
+        if (first && args.name() == "batch")
+        {
+            // batch [onError=stop|continue]
+            for (size_t i = 1; i < args.size(); i++)
+            {
+                std::string option = args.str(i);
+                if (option.compare(0, 8, "onError=") != 0 || !setBatchOnError(batch, option.substr(8)))
+                {
+                    error = "Invalid batch option: " + option;
+                    return false;
+                }
+            }
+            first = false;
+            continue;
+        }
+        first = false;
+        if (!addBatchCommand(batch, std::move(args), error))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * What executeBatch() needs to know about a handler's result text: whether it
+ * is JSON (otherwise it is sent as a string) and whether it is an object with
+ * a top-level "error" key, the handlers' way of reporting failure. The text is
+ * only scanned, never parsed into a tree.
+ */
+struct BatchResultShape
+{
+    bool json;
+    bool failed;
+};
+
+namespace BatchResultScan
+{
+// Nesting deeper than this is treated as not JSON rather than recursing on
+// a small task stack
+constexpr int MAX_DEPTH = 32;
+
+inline const char *skipSpace(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        p++;
+    return p;
+}
+
+// p is at the opening quote; returns the position after the closing one
+inline const char *string(const char *p, const char *end)
+{
+    for (p++; p < end; p++)
+    {
+        if (*p == '\\')
+            p++;
+        else if (*p == '"')
+            return p + 1;
+        else if ((unsigned char)*p < 0x20)
+            return nullptr;
+    }
+    return nullptr;
+}
+
+inline const char *literal(const char *p, const char *end, const char *word)
+{
+    for (; *word != '\0'; word++, p++)
+    {
+        if (p == end || *p != *word)
+            return nullptr;
+    }
+    return p;
+}
+
+// Returns the position after one JSON value, nullptr if there is none. With
+// errorKey set and the value an object, reports whether it has an "error" key.
+inline const char *value(const char *p, const char *end, int depth, bool *errorKey = nullptr)
+{
+    p = skipSpace(p, end);
+    if (p == end || depth > MAX_DEPTH)
+        return nullptr;
+    switch (*p)
+    {
+    case '"':
+        return string(p, end);
+    case 't':
+        return literal(p, end, "true");
+    case 'f':
+        return literal(p, end, "false");
+    case 'n':
+        return literal(p, end, "null");
+    case '{':
+    case '[':
+    {
+        bool isObject = *p == '{';
+        char close = isObject ? '}' : ']';
+        p = skipSpace(p + 1, end);
+        if (p < end && *p == close)
+            return p + 1;
+        while (true)
+        {
+            if (isObject)
+            {
+                p = skipSpace(p, end);
+                if (p == end || *p != '"')
+                    return nullptr;
+                const char *key = p;
+                p = string(p, end);
+                if (p == nullptr)
+                    return nullptr;
+                if (errorKey != nullptr && p - key == 7 && memcmp(key, "\"error\"", 7) == 0)
+                    *errorKey = true;
+                p = skipSpace(p, end);
+                if (p == end || *p != ':')
+                    return nullptr;
+                p++;
+            }
+            p = value(p, end, depth + 1);
+            if (p == nullptr)
+                return nullptr;
+            p = skipSpace(p, end);
+            if (p == end)
+                return nullptr;
+            if (*p == close)
+                return p + 1;
+            if (*p != ',')
+                return nullptr;
+            p++;
+        }
+    }
+    default:
+    {
+        const char *start = p;
+        while (p < end && (isdigit((unsigned char)*p) || *p == '-' || *p == '+' || *p == '.' || *p == 'e' ||
+                           *p == 'E'))
+            p++;
+        return p > start ? p : nullptr;
+    }
+    }
+}
+} // namespace BatchResultScan
+
+inline BatchResultShape inspectBatchResult(const std::string &text)
+{
+    const char *end = text.data() + text.size();
+    bool errorKey = false;
+    const char *p = BatchResultScan::value(text.data(), end, 0, &errorKey);
+    bool json = p != nullptr && BatchResultScan::skipSpace(p, end) == end;
+    return {json, json && errorKey};
+}
+
+// Any of the accepted forms; implemented in CommandBatch.cpp (the JSON forms
+// need cJSON)
+bool parseCommandBatch(const std::string &text, CommandBatch &batch, std::string &error);
@@ -2,6 +2,10 @@
 
 #include <string>
 #include <cstdint>
+#include <functional>
+#include "cJSON.h"
+#include "../utils/JsonWriter.h"
+#include "../CommandInterpreter/CommandArgs.h"
 
 enum class Transport : uint8_t
 {
@@ -19,12 +23,42 @@ struct TransportConfig
     bool scripting = true;
 };
 
-using ActionHandler = std::string (*)(const std::string &command);
+// Handlers get the command already split into words; args.command() is the
+// original text
+using ActionHandler = std::string (*)(const CommandArgs &args);
+
+// Optional structured variant of a handler; the caller owns the returned tree
+using ActionObjectHandler = cJSON *(*)(const CommandArgs &args);
+
+// Optional streaming variant for large results: writes the response into out
+// chunk by chunk instead of returning it as one string
+using ActionStreamHandler = void (*)(const CommandArgs &args, JsonWriter &out);
+
+// A REST request body handed over as it arrives. read() copies up to len
+// bytes into buf and returns how many, 0 at the end, -1 if the connection failed
+struct RequestBody
+{
+    size_t length;
+    std::function<int(char *buf, size_t len)> read;
+};
+
+// Optional REST variant for actions that consume a request body: it reads the
+// body piece by piece instead of getting it buffered into args
+using ActionBodyHandler = void (*)(const CommandArgs &args, RequestBody &body, JsonWriter &out);
 
 struct FeatureAction
 {
     std::string name;
     std::string type = "GET";
     ActionHandler handler;
+    ActionObjectHandler objectHandler = nullptr;
+    ActionStreamHandler streamHandler = nullptr;
+    ActionBodyHandler bodyHandler = nullptr;
     TransportConfig transports;
+    // Handler may block for long (scans, large listings): REST and WS run it
+    // on an HTTP worker task instead of the server task
+    bool async = false;
+    // Handler hops to the UI task and waits for it. Batches run consecutive
+    // uiTask actions in one hop instead of one per command
+    bool uiTask = false;
 };
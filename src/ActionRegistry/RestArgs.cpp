@@ -0,0 +1,112 @@
+#include "RestArgs.h"
+#include "../mime.h"
+#include "../utils/CJsonHelper.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Strings as they are, whole numbers without a decimal point, booleans as 1/0
+static bool scalarWord(const cJSON *item, std::string &word)
+{
+    if (cJSON_IsString(item))
+    {
+        word = item->valuestring;
+        return true;
+    }
+    if (cJSON_IsNumber(item))
+    {
+        char buf[32];
+        double v = item->valuedouble;
+        if (v == std::floor(v) && std::fabs(v) < 9.2e18)
+            snprintf(buf, sizeof(buf), "%lld", (long long)v);
+        else
+            snprintf(buf, sizeof(buf), "%.15g", v);
+        word = buf;
+        return true;
+    }
+    if (cJSON_IsBool(item))
+    {
+        word = cJSON_IsTrue(item) ? "1" : "0";
+        return true;
+    }
+    return false;
+}
+
+static bool appendWords(std::string &command, const cJSON *words, std::string &error)
+{
+    const cJSON *item;
+    std::string word;
+    cJSON_ArrayForEach(item, words)
+    {
+        if (!scalarWord(item, word))
+        {
+            error = "Arguments must be strings, numbers or booleans";
+            return false;
+        }
+        appendRestWord(command, word);
+    }
+    return true;
+}
+
+static bool appendJsonArgs(std::string &command, std::string_view body, std::string &error)
+{
+    CJsonPtr root(cJSON_ParseWithLength(body.data(), body.length()));
+    if (!root)
+    {
+        error = "Invalid JSON body";
+        return false;
+    }
+    if (cJSON_IsArray(root.get()))
+        return appendWords(command, root.get(), error);
+    if (!cJSON_IsObject(root.get()))
+    {
+        error = "JSON body must be an object or an array";
+        return false;
+    }
+
+    const cJSON *args = cJSON_GetObjectItem(root.get(), "args");
+    if (cJSON_IsString(args))
+    {
+        command += ' ' + std::string(args->valuestring);
+    }
+    else if (cJSON_IsArray(args))
+    {
+        if (!appendWords(command, args, error))
+            return false;
+    }
+    else if (args != nullptr)
+    {
+        error = "\"args\" must be a string or an array";
+        return false;
+    }
+
+    const cJSON *member;
+    std::string value;
+    cJSON_ArrayForEach(member, root.get())
+    {
+        if (member == args)
+            continue;
+        if (!scalarWord(member, value))
+        {
+            error = std::string("Unsupported value for ") + member->string;
+            return false;
+        }
+        appendRestWord(command, std::string(member->string) + '=' + value);
+    }
+    return true;
+}
+
+bool appendBodyArgs(std::string &command, std::string_view contentType, std::string_view body, std::string &error)
+{
+    if (contentType.substr(0, strlen(MIME_JSON)) == MIME_JSON)
+        return appendJsonArgs(command, body, error);
+    if (contentType.substr(0, strlen(MIME_FORM)) == MIME_FORM)
+    {
+        appendQueryArgs(command, body);
+        return true;
+    }
+    std::string text = StringUtil::trim(std::string(body));
+    if (!text.empty())
+        command += ' ' + text;
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include "../CommandInterpreter/CommandArgs.h"
+#include "../utils/StringUtil.h"
+
+/**
+ * Turns the query string and body of a REST call into command words, so REST
+ * handlers get the same CommandArgs as on the other transports. Words are
+ * appended to command, which starts out as the action name.
+ *
+ * Query strings and form bodies, in order: a key without a value is a word of
+ * its own, key=value becomes the word key=value, and args=<text> is command
+ * text split like on the CLI:
+ *
+ *     GET /logstore?read&from=1700000000   ->  logstore read from=1700000000
+ *     GET /i2c?args=read%200x3c%202         ->  i2c read 0x3c 2
+ *
+ * JSON bodies: an array of words, or an object whose "args" is command text
+ * or an array of words and whose other members become key=value words:
+ *
+ *     {"args": ["read"], "from": 1700000000, "format": "text"}
+ *
+ * Any other body is command text.
+ */
+
+inline void appendRestWord(std::string &command, std::string_view word)
+{
+    command += ' ';
+    command += CommandArgs::quote(word);
+}
+
+inline void appendQueryArgs(std::string &command, std::string_view query)
+{
+    while (!query.empty())
+    {
+        size_t amp = query.find('&');
+        std::string_view pair = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+        if (pair.empty())
+            continue;
+
+        size_t eq = pair.find('=');
+        std::string key = StringUtil::urlDecode(std::string(pair.substr(0, eq)));
+        if (eq == std::string_view::npos)
+        {
+            appendRestWord(command, key);
+            continue;
+        }
+        std::string value = StringUtil::urlDecode(std::string(pair.substr(eq + 1)));
+        if (key == "args")
+            command += ' ' + value;
+        else
+            appendRestWord(command, key + '=' + value);
+    }
+}
+
+// Returns false with error set when a JSON body does not have the shape above
+bool appendBodyArgs(std::string &command, std::string_view contentType, std::string_view body, std::string &error);
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * A command split into words once, up front.
+ *
+ * Words are separated by spaces or tabs. A word may be quoted with '...' or
+ * "..." to keep its spaces; inside double quotes \" and \\ are escapes. The
+ * quotes can also sit inside a word (text="hello world" gives
+ * text=hello world). Plain words are views into the command itself; only
+ * words that had quotes or escapes are copied.
+ *
+ *     CommandArgs args("screen text 10 20 0xFFFF 0 2 \"Hello world\"");
+ *     args.name();       // "screen"
+ *     args.toInt(2);     // 10
+ *     args.toColor(4);   // 0xFFFF, "#RRGGBB" works too
+ *     args.at(7);        // "Hello world"
+ *
+ * Missing words read as empty, numbers that do not parse as the fallback.
+ */
+class CommandArgs
+{
+public:
+    CommandArgs() = default;
+
+    CommandArgs(std::string command) : _command(std::move(command))
+    {
+        parse();
+    }
+
+    CommandArgs(const char *command) : _command(command != nullptr ? command : "")
+    {
+        parse();
+    }
+
+    // The command as received
+    const std::string &command() const
+    {
+        return _command;
+    }
+
+    // Number of words, including the action name
+    size_t size() const
+    {
+        return _tokens.size();
+    }
+
+    bool has(size_t i) const
+    {
+        return i < _tokens.size();
+    }
+
+    std::string_view name() const
+    {
+        return at(0);
+    }
+
+    std::string_view at(size_t i) const
+    {
+        if (i >= _tokens.size())
+            return {};
+        const Token &t = _tokens[i];
+        const std::string &text = t.copied ? _copies : _command;
+        return std::string_view(text.data() + t.offset, t.length);
+    }
+
+    std::string str(size_t i) const
+    {
+        return std::string(at(i));
+    }
+
+    // The command text from word i to the end, exactly as received
+    std::string_view rest(size_t i) const
+    {
+        if (i >= _tokens.size())
+            return {};
+        return std::string_view(_command).substr(_tokens[i].source);
+    }
+
+    // Decimal, or hex with 0x
+    long toInt(size_t i, long fallback = 0) const
+    {
+        long value;
+        return parseNumber(i, 0, value) ? value : fallback;
+    }
+
+    // Hex with or without 0x
+    uint32_t toHex(size_t i, uint32_t fallback = 0) const
+    {
+        long value;
+        return parseNumber(i, 16, value) ? (uint32_t)value : fallback;
+    }
+
+    // RGB565 as a number (0xF800, 63488), or #RRGGBB converted to RGB565
+    uint16_t toColor(size_t i, uint16_t fallback = 0) const
+    {
+        std::string_view word = at(i);
+        if (word.size() == 7 && word[0] == '#')
+        {
+            long rgb;
+            if (!parseNumber(word.substr(1), 16, rgb))
+                return fallback;
+            return (uint16_t)(((rgb >> 8) & 0xF800) | ((rgb >> 5) & 0x07E0) | ((rgb >> 3) & 0x001F));
+        }
+        long value;
+        return parseNumber(word, 0, value) && value >= 0 && value <= 0xFFFF ? (uint16_t)value : fallback;
+    }
+
+    // The word as it has to be written for the parser to read it back: as is
+    // when it is plain, double-quoted with escapes otherwise
+    static std::string quote(std::string_view word)
+    {
+        bool plain = !word.empty();
+        for (char c : word)
+            plain = plain && !isSpace(c) && c != '"' && c != '\'' && c != '\\';
+        if (plain)
+            return std::string(word);
+
+        std::string quoted = "\"";
+        for (char c : word)
+        {
+            if (c == '"' || c == '\\')
+                quoted += '\\';
+            quoted += c;
+        }
+        return quoted + '"';
+    }
+
+private:
+    struct Token
+    {
+        uint32_t offset; // into _command, or into _copies when copied
+        uint32_t length;
+        uint32_t source; // where the word starts in _command
+        bool copied;
+    };
+
+    std::string _command;
+    std::string _copies; // words that had quotes or escapes, unquoted
+    std::vector<Token> _tokens;
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    void parse()
+    {
+        const char *s = _command.data();
+        size_t len = _command.size();
+        size_t pos = 0;
+        while (true)
+        {
+            while (pos < len && isSpace(s[pos]))
+                pos++;
+            if (pos >= len)
+                break;
+
+            size_t start = pos;
+            size_t end = pos;
+            while (end < len && !isSpace(s[end]) && s[end] != '"' && s[end] != '\'')
+                end++;
+            if (end >= len || isSpace(s[end]))
+            {
+                // plain word, no copy needed
+                _tokens.push_back({(uint32_t)start, (uint32_t)(end - start), (uint32_t)start, false});
+                pos = end;
+                continue;
+            }
+
+            // the word has quotes: unquote it into _copies
+            size_t offset = _copies.size();
+            char quote = 0;
+            for (pos = start; pos < len; pos++)
+            {
+                char c = s[pos];
+                if (quote == 0)
+                {
+                    if (isSpace(c))
+                        break;
+                    if (c == '"' || c == '\'')
+                        quote = c;
+                    else
+                        _copies += c;
+                }
+                else if (c == quote)
+                {
+                    quote = 0;
+                }
+                else if (quote == '"' && c == '\\' && pos + 1 < len && (s[pos + 1] == '"' || s[pos + 1] == '\\'))
+                {
+                    _copies += s[++pos];
+                }
+                else
+                {
+                    _copies += c;
+                }
+            }
+            _tokens.push_back({(uint32_t)offset, (uint32_t)(_copies.size() - offset), (uint32_t)start, true});
+        }
+    }
+
+    bool parseNumber(size_t i, int base, long &value) const
+    {
+        return parseNumber(at(i), base, value);
+    }
+
+    static bool parseNumber(std::string_view word, int base, long &value)
+    {
+        char buf[24];
+        if (word.empty() || word.size() >= sizeof(buf))
+            return false;
+        memcpy(buf, word.data(), word.size());
+        buf[word.size()] = '\0';
+        char *end = nullptr;
+        value = strtol(buf, &end, base);
+        return *end == '\0';
+    }
+};
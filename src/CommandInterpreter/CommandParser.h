@@ -1,12 +1,11 @@
 #pragma once
 
 #include <cstdint>
-#include <cstring>
 #include <string>
-#include <vector>
-
-#define COMMAND_DELIMITER " "
+#include "CommandArgs.h"
 
+// One-off lookups of a single word. Handlers that read several words should
+// use the CommandArgs they are given instead of re-parsing the command.
 class CommandParser
 {
 public:
@@ -17,29 +16,16 @@ public:
 
     static std::string getCommandParameter(const char *command, uint8_t parameterNo)
     {
-        if (command == nullptr)
-        {
-            return "";
-        }
-        size_t len = std::strlen(command) + 1;
-        std::vector<char> buf(len);
-        std::memcpy(buf.data(), command, len);
-        char *p = buf.data();
-        char *str = nullptr;
-        int currentSegment = 0;
-        while (currentSegment++ <= parameterNo && (str = strtok_r(p, COMMAND_DELIMITER, &p)) != nullptr)
-        {
-        }
-        return str != nullptr ? std::string(str) : "";
+        return CommandArgs(command).str(parameterNo);
     }
 
     static std::string getCommandName(const std::string &command)
     {
-        return getCommandParameter(command.c_str(), 0);
+        return getCommandParameter(command, 0);
     }
 
     static std::string getCommandParameter(const std::string &command, uint8_t parameterNo)
     {
-        return getCommandParameter(command.c_str(), parameterNo);
+        return CommandArgs(command).str(parameterNo);
     }
-};
\ No newline at end of file
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -48,6 +49,7 @@ public:
         }
 
         _taskShouldStop = false;
+        _taskStackHighWater.store(0, std::memory_order_relaxed);
         BaseType_t result = xTaskCreatePinnedToCore(taskEntry, _featureName.c_str(), _taskStackSize, this,
                                                     _taskPriority, &_taskHandle, _pinnedCore);
         return result == pdPASS;
@@ -84,13 +86,11 @@ public:
         return _taskHandle;
     }
 
+    // Published by the task itself, so readers on other tasks never touch a
+    // TCB that stopTask() may be deleting. 0 until the task has run.
     UBaseType_t getTaskStackHighWaterMark() const
     {
-        if (_taskHandle != nullptr)
-        {
-            return uxTaskGetStackHighWaterMark(_taskHandle);
-        }
-        return 0;
+        return _taskStackHighWater.load(std::memory_order_relaxed);
     }
 
     FeatureState Setup()
@@ -158,16 +158,24 @@ protected:
     uint16_t _taskStackSize = 4096;
     BaseType_t _pinnedCore = 0;
     UBaseType_t _taskPriority = 1;
+    std::atomic<UBaseType_t> _taskStackHighWater{0};
 
     static void taskEntry(void *param)
     {
         Feature *self = static_cast<Feature *>(param);
+        TickType_t publishedAt = xTaskGetTickCount() - pdMS_TO_TICKS(1000);
         while (!self->_taskShouldStop)
         {
             if (self->_featureState == FeatureState::RUNNING)
             {
                 self->_onLoop();
             }
+            // the check walks the unused stack, so once a second is plenty
+            if (xTaskGetTickCount() - publishedAt >= pdMS_TO_TICKS(1000))
+            {
+                publishedAt = xTaskGetTickCount();
+                self->_taskStackHighWater.store(uxTaskGetStackHighWaterMark(nullptr), std::memory_order_relaxed);
+            }
             vTaskDelay(pdMS_TO_TICKS(1));
         }
         self->_taskHandle = nullptr;
@@ -25,6 +25,10 @@
 #include "./Features/SdCard/SdCardFeature.h"
 #endif
 
+#if ENABLE_LOG_STORE
+#include "./Features/LogStore.h"
+#endif
+
 #if ENABLE_OTA
 #include "./Features/OTA.h"
 #endif
@@ -78,6 +82,10 @@ public:
         this->registerFeature(SdCardFeature);
 #endif
 
+#if ENABLE_LOG_STORE
+        this->registerFeature(logStoreFeature);
+#endif
+
 #if ENABLE_I2C
         this->registerFeature(i2cFeature);
 #endif
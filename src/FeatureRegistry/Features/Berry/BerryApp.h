@@ -17,6 +17,7 @@
 #include <vector>
 #include <string>
 #include <cstdio>
+#include <algorithm>
 
 extern "C"
 {
@@ -47,6 +48,20 @@ struct HandleEntry
     HandleType type;
 };
 
+// Script-visible handles encode (generation << 16) | slot index, so a handle
+// to a released element never aliases whatever reuses its slot later.
+// Slot 0 / generation 0 is always the content container, i.e. handle 0.
+constexpr int HANDLE_INDEX_BITS = 16;
+constexpr int HANDLE_INDEX_MASK = (1 << HANDLE_INDEX_BITS) - 1;
+constexpr int HANDLE_GENERATION_MASK = 0x7FFF; // keeps handles positive in a 32-bit bint
+
+struct HandleSlot
+{
+    HandleEntry entry;
+    uint16_t generation;
+    int nextFree; // free-list link while the slot is unused, -1 otherwise
+};
+
 class BerryApp : public UI::App
 {
 public:
@@ -56,6 +71,11 @@ public:
     {
     }
 
+    ~BerryApp() override
+    {
+        unregisterInstance(this);
+    }
+
     const char *name() const override
     {
         return _name.c_str();
@@ -110,8 +130,9 @@ public:
         berrySetCurrentApp(this);
 
         // handle 0 = content container
-        _handles.clear();
-        _handles.push_back({&content, HandleType::CONTAINER});
+        resetHandles();
+        addHandle(&content, HandleType::CONTAINER);
+        registerInstance(this);
 
         // read script (resolve virtual path prefix)
         ResolvedPath resolved = resolveVirtualPath(_scriptPath);
@@ -219,8 +240,9 @@ public:
         // destroy any popup overlays created by this app
         UI::windowManager().destroyPopupsForOwner(this);
 
-        _handles.clear();
+        resetHandles();
         _nextCbId = 0;
+        unregisterInstance(this);
 
         berrySetCurrentApp(nullptr);
     }
@@ -229,32 +251,93 @@ public:
 
     int addHandle(UI::Element *el, HandleType type)
     {
-        int h = (int)_handles.size();
-        _handles.push_back({el, type});
-        return h;
+        if (el == nullptr)
+        {
+            return -1;
+        }
+        int idx;
+        if (_freeHead >= 0)
+        {
+            idx = _freeHead;
+            _freeHead = _handles[idx].nextFree;
+        }
+        else
+        {
+            if ((int)_handles.size() > HANDLE_INDEX_MASK)
+            {
+                loggerInstance->Error(std::string("BerryApp: handle table full in ") + _name);
+                return -1;
+            }
+            idx = (int)_handles.size();
+            _handles.push_back({{nullptr, type}, 0, -1});
+        }
+        HandleSlot &slot = _handles[idx];
+        slot.entry = {el, type};
+        slot.nextFree = -1;
+        _liveHandles++;
+        return (slot.generation << HANDLE_INDEX_BITS) | idx;
     }
 
     HandleEntry *getHandle(int h)
     {
-        if (h < 0 || h >= (int)_handles.size())
+        HandleSlot *slot = slotFor(h);
+        return slot != nullptr ? &slot->entry : nullptr;
+    }
+
+    void invalidateHandle(int h)
+    {
+        HandleSlot *slot = slotFor(h);
+        if (slot != nullptr)
         {
-            return nullptr;
+            releaseSlot((int)(slot - _handles.data()));
         }
-        if (_handles[h].ptr == nullptr)
+    }
+
+    // Release every live handle whose element matches pred (e.g. a removed subtree)
+    template <typename Pred> void invalidateHandlesIf(Pred pred)
+    {
+        for (int i = 1; i < (int)_handles.size(); i++)
         {
-            return nullptr;
+            if (_handles[i].entry.ptr != nullptr && pred(_handles[i].entry))
+            {
+                releaseSlot(i);
+            }
         }
-        return &_handles[h];
     }
 
-    void invalidateHandle(int h)
+    template <typename Fn> void forEachHandle(Fn &&fn)
     {
-        if (h >= 0 && h < (int)_handles.size())
+        for (auto &slot : _handles)
         {
-            _handles[h].ptr = nullptr;
+            if (slot.entry.ptr != nullptr)
+            {
+                fn(slot.entry);
+            }
         }
     }
 
+    size_t liveHandleCount() const
+    {
+        return _liveHandles;
+    }
+
+    size_t handleCapacity() const
+    {
+        return _handles.size();
+    }
+
+    size_t callbackCount() const
+    {
+        return _callbackGlobals.size();
+    }
+
+    // Apps that are currently set up, for diagnostics
+    static std::vector<BerryApp *> &instances()
+    {
+        static std::vector<BerryApp *> list;
+        return list;
+    }
+
     // --- Callback storage ---
 
     int storeCallback(bvm *vm, int stackIdx)
@@ -324,10 +407,64 @@ private:
     std::string _iconValue;
     std::string _startMenu;
     std::string _instanceGlobal;
-    std::vector<HandleEntry> _handles;
+    std::vector<HandleSlot> _handles;
+    int _freeHead{-1};
+    size_t _liveHandles{0};
     std::vector<std::string> _callbackGlobals;
     int _nextCbId{0};
 
+    HandleSlot *slotFor(int h)
+    {
+        if (h < 0)
+        {
+            return nullptr;
+        }
+        int idx = h & HANDLE_INDEX_MASK;
+        int gen = (h >> HANDLE_INDEX_BITS) & HANDLE_GENERATION_MASK;
+        if (idx >= (int)_handles.size())
+        {
+            return nullptr;
+        }
+        HandleSlot &slot = _handles[idx];
+        if (slot.entry.ptr == nullptr || slot.generation != gen)
+        {
+            return nullptr;
+        }
+        return &slot;
+    }
+
+    void releaseSlot(int idx)
+    {
+        HandleSlot &slot = _handles[idx];
+        slot.entry.ptr = nullptr;
+        slot.generation = (slot.generation + 1) & HANDLE_GENERATION_MASK;
+        slot.nextFree = _freeHead;
+        _freeHead = idx;
+        _liveHandles--;
+    }
+
+    void resetHandles()
+    {
+        _handles.clear();
+        _freeHead = -1;
+        _liveHandles = 0;
+    }
+
+    static void registerInstance(BerryApp *app)
+    {
+        auto &list = instances();
+        if (std::find(list.begin(), list.end(), app) == list.end())
+        {
+            list.push_back(app);
+        }
+    }
+
+    static void unregisterInstance(BerryApp *app)
+    {
+        auto &list = instances();
+        list.erase(std::remove(list.begin(), list.end(), app), list.end());
+    }
+
     void callMethod(const char *method, const std::function<int(bvm *)> &pushArgs)
     {
         bvm *vm = getBerryVM();
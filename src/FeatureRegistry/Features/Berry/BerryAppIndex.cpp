@@ -0,0 +1,282 @@
+#include "BerryAppIndex.h"
+
+#if ENABLE_BERRY
+
+#include "../Logging.h"
+#include "../../../fs/VirtualFS.h"
+#include "../../../utils/StringUtil.h"
+#include "../../../utils/CJsonHelper.h"
+#include "cJSON.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <dirent.h>
+#include <sys/stat.h>
+
+static std::mutex s_indexMutex;
+static std::vector<BerryScriptInfo> s_entries;
+static bool s_loaded = false;
+static std::atomic<bool> s_flashDirty{false};
+static std::atomic<bool> s_sdDirty{false};
+static bool s_sdIndexed = false;
+
+static bool isFlashEntry(const BerryScriptInfo &info)
+{
+    return StringUtil::startsWith(info.path, "/flash/");
+}
+
+static bool loadIndexFile()
+{
+    std::string content = vfsReadFileAsString(resolveToLittleFsPath(BERRY_APP_INDEX_FILE));
+    if (content.empty())
+    {
+        return false;
+    }
+
+    CJsonPtr root(cJSON_ParseWithLength(content.c_str(), content.length()));
+    if (!root || !cJSON_IsArray(root.get()))
+    {
+        return false;
+    }
+
+    auto str = [](const cJSON *obj, const char *key)
+    {
+        const cJSON *item = cJSON_GetObjectItem(obj, key);
+        return std::string(cJSON_IsString(item) ? item->valuestring : "");
+    };
+
+    const cJSON *obj = nullptr;
+    cJSON_ArrayForEach(obj, root.get())
+    {
+        BerryScriptInfo info;
+        info.name = str(obj, "name");
+        info.path = str(obj, "path");
+        info.startMenu = str(obj, "startMenu");
+        info.iconType = str(obj, "iconType");
+        info.iconValue = str(obj, "iconValue");
+        const cJSON *mtime = cJSON_GetObjectItem(obj, "mtime");
+        info.mtime = cJSON_IsNumber(mtime) ? (time_t)mtime->valuedouble : 0;
+        const cJSON *size = cJSON_GetObjectItem(obj, "size");
+        info.size = cJSON_IsNumber(size) ? (long)size->valuedouble : 0;
+        if (!info.path.empty())
+        {
+            s_entries.push_back(std::move(info));
+        }
+    }
+    return true;
+}
+
+static void saveIndexFile()
+{
+    CJsonPtr root(cJSON_CreateArray());
+    for (const auto &info : s_entries)
+    {
+        if (!isFlashEntry(info))
+        {
+            continue; // SD cards can be swapped between boots, never persist them
+        }
+        cJSON *o = cJSON_CreateObject();
+        cJSON_AddStringToObject(o, "name", info.name.c_str());
+        cJSON_AddStringToObject(o, "path", info.path.c_str());
+        cJSON_AddStringToObject(o, "startMenu", info.startMenu.c_str());
+        cJSON_AddStringToObject(o, "iconType", info.iconType.c_str());
+        cJSON_AddStringToObject(o, "iconValue", info.iconValue.c_str());
+        cJSON_AddNumberToObject(o, "mtime", (double)info.mtime);
+        cJSON_AddNumberToObject(o, "size", (double)info.size);
+        cJSON_AddItemToArray(root.get(), o);
+    }
+
+    std::string realPath = resolveToLittleFsPath(BERRY_APP_INDEX_FILE);
+    FILE *f = fopen(realPath.c_str(), "w");
+    if (!f)
+    {
+        loggerInstance->Error("BerryAppIndex: cannot write " + realPath);
+        return;
+    }
+    std::string json = cJsonToString(root.get());
+    fwrite(json.data(), 1, json.size(), f);
+    fclose(f);
+}
+
+// Rescan one apps directory: entries whose mtime and size are unchanged are
+// reused as-is, only new or modified scripts get their header parsed.
+// Returns true if the entries below realDir changed.
+static bool refreshDir(const std::string &realDir)
+{
+    std::string prefix = toVirtualPath(realDir) + "/";
+
+    std::vector<BerryScriptInfo> previous;
+    std::vector<BerryScriptInfo> kept;
+    for (auto &info : s_entries)
+    {
+        if (StringUtil::startsWith(info.path, prefix))
+            previous.push_back(std::move(info));
+        else
+            kept.push_back(std::move(info));
+    }
+
+    std::vector<BerryScriptInfo> fresh;
+    bool changed = false;
+
+    DIR *d = opendir(realDir.c_str());
+    if (d)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(d)) != nullptr)
+        {
+            std::string filename = entry->d_name;
+            if (!StringUtil::endsWith(filename, ".be"))
+            {
+                continue;
+            }
+
+            std::string realPath = realDir + "/" + filename;
+            struct stat st;
+            if (stat(realPath.c_str(), &st) != 0)
+            {
+                continue;
+            }
+
+            std::string virtualPath = prefix + filename;
+            auto it = std::find_if(previous.begin(), previous.end(), [&](const BerryScriptInfo &p)
+                                   { return p.path == virtualPath && p.mtime == st.st_mtime && p.size == st.st_size; });
+            if (it != previous.end())
+            {
+                fresh.push_back(std::move(*it));
+                previous.erase(it);
+                continue;
+            }
+
+            BerryScriptInfo info = parseAppMetadata(virtualPath);
+            info.mtime = st.st_mtime;
+            info.size = st.st_size;
+            fresh.push_back(std::move(info));
+            changed = true;
+        }
+        closedir(d);
+    }
+
+    // anything left in previous was deleted
+    changed = changed || !previous.empty();
+
+    s_entries = std::move(kept);
+    s_entries.insert(s_entries.end(), std::make_move_iterator(fresh.begin()), std::make_move_iterator(fresh.end()));
+    std::stable_partition(s_entries.begin(), s_entries.end(), isFlashEntry);
+    return changed;
+}
+
+// Caller holds s_indexMutex
+static void ensureFresh()
+{
+    if (!s_loaded)
+    {
+        s_loaded = true;
+        if (!loadIndexFile())
+        {
+            s_flashDirty = true;
+        }
+    }
+
+    if (s_flashDirty.exchange(false))
+    {
+        if (refreshDir(resolveToLittleFsPath(BERRY_APPS_DIR)))
+        {
+            saveIndexFile();
+        }
+    }
+
+#if ENABLE_SD_CARD
+    bool sdMounted = isSdMounted();
+    if (sdMounted != s_sdIndexed)
+    {
+        s_sdIndexed = sdMounted;
+        s_sdDirty = true;
+    }
+    if (s_sdDirty.exchange(false))
+    {
+        std::string sdDir = std::string(SD_MOUNT_POINT) + BERRY_APPS_DIR;
+        if (sdMounted)
+        {
+            refreshDir(sdDir);
+        }
+        else
+        {
+            std::string prefix = toVirtualPath(sdDir) + "/";
+            s_entries.erase(std::remove_if(s_entries.begin(), s_entries.end(), [&](const BerryScriptInfo &info)
+                                           { return StringUtil::startsWith(info.path, prefix); }),
+                            s_entries.end());
+        }
+    }
+#endif
+}
+
+std::vector<BerryScriptInfo> getBerryAppIndex()
+{
+    std::lock_guard<std::mutex> lock(s_indexMutex);
+    ensureFresh();
+    return s_entries;
+}
+
+bool findBerryAppByName(const std::string &name, BerryScriptInfo &out)
+{
+    std::lock_guard<std::mutex> lock(s_indexMutex);
+    ensureFresh();
+    for (const auto &info : s_entries)
+    {
+        if (StringUtil::equalsIgnoreCase(info.name, name))
+        {
+            out = info;
+            return true;
+        }
+    }
+    return false;
+}
+
+BerryScriptInfo lookupAppMetadata(const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_indexMutex);
+        ensureFresh();
+        for (const auto &info : s_entries)
+        {
+            if (info.path == path)
+            {
+                return info;
+            }
+        }
+    }
+    return parseAppMetadata(path);
+}
+
+void notifyBerryAppsChanged(const std::string &realPath)
+{
+    if (realPath.find(BERRY_APPS_DIR) == std::string::npos)
+    {
+        return;
+    }
+    if (StringUtil::startsWith(realPath, LITTLEFS_MOUNT_POINT))
+    {
+        s_flashDirty = true;
+    }
+#if ENABLE_SD_CARD
+    else if (StringUtil::startsWith(realPath, SD_MOUNT_POINT))
+    {
+        s_sdDirty = true;
+    }
+#endif
+}
+
+size_t rebuildBerryAppIndex()
+{
+    std::lock_guard<std::mutex> lock(s_indexMutex);
+    s_entries.clear();
+    s_loaded = true;
+    s_flashDirty = true;
+    s_sdDirty = true;
+    ensureFresh();
+    loggerInstance->Info("Berry app index rebuilt: " + std::to_string(s_entries.size()) + " apps");
+    return s_entries.size();
+}
+
+#endif // ENABLE_BERRY
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../../../config.h"
+
+#if ENABLE_BERRY
+
+#include "BerryFeature.h"
+#include <string>
+#include <vector>
+
+#define BERRY_APPS_DIR "/berry/apps"
+#define BERRY_APP_INDEX_FILE "/berry/.appindex.json"
+
+// Cached header metadata of every script in BERRY_APPS_DIR. Flash entries are
+// persisted in BERRY_APP_INDEX_FILE, so the start menu and 'berry open' don't
+// need to open each .be file. A directory is rescanned only after it has been
+// marked changed; unchanged scripts (same mtime and size) keep their entry.
+
+std::vector<BerryScriptInfo> getBerryAppIndex();
+bool findBerryAppByName(const std::string &name, BerryScriptInfo &out);
+
+// Index entry for a virtual script path, or parseAppMetadata() for scripts
+// outside the apps directories
+BerryScriptInfo lookupAppMetadata(const std::string &path);
+
+// Mark the apps directory containing realPath (or realPath itself) as changed
+void notifyBerryAppsChanged(const std::string &realPath);
+
+// Drop the cache and rescan every apps directory
+size_t rebuildBerryAppIndex();
+
+#endif // ENABLE_BERRY
@@ -1,14 +1,14 @@
 #include "BerryFeature.h"
 #include "../Logging.h"
 #include "../../../ActionRegistry/ActionRegistry.h"
-#include "../../../CommandInterpreter/CommandParser.h"
+#include "../../../CommandInterpreter/CommandArgs.h"
 #include "../../../config.h"
 #include "../../../fs/VirtualFS.h"
 #include "../../../utils/StringUtil.h"
+#include "../../../utils/CJsonHelper.h"
 #include <string>
 
 #include <cstdio>
-#include <dirent.h>
 #include <sys/stat.h>
 
 extern "C"
@@ -19,6 +19,8 @@ extern "C"
 #if ENABLE_BERRY
 #include "BerryUIBindings.h"
 #include "BerryApp.h"
+#include "BerryAppIndex.h"
+#include "BerryGc.h"
 #if ENABLE_UI
 #include "../UI/WindowManager.h"
 #include "../UI/Theme.h"
@@ -114,7 +116,7 @@ void openBerryScript(const std::string &filePath)
         path = std::string("/") + path;
     }
 
-    auto meta = parseAppMetadata(path);
+    auto meta = lookupAppMetadata(path);
     if (meta.name.empty())
     {
         return;
@@ -132,7 +134,7 @@ void openBerryPanel(const std::string &filePath)
         path = std::string("/") + path;
     }
 
-    auto meta = parseAppMetadata(path);
+    auto meta = lookupAppMetadata(path);
     if (meta.name.empty())
     {
         return;
@@ -144,69 +146,91 @@ void openBerryPanel(const std::string &filePath)
 }
 #endif
 
-static std::vector<BerryScriptInfo> scanBerryScriptsOnFs(const std::string &realDir)
-{
-    std::vector<BerryScriptInfo> result;
+#endif // ENABLE_BERRY
 
-    DIR *d = opendir(realDir.c_str());
-    if (!d)
-    {
-        return result;
-    }
+// --- Native bindings exposed to Berry scripts ---
 
-    struct dirent *entry;
-    while ((entry = readdir(d)) != nullptr)
+static int native_action(bvm *vm)
+{
+    int argc = be_top(vm);
+    if (argc >= 1 && be_isstring(vm, 1))
     {
-        std::string filename = entry->d_name;
-        if (StringUtil::endsWith(filename, ".be"))
-        {
-            std::string realPath = realDir;
-            if (!StringUtil::endsWith(realPath, "/"))
-            {
-                realPath += "/";
-            }
-            realPath += filename;
-
-            std::string virtualPath = toVirtualPath(realPath);
-
-            BerryScriptInfo info = parseAppMetadata(virtualPath);
-            result.push_back(std::move(info));
-        }
+        const char *cmd = be_tostring(vm, 1);
+        std::string result = actionRegistryInstance->execute(std::string(cmd), Transport::SCRIPTING);
+        be_pushstring(vm, result.c_str());
+        be_return(vm);
     }
-    closedir(d);
-    return result;
+    be_return_nil(vm);
 }
 
-std::vector<BerryScriptInfo> scanBerryScripts(const char *dir)
+// Push a cJSON value onto the Berry stack as the equivalent of json.load():
+// objects become map instances, arrays list instances.
+static void pushCJsonValue(bvm *vm, const cJSON *item)
 {
-    // Scan on LittleFS (flash)
-    auto result = scanBerryScriptsOnFs(resolveToLittleFsPath(dir));
+    be_stack_require(vm, 4);
 
-#if ENABLE_SD_CARD
-    // Also scan on SD card if mounted
-    if (isSdMounted())
+    if (cJSON_IsObject(item))
     {
-        auto sdResult = scanBerryScriptsOnFs(std::string(SD_MOUNT_POINT) + dir);
-        result.insert(result.end(), sdResult.begin(), sdResult.end());
+        be_newobject(vm, "map");
+        for (const cJSON *child = item->child; child != nullptr; child = child->next)
+        {
+            be_pushstring(vm, child->string != nullptr ? child->string : "");
+            pushCJsonValue(vm, child);
+            be_data_insert(vm, -3);
+            be_pop(vm, 2);
+        }
+        be_pop(vm, 1); // leave the instance
+    }
+    else if (cJSON_IsArray(item))
+    {
+        be_newobject(vm, "list");
+        for (const cJSON *child = item->child; child != nullptr; child = child->next)
+        {
+            pushCJsonValue(vm, child);
+            be_data_push(vm, -2);
+            be_pop(vm, 1);
+        }
+        be_pop(vm, 1); // leave the instance
+    }
+    else if (cJSON_IsString(item))
+    {
+        be_pushstring(vm, item->valuestring);
+    }
+    else if (cJSON_IsNumber(item))
+    {
+        double d = item->valuedouble;
+        if (d >= -2147483648.0 && d <= 2147483647.0 && d == (double)(bint)d)
+        {
+            be_pushint(vm, (bint)d);
+        }
+        else
+        {
+            be_pushreal(vm, (breal)d);
+        }
+    }
+    else if (cJSON_IsBool(item))
+    {
+        be_pushbool(vm, cJSON_IsTrue(item));
+    }
+    else
+    {
+        be_pushnil(vm);
     }
-#endif
-
-    return result;
 }
 
-#endif // ENABLE_BERRY
-
-// --- Native bindings exposed to Berry scripts ---
-
-static int native_action(bvm *vm)
+// action_obj(cmd) -> map/list, without the JSON text round-trip of action() + json.load()
+static int native_action_obj(bvm *vm)
 {
     int argc = be_top(vm);
     if (argc >= 1 && be_isstring(vm, 1))
     {
         const char *cmd = be_tostring(vm, 1);
-        std::string result = actionRegistryInstance->execute(std::string(cmd), Transport::SCRIPTING);
-        be_pushstring(vm, result.c_str());
-        be_return(vm);
+        CJsonPtr result(actionRegistryInstance->executeObject(std::string(cmd), Transport::SCRIPTING));
+        if (result)
+        {
+            pushCJsonValue(vm, result.get());
+            be_return(vm);
+        }
     }
     be_return_nil(vm);
 }
@@ -275,24 +299,24 @@ static std::string berryEval(const std::string &code)
 
 // --- Action handler ---
 
-static std::string berryHandlerImpl(const std::string &command)
+static std::string berryHandlerImpl(const CommandArgs &args)
 {
-    std::string operation = CommandParser::getCommandParameter(command, 1);
+    std::string operation = args.str(1);
 
     if (operation == "eval")
     {
-        size_t idx = command.find("eval ");
-        if (idx == std::string::npos)
+        // The code is the rest of the line as typed, quotes and all
+        std::string code(args.rest(2));
+        if (code.empty())
         {
             return "{\"error\": \"No code provided\"}";
         }
-        std::string code = command.substr(idx + 5);
         return berryEval(code);
     }
 
     if (operation == "run")
     {
-        std::string path = CommandParser::getCommandParameter(command, 2);
+        std::string path = args.str(2);
         if (path.length() == 0)
         {
             return "{\"error\": \"No file path provided\"}";
@@ -326,7 +350,7 @@ static std::string berryHandlerImpl(const std::string &command)
 
 #if ENABLE_UI
         {
-            auto meta = parseAppMetadata(path);
+            auto meta = lookupAppMetadata(path);
             const std::string pathCopy = path;
             UI::queueAction([pathCopy]() { openBerryScript(pathCopy); });
             loggerInstance->Info(std::string("Berry: opening ") + meta.name + " (" + path + ")");
@@ -345,41 +369,35 @@ static std::string berryHandlerImpl(const std::string &command)
 #if ENABLE_UI
     if (operation == "open")
     {
-        std::string appName = CommandParser::getCommandParameter(command, 2);
+        std::string appName = args.str(2);
         if (appName.length() == 0)
         {
             return "{\"error\": \"No app name provided\"}";
         }
-        auto scripts = scanBerryScripts("/berry/apps");
-        for (auto &s : scripts)
+        BerryScriptInfo s;
+        if (findBerryAppByName(appName, s))
         {
-            if (StringUtil::equalsIgnoreCase(s.name, appName))
-            {
-                std::string scriptPath = s.path;
-                UI::queueAction([scriptPath]() { openBerryScript(scriptPath); });
-                loggerInstance->Info(std::string("Berry: opening app ") + s.name);
-                return std::string("{\"event\":\"berry\", \"status\":\"queued\", \"app\":\"") + s.name + "\"}";
-            }
+            std::string scriptPath = s.path;
+            UI::queueAction([scriptPath]() { openBerryScript(scriptPath); });
+            loggerInstance->Info(std::string("Berry: opening app ") + s.name);
+            return std::string("{\"event\":\"berry\", \"status\":\"queued\", \"app\":\"") + s.name + "\"}";
         }
         return std::string(R"({"error": "Unknown Berry app: )") + appName + "\"}";
     }
 
     if (operation == "panel")
     {
-        std::string appName = CommandParser::getCommandParameter(command, 2);
+        std::string appName = args.str(2);
         if (appName.length() == 0)
         {
             return "{\"error\": \"No app name provided\"}";
         }
-        auto scripts = scanBerryScripts("/berry/apps");
-        for (auto &s : scripts)
+        BerryScriptInfo s;
+        if (findBerryAppByName(appName, s))
         {
-            if (StringUtil::equalsIgnoreCase(s.name, appName))
-            {
-                openBerryPanel(s.path);
-                loggerInstance->Info(std::string("Berry: opened panel ") + s.name);
-                return std::string(R"({"event":"berry", "status":"panel_opened", "app":")") + s.name + "\"}";
-            }
+            openBerryPanel(s.path);
+            loggerInstance->Info(std::string("Berry: opened panel ") + s.name);
+            return std::string(R"({"event":"berry", "status":"panel_opened", "app":")") + s.name + "\"}";
         }
         return std::string(R"({"error": "Unknown Berry app: )") + appName + "\"}";
     }
@@ -387,7 +405,7 @@ static std::string berryHandlerImpl(const std::string &command)
 
     if (operation == "apps")
     {
-        auto scripts = scanBerryScripts("/berry/apps");
+        auto scripts = getBerryAppIndex();
         std::string json = "{\"apps\":[";
         for (size_t i = 0; i < scripts.size(); i++)
         {
@@ -420,7 +438,7 @@ static std::string berryHandlerImpl(const std::string &command)
 
     if (operation == "meta")
     {
-        std::string path = CommandParser::getCommandParameter(command, 2);
+        std::string path = args.str(2);
         if (path.length() == 0)
         {
             return "{\"error\": \"No file path provided\"}";
@@ -434,16 +452,51 @@ static std::string berryHandlerImpl(const std::string &command)
                meta.iconType + "\",\"iconValue\":\"" + meta.iconValue + "\"}";
     }
 
+    if (operation == "reindex")
+    {
+        size_t count = rebuildBerryAppIndex();
+        return std::string(R"({"event":"berry", "status":"reindexed", "apps":)") + std::to_string(count) + "}";
+    }
+
+    if (operation == "stats")
+    {
+        std::string json = "{\"apps\":[";
+        bool first = true;
+        for (auto *app : BerryApp::instances())
+        {
+            if (!first)
+            {
+                json += ",";
+            }
+            first = false;
+            json += std::string("{\"name\":\"") + app->name() +
+                    "\",\"liveHandles\":" + std::to_string(app->liveHandleCount()) +
+                    ",\"handleSlots\":" + std::to_string(app->handleCapacity()) +
+                    ",\"callbacks\":" + std::to_string(app->callbackCount()) + "}";
+        }
+        BerryGcStats gc = berryGcStats();
+        json += std::string("],\"gc\":{\"idleCollections\":") + std::to_string(gc.idleCollections) +
+                ",\"allocCollections\":" + std::to_string(gc.allocCollections) +
+                ",\"skippedNoBudget\":" + std::to_string(gc.skippedNoBudget) +
+                ",\"lastPauseUs\":" + std::to_string(gc.lastPauseUs) +
+                ",\"maxIdlePauseUs\":" + std::to_string(gc.maxIdlePauseUs) +
+                ",\"maxAllocPauseUs\":" + std::to_string(gc.maxAllocPauseUs) +
+                ",\"totalIdlePauseUs\":" + std::to_string(gc.totalIdlePauseUs) +
+                ",\"totalAllocPauseUs\":" + std::to_string(gc.totalAllocPauseUs) +
+                ",\"heapAfterLast\":" + std::to_string(gc.heapAfterLast) + "}}";
+        return json;
+    }
+
     return "{\"error\": \"Usage: berry eval <code> | berry run <path> | berry open <appname> | berry panel "
-           "<appname> | berry apps | berry meta <path>\"}";
+           "<appname> | berry apps | berry reindex | berry meta <path> | berry stats\"}";
 }
 
-static std::string berryHandler(const std::string &command)
+static std::string berryHandler(const CommandArgs &args)
 {
 #if ENABLE_UI
-    return UI::postToUITaskWithResult([&command]() -> std::string { return berryHandlerImpl(command); });
+    return UI::postToUITaskWithResult([&args]() -> std::string { return berryHandlerImpl(args); });
 #else
-    return berryHandlerImpl(command);
+    return berryHandlerImpl(args);
 #endif
 }
 
@@ -451,7 +504,8 @@ static std::string berryHandler(const std::string &command)
 
 static FeatureAction berryAction = {.name = "berry",
                                     .handler = berryHandler,
-                                    .transports = {.cli = true, .rest = false, .ws = true, .scripting = true}};
+                                    .transports = {.cli = true, .rest = false, .ws = true, .scripting = true},
+                                    .uiTask = ENABLE_UI};
 
 // --- Feature ---
 
@@ -477,10 +531,15 @@ Feature *BerryFeature = new Feature(
         }
 
         registerNativeFunction("action", native_action);
+        registerNativeFunction("action_obj", native_action_obj);
         registerNativeFunction("log", native_log);
 
 #if ENABLE_BERRY
         registerBerryUIModule(berry_vm);
+        berryGcAttach(berry_vm);
+#if ENABLE_UI
+        UI::setIdleHandler(berryGcIdle);
+#endif
 #endif
 
         actionRegistryInstance->registerAction(&berryAction);
@@ -512,6 +571,9 @@ Feature *BerryFeature = new Feature(
         {
             auto doDelete = []()
             {
+#if ENABLE_UI
+                UI::setIdleHandler(nullptr);
+#endif
                 be_vm_delete(berry_vm);
                 berry_vm = nullptr;
             };
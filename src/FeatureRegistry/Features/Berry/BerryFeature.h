@@ -14,6 +14,7 @@ extern "C"
 
 #include <vector>
 #include <string>
+#include <ctime>
 
 struct BerryScriptInfo
 {
@@ -22,12 +23,13 @@ struct BerryScriptInfo
     std::string startMenu;
     std::string iconType;  // "builtin", "file", "procedural", or empty
     std::string iconValue; // builtin name, file path, or empty
+    time_t mtime = 0;      // script mtime/size when the header was parsed
+    long size = 0;
 };
 
 BerryScriptInfo parseAppMetadata(const std::string &path);
 
 bvm *getBerryVM();
-std::vector<BerryScriptInfo> scanBerryScripts(const char *dir = "/berry/apps");
 void openBerryScript(const std::string &filePath);
 void openBerryPanel(const std::string &filePath);
 
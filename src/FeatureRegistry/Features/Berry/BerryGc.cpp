@@ -0,0 +1,108 @@
+#include "BerryGc.h"
+
+#if ENABLE_BERRY
+
+#include <cstdarg>
+#include <esp_timer.h>
+
+// Not part of berry.h, but exported by be_gc.c
+extern "C"
+{
+    void be_gc_collect(bvm *vm);
+    size_t be_gc_memcount(bvm *vm);
+}
+
+// Heap growth since the last collection before an idle collection is worth it
+#define IDLE_GC_MIN_GROWTH 4096
+// Required slack for the first idle collection, before any pause was measured
+#define IDLE_GC_FIRST_BUDGET_US 8000
+
+static BerryGcStats s_stats;
+static int64_t s_gcStartUs = 0;
+static bool s_idleCollect = false;
+static uint32_t s_usPerKb = 0; // smoothed pause per KB of heap, 0 until measured
+static size_t s_heapBefore = 0;
+
+static void gcObsHook(bvm *vm, int event, ...)
+{
+    (void)vm;
+    if (event == BE_OBS_GC_START)
+    {
+        va_list args;
+        va_start(args, event);
+        s_heapBefore = va_arg(args, size_t);
+        va_end(args);
+        s_gcStartUs = esp_timer_get_time();
+    }
+    else if (event == BE_OBS_GC_END)
+    {
+        va_list args;
+        va_start(args, event);
+        s_stats.heapAfterLast = va_arg(args, size_t);
+        va_end(args);
+
+        uint32_t pause = (uint32_t)(esp_timer_get_time() - s_gcStartUs);
+        s_stats.lastPauseUs = pause;
+        if (s_idleCollect)
+        {
+            s_stats.idleCollections++;
+            s_stats.totalIdlePauseUs += pause;
+            if (pause > s_stats.maxIdlePauseUs)
+                s_stats.maxIdlePauseUs = pause;
+        }
+        else
+        {
+            s_stats.allocCollections++;
+            s_stats.totalAllocPauseUs += pause;
+            if (pause > s_stats.maxAllocPauseUs)
+                s_stats.maxAllocPauseUs = pause;
+        }
+
+        // mark cost scales with the heap that was walked
+        uint32_t kb = (uint32_t)(s_heapBefore / 1024) + 1;
+        uint32_t sample = pause / kb + 1;
+        s_usPerKb = s_usPerKb == 0 ? sample : (s_usPerKb * 3 + sample) / 4;
+    }
+}
+
+void berryGcAttach(bvm *vm)
+{
+    s_stats = BerryGcStats();
+    s_usPerKb = 0;
+    be_set_obs_hook(vm, gcObsHook);
+}
+
+void berryGcIdle(int64_t budgetUs)
+{
+    bvm *vm = getBerryVM();
+    if (!vm)
+    {
+        return;
+    }
+
+    size_t usage = be_gc_memcount(vm);
+    size_t after = s_stats.heapAfterLast;
+    size_t minGrowth = after / 4 > IDLE_GC_MIN_GROWTH ? after / 4 : IDLE_GC_MIN_GROWTH;
+    if (usage < after + minGrowth)
+    {
+        return;
+    }
+
+    int64_t estimate = s_usPerKb == 0 ? IDLE_GC_FIRST_BUDGET_US : (int64_t)s_usPerKb * (int64_t)(usage / 1024 + 1);
+    if (estimate > budgetUs)
+    {
+        s_stats.skippedNoBudget++;
+        return;
+    }
+
+    s_idleCollect = true;
+    be_gc_collect(vm);
+    s_idleCollect = false;
+}
+
+BerryGcStats berryGcStats()
+{
+    return s_stats;
+}
+
+#endif // ENABLE_BERRY
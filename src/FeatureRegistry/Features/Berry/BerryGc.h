@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../../../config.h"
+
+#if ENABLE_BERRY
+
+#include "BerryFeature.h"
+#include <cstddef>
+#include <cstdint>
+
+// Berry's collector is stop-the-world and normally runs when an allocation
+// crosses the heap threshold, i.e. in the middle of whatever callback is
+// allocating. berryGcIdle() runs a collection ahead of that point when the UI
+// loop reports enough slack before the next frame, so the pause lands between
+// frames instead of inside a touch handler.
+
+struct BerryGcStats
+{
+    uint32_t idleCollections = 0;  // run from berryGcIdle()
+    uint32_t allocCollections = 0; // triggered by an allocation inside the VM
+    uint32_t skippedNoBudget = 0;  // idle points where a pause would not fit
+    uint32_t lastPauseUs = 0;
+    uint32_t maxIdlePauseUs = 0;
+    uint32_t maxAllocPauseUs = 0;
+    uint64_t totalIdlePauseUs = 0;
+    uint64_t totalAllocPauseUs = 0;
+    size_t heapAfterLast = 0; // bytes still allocated after the last collection
+};
+
+// Install the observability hook that times every collection
+void berryGcAttach(bvm *vm);
+
+// Collect if the heap has grown enough and the estimated pause fits in budgetUs
+void berryGcIdle(int64_t budgetUs);
+
+BerryGcStats berryGcStats();
+
+#endif // ENABLE_BERRY
@@ -21,12 +21,15 @@
 #include "../UI/elements/menubar.h"
 #include "../UI/Theme.h"
 #include "../UI/Renderer.h"
+#include "../UI/RasterOps.h"
 #include "../Logging.h"
 
 #include "cJSON.h"
 #include <LovyanGFX.hpp>
 #include <new>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include "../../../utils/System.h"
 
 // --- Current app context ---
@@ -108,6 +111,33 @@ public:
                                                 });
     }
 
+    // Raw view over the sprite buffer for direct-memory raster ops
+    UI::Raster::Surface surface()
+    {
+        UI::Raster::Surface s;
+        if (!_spriteOk)
+            return s;
+        s.buf = (uint8_t *)sprite.getBuffer();
+        s.width = sprite.width();
+        s.height = sprite.height();
+        s.bpp = sprite.getColorDepth() & lgfx::color_depth_t::bit_mask;
+        s.stride = s.height > 0 ? (int)(sprite.bufferLength() / s.height) : 0;
+        return s;
+    }
+
+    // Encode a script color the same way drawPixel() would store it
+    uint32_t rawColor(uint16_t color)
+    {
+        auto s = surface();
+        if (!s.valid())
+            return 0;
+        uint32_t saved = s.get(0, 0);
+        sprite.drawPixel(0, 0, color);
+        uint32_t raw = s.get(0, 0);
+        s.set(0, 0, saved);
+        return raw;
+    }
+
     LGFX_Sprite sprite;
     bool _spriteOk{false};
     int _depth{16};
@@ -251,6 +281,75 @@ static void getParentBounds(BerryApp *app, int parentHandle, int &px, int &py, i
         px = py = pw = ph = 0;
 }
 
+// =================================================================
+// Handle release for removed subtrees
+// =================================================================
+
+static void collectHandleSubtree(const std::unordered_map<UI::Element *, HandleType> &types, UI::Element *el,
+                                 HandleType type, std::unordered_set<UI::Element *> &out);
+
+static void collectContainerChildren(const std::unordered_map<UI::Element *, HandleType> &types,
+                                     UI::Container *container, std::unordered_set<UI::Element *> &out)
+{
+    if (!container)
+        return;
+    container->forEachChild(
+        [&](UI::Element *child)
+        {
+            out.insert(child);
+            auto it = types.find(child);
+            if (it != types.end())
+                collectHandleSubtree(types, child, it->second, out);
+        });
+}
+
+// Only elements created through handles can own further handles, so the
+// handle types are enough to find every nested container.
+static void collectHandleSubtree(const std::unordered_map<UI::Element *, HandleType> &types, UI::Element *el,
+                                 HandleType type, std::unordered_set<UI::Element *> &out)
+{
+    switch (type)
+    {
+    case HandleType::CONTAINER:
+    case HandleType::POPUP:
+        collectContainerChildren(types, static_cast<UI::Container *>(el), out);
+        break;
+    case HandleType::SCROLLABLE:
+        collectContainerChildren(types, &static_cast<UI::ScrollableContainer *>(el)->getContent(), out);
+        break;
+    case HandleType::GROUPBOX:
+        collectContainerChildren(types, &static_cast<UI::GroupBox *>(el)->getContent(), out);
+        break;
+    case HandleType::TABS:
+    {
+        auto *tc = static_cast<UI::TabControl *>(el);
+        for (int i = 0; UI::Container *tab = tc->getTabContent(i); i++)
+        {
+            out.insert(tab);
+            collectContainerChildren(types, tab, out);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Release the handles of everything below el (and el itself if includeRoot)
+// before the elements are destroyed, so their slots can be reused.
+static void releaseSubtreeHandles(BerryApp *app, UI::Element *el, HandleType type, bool includeRoot)
+{
+    std::unordered_map<UI::Element *, HandleType> types;
+    app->forEachHandle([&](const HandleEntry &e) { types[e.ptr] = e.type; });
+
+    std::unordered_set<UI::Element *> doomed;
+    if (includeRoot)
+        doomed.insert(el);
+    collectHandleSubtree(types, el, type, doomed);
+
+    app->invalidateHandlesIf([&](const HandleEntry &e) { return doomed.count(e.ptr) > 0; });
+}
+
 // =================================================================
 // Safe allocation helper — avoids abort() on OOM
 // =================================================================
@@ -726,7 +825,7 @@ static int ui_filelist_set_view(bvm *vm)
     be_return_nil(vm);
 }
 
-// ui.filelist_set_items(handle, json_str) -- set items from JSON string
+// ui.filelist_set_items(handle, items) -- set items from a JSON string or a list of maps
 static int ui_filelist_set_items(bvm *vm)
 {
     auto *app = berryCurrentApp();
@@ -737,34 +836,80 @@ static int ui_filelist_set_items(bvm *vm)
     if (!fl)
         be_return_nil(vm);
 
-    if (!be_isstring(vm, 2))
-        be_return_nil(vm);
-
-    const char *jsonStr = be_tostring(vm, 2);
     std::vector<UI::FileItem> items;
 
-    cJSON *root = cJSON_Parse(jsonStr);
-    if (!root)
-        be_return_nil(vm);
+    if (be_isstring(vm, 2))
+    {
+        const char *jsonStr = be_tostring(vm, 2);
+        cJSON *root = cJSON_Parse(jsonStr);
+        if (!root)
+            be_return_nil(vm);
 
-    int count = cJSON_GetArraySize(root);
-    for (int i = 0; i < count; i++)
+        int count = cJSON_GetArraySize(root);
+        for (int i = 0; i < count; i++)
+        {
+            cJSON *obj = cJSON_GetArrayItem(root, i);
+            if (!obj)
+                continue;
+            UI::FileItem item;
+            cJSON *nameItem = cJSON_GetObjectItem(obj, "name");
+            item.name = (nameItem && cJSON_IsString(nameItem)) ? nameItem->valuestring : "?";
+            cJSON *sizeItem = cJSON_GetObjectItem(obj, "size");
+            item.size = (sizeItem && cJSON_IsNumber(sizeItem)) ? sizeItem->valueint : 0;
+            cJSON *isDirItem = cJSON_GetObjectItem(obj, "isDir");
+            item.isDir = (isDirItem && cJSON_IsBool(isDirItem)) ? cJSON_IsTrue(isDirItem) : false;
+            cJSON *lastWriteItem = cJSON_GetObjectItem(obj, "lastWrite");
+            item.lastWrite = (lastWriteItem && cJSON_IsNumber(lastWriteItem)) ? lastWriteItem->valueint : 0;
+            items.push_back(std::move(item));
+        }
+        cJSON_Delete(root);
+    }
+    else if (be_isinstance(vm, 2))
     {
-        cJSON *obj = cJSON_GetArrayItem(root, i);
-        if (!obj)
-            continue;
-        UI::FileItem item;
-        cJSON *nameItem = cJSON_GetObjectItem(obj, "name");
-        item.name = (nameItem && cJSON_IsString(nameItem)) ? nameItem->valuestring : "?";
-        cJSON *sizeItem = cJSON_GetObjectItem(obj, "size");
-        item.size = (sizeItem && cJSON_IsNumber(sizeItem)) ? sizeItem->valueint : 0;
-        cJSON *isDirItem = cJSON_GetObjectItem(obj, "isDir");
-        item.isDir = (isDirItem && cJSON_IsBool(isDirItem)) ? cJSON_IsTrue(isDirItem) : false;
-        cJSON *lastWriteItem = cJSON_GetObjectItem(obj, "lastWrite");
-        item.lastWrite = (lastWriteItem && cJSON_IsNumber(lastWriteItem)) ? lastWriteItem->valueint : 0;
-        items.push_back(std::move(item));
+        // list of maps, e.g. straight from action_obj('list ...')
+        be_getmember(vm, 2, ".p");
+        if (!be_islist(vm, -1))
+        {
+            be_pop(vm, 1);
+            be_return_nil(vm);
+        }
+        int count = be_data_size(vm, -1);
+        for (int i = 0; i < count; i++)
+        {
+            be_pushint(vm, i);
+            be_getindex(vm, -2);
+            if (be_isinstance(vm, -1))
+            {
+                be_getmember(vm, -1, ".p");
+                auto field = [vm](const char *key)
+                {
+                    be_pushstring(vm, key);
+                    be_getindex(vm, -2);
+                };
+                UI::FileItem item;
+                field("name");
+                item.name = be_isstring(vm, -1) ? be_tostring(vm, -1) : "?";
+                be_pop(vm, 2);
+                field("size");
+                item.size = be_isnumber(vm, -1) ? be_toint(vm, -1) : 0;
+                be_pop(vm, 2);
+                field("isDir");
+                item.isDir = be_isbool(vm, -1) && be_tobool(vm, -1);
+                be_pop(vm, 2);
+                field("lastWrite");
+                item.lastWrite = be_isnumber(vm, -1) ? be_toint(vm, -1) : 0;
+                be_pop(vm, 2);
+                items.push_back(std::move(item));
+                be_pop(vm, 1); // map data
+            }
+            be_pop(vm, 2); // index + element
+        }
+        be_pop(vm, 1); // list data
+    }
+    else
+    {
+        be_return_nil(vm);
     }
-    cJSON_Delete(root);
 
     fl->setItems(items);
     be_return_nil(vm);
@@ -1307,17 +1452,20 @@ static int ui_clear(bvm *vm)
 
     if (h->type == HandleType::SCROLLABLE)
     {
+        releaseSubtreeHandles(app, h->ptr, h->type, false);
         static_cast<UI::ScrollableContainer *>(h->ptr)->getContent().clear();
         be_return_nil(vm);
     }
 
     if (h->type == HandleType::CONTAINER)
     {
+        releaseSubtreeHandles(app, h->ptr, h->type, false);
         static_cast<UI::Container *>(h->ptr)->clear();
     }
 
     if (h->type == HandleType::POPUP)
     {
+        releaseSubtreeHandles(app, h->ptr, h->type, false);
         static_cast<UI::PopupContainer *>(h->ptr)->clear();
     }
 
@@ -1331,39 +1479,26 @@ static int ui_remove_child(bvm *vm)
     if (!app || be_top(vm) < 2)
         be_return_nil(vm);
 
-    int parentIdx = be_toint(vm, 1);
-    int childIdx = be_toint(vm, 2);
-
-    auto *ph = app->getHandle(parentIdx);
-    auto *ch = app->getHandle(childIdx);
+    auto *ph = app->getHandle(be_toint(vm, 1));
+    auto *ch = app->getHandle(be_toint(vm, 2));
     if (!ph || !ch)
         be_return_nil(vm);
 
+    UI::Container *from = nullptr;
     if (ph->type == HandleType::SCROLLABLE)
-    {
-        static_cast<UI::ScrollableContainer *>(ph->ptr)->getContent().removeChild(ch->ptr);
-        app->invalidateHandle(childIdx);
+        from = &static_cast<UI::ScrollableContainer *>(ph->ptr)->getContent();
+    else if (ph->type == HandleType::CONTAINER)
+        from = static_cast<UI::Container *>(ph->ptr);
+    else if (ph->type == HandleType::GROUPBOX)
+        from = &static_cast<UI::GroupBox *>(ph->ptr)->getContent();
+    else if (ph->type == HandleType::POPUP)
+        from = static_cast<UI::PopupContainer *>(ph->ptr);
+    if (!from)
         be_return_nil(vm);
-    }
-
-    if (ph->type == HandleType::CONTAINER)
-    {
-        static_cast<UI::Container *>(ph->ptr)->removeChild(ch->ptr);
-        app->invalidateHandle(childIdx);
-        be_return_nil(vm);
-    }
-
-    if (ph->type == HandleType::GROUPBOX)
-    {
-        static_cast<UI::GroupBox *>(ph->ptr)->getContent().removeChild(ch->ptr);
-        app->invalidateHandle(childIdx);
-    }
 
-    if (ph->type == HandleType::POPUP)
-    {
-        static_cast<UI::PopupContainer *>(ph->ptr)->removeChild(ch->ptr);
-        app->invalidateHandle(childIdx);
-    }
+    UI::Element *child = ch->ptr;
+    releaseSubtreeHandles(app, child, ch->type, true);
+    from->removeChild(child);
 
     be_return_nil(vm);
 }
@@ -1453,89 +1588,65 @@ static int ui_canvas_read_pixel(bvm *vm)
     be_return(vm);
 }
 
+// ui.canvas_flood_fill(canvas, x, y, color)
 static int ui_canvas_flood_fill(bvm *vm)
 {
     auto *app = berryCurrentApp();
     GET_CANVAS(vm, app, 4);
+    auto surface = cv->surface();
+    uint32_t raw = cv->rawColor((uint16_t)be_toint(vm, 4));
+    UI::Raster::floodFill(surface, be_toint(vm, 2), be_toint(vm, 3), raw);
+    be_return_nil(vm);
+}
 
-    int fx = be_toint(vm, 2);
-    int fy = be_toint(vm, 3);
-    uint16_t fillColor = (uint16_t)be_toint(vm, 4);
-
-    int bx, by, cvW, cvH;
-    cv->getBounds(bx, by, cvW, cvH);
-
-    if (fx < 0 || fx >= cvW || fy < 0 || fy >= cvH)
+// ui.canvas_blit(dst, dx, dy, src [, sx, sy, w, h]) -> bool
+static int ui_canvas_blit(bvm *vm)
+{
+    auto *app = berryCurrentApp();
+    GET_CANVAS(vm, app, 4);
+    auto *src = asCanvas(app->getHandle(be_toint(vm, 4)));
+    if (!src || !src->_spriteOk)
         be_return_nil(vm);
 
-    uint32_t targetColor = cv->sprite.readPixel(fx, fy);
-    cv->sprite.drawPixel(fx, fy, fillColor);
-    uint32_t filledColor = cv->sprite.readPixel(fx, fy);
-    if (filledColor == targetColor)
-        be_return_nil(vm);
+    int dx = be_toint(vm, 2);
+    int dy = be_toint(vm, 3);
+    bool hasRect = be_top(vm) >= 8;
+    int sx = hasRect ? be_toint(vm, 5) : 0;
+    int sy = hasRect ? be_toint(vm, 6) : 0;
+    int w = hasRect ? be_toint(vm, 7) : src->sprite.width();
+    int h = hasRect ? be_toint(vm, 8) : src->sprite.height();
 
-    struct Seed
-    {
-        int16_t x, y;
-    };
-    std::vector<Seed> stack;
-    stack.reserve(256);
-
-    if (fx > 0)
-        stack.push_back({(int16_t)(fx - 1), (int16_t)fy});
-    if (fx < cvW - 1)
-        stack.push_back({(int16_t)(fx + 1), (int16_t)fy});
-    if (fy > 0)
-        stack.push_back({(int16_t)fx, (int16_t)(fy - 1)});
-    if (fy < cvH - 1)
-        stack.push_back({(int16_t)fx, (int16_t)(fy + 1)});
-
-    while (!stack.empty())
+    bool ok = UI::Raster::blit(cv->surface(), dx, dy, src->surface(), sx, sy, w, h);
+    if (!ok)
     {
-        Seed s = stack.back();
-        stack.pop_back();
-        if (s.x < 0 || s.x >= cvW || s.y < 0 || s.y >= cvH)
-            continue;
-        if (cv->sprite.readPixel(s.x, s.y) != targetColor)
-            continue;
-
-        int left = s.x;
-        while (left > 0 && cv->sprite.readPixel(left - 1, s.y) == targetColor)
-            left--;
-
-        int right = left;
-        bool aboveQ = false, belowQ = false;
-        while (right < cvW && cv->sprite.readPixel(right, s.y) == targetColor)
-        {
-            cv->sprite.drawPixel(right, s.y, fillColor);
-            if (s.y > 0)
-            {
-                bool m = (cv->sprite.readPixel(right, s.y - 1) == targetColor);
-                if (m && !aboveQ)
-                {
-                    stack.push_back({(int16_t)right, (int16_t)(s.y - 1)});
-                    aboveQ = true;
-                }
-                else if (!m)
-                    aboveQ = false;
-            }
-            if (s.y < cvH - 1)
-            {
-                bool m = (cv->sprite.readPixel(right, s.y + 1) == targetColor);
-                if (m && !belowQ)
-                {
-                    stack.push_back({(int16_t)right, (int16_t)(s.y + 1)});
-                    belowQ = true;
-                }
-                else if (!m)
-                    belowQ = false;
-            }
-            right++;
-        }
-        if (stack.size() > 2000)
-            break;
+        // depths differ: let LovyanGFX convert, clipped to the destination rect
+        cv->sprite.setClipRect(dx, dy, w, h);
+        src->sprite.pushSprite(&cv->sprite, dx - sx, dy - sy);
+        cv->sprite.clearClipRect();
+        ok = true;
     }
+    be_pushbool(vm, ok);
+    be_return(vm);
+}
+
+// ui.canvas_copy_rect(canvas, sx, sy, w, h, dx, dy)
+static int ui_canvas_copy_rect(bvm *vm)
+{
+    auto *app = berryCurrentApp();
+    GET_CANVAS(vm, app, 7);
+    auto surface = cv->surface();
+    UI::Raster::blit(surface, be_toint(vm, 6), be_toint(vm, 7), surface, be_toint(vm, 2), be_toint(vm, 3),
+                     be_toint(vm, 4), be_toint(vm, 5));
+    be_return_nil(vm);
+}
 
+// ui.canvas_scroll(canvas, dx, dy, fill_color)
+static int ui_canvas_scroll(bvm *vm)
+{
+    auto *app = berryCurrentApp();
+    GET_CANVAS(vm, app, 4);
+    uint32_t raw = cv->rawColor((uint16_t)be_toint(vm, 4));
+    UI::Raster::scroll(cv->surface(), be_toint(vm, 2), be_toint(vm, 3), raw);
     be_return_nil(vm);
 }
 
@@ -1566,9 +1677,9 @@ static int ui_popup(bvm *vm)
     int w = be_toint(vm, 3);
     int h = be_toint(vm, 4);
 
-    loggerInstance->Info(std::string("ui.popup: creating at (") + std::to_string(x) + "," + std::to_string(y) + "," +
-                         std::to_string(w) + "," + std::to_string(h) + ") screen=" +
-                         std::to_string(UI::Theme::ScreenWidth()) + "x" + std::to_string(UI::Theme::ScreenHeight()));
+    LOG_DEBUG(std::string("ui.popup: creating at (") + std::to_string(x) + "," + std::to_string(y) + "," +
+              std::to_string(w) + "," + std::to_string(h) + ") screen=" + std::to_string(UI::Theme::ScreenWidth()) +
+              "x" + std::to_string(UI::Theme::ScreenHeight()));
     auto *popup = UI::windowManager().createPopup(x, y, w, h, app);
     if (!popup)
         be_return_nil(vm);
@@ -1606,9 +1717,9 @@ static int ui_show_popup(bvm *vm)
 
     int bx, by, bw, bh;
     popup->getBounds(bx, by, bw, bh);
-    loggerInstance->Info(std::string("show_popup: handle=") + std::to_string(h) + " bounds=(" + std::to_string(bx) +
-                         "," + std::to_string(by) + "," + std::to_string(bw) + "," + std::to_string(bh) +
-                         ") children=" + std::to_string(popup->getChildren().size()));
+    LOG_DEBUG(std::string("show_popup: handle=") + std::to_string(h) + " bounds=(" + std::to_string(bx) + "," +
+              std::to_string(by) + "," + std::to_string(bw) + "," + std::to_string(bh) +
+              ") children=" + std::to_string(popup->getChildren().size()));
     popup->show();
     UI::markDirty();
     be_return_nil(vm);
@@ -1641,8 +1752,8 @@ static int ui_destroy_popup(bvm *vm)
     auto *popup = asPopup(app->getHandle(h));
     if (popup)
     {
+        releaseSubtreeHandles(app, popup, HandleType::POPUP, true);
         UI::windowManager().destroyPopup(popup);
-        app->invalidateHandle(h);
     }
     be_return_nil(vm);
 }
@@ -1779,6 +1890,9 @@ void registerBerryUIModule(bvm *vm)
     reg("canvas_draw_ellipse", ui_canvas_draw_ellipse);
     reg("canvas_read_pixel", ui_canvas_read_pixel);
     reg("canvas_flood_fill", ui_canvas_flood_fill);
+    reg("canvas_blit", ui_canvas_blit);
+    reg("canvas_copy_rect", ui_canvas_copy_rect);
+    reg("canvas_scroll", ui_canvas_scroll);
     reg("canvas_set_palette", ui_canvas_set_palette);
 
     // icon drawing
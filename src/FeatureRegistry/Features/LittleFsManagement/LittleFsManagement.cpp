@@ -1,8 +1,10 @@
 #include "LittleFsManagement.h"
 #include "../../../ActionRegistry/ActionRegistry.h"
-#include "../../../CommandInterpreter/CommandParser.h"
+#include "../../../CommandInterpreter/CommandArgs.h"
 #include "../../../fs/VirtualFS.h"
 #include "../../../fs/LittleFsInit.h"
+#include "../../../utils/BufferedFileWriter.h"
+#include "../Berry/BerryAppIndex.h"
 #include <string>
 
 #include "cJSON.h"
@@ -11,7 +13,7 @@
 static FeatureAction formatAction = {.name = "format",
                                      .type = "POST",
                                      .handler =
-                                         [](const std::string & /*command*/)
+                                         [](const CommandArgs & /*args*/)
                                      {
                                          deinitLittleFs();
                                          formatLittleFs();
@@ -23,59 +25,173 @@ static FeatureAction formatAction = {.name = "format",
                                      },
                                      .transports = {.cli = true, .rest = false, .ws = true, .scripting = true}};
 
-static FeatureAction listFilesAction = {.name = "list",
-                                        .handler =
-                                            [](const std::string &command)
-                                        {
-                                            std::string path = CommandParser::getCommandParameter(command, 1);
-                                            if (path.empty())
-                                            {
-                                                path = "/";
-                                            }
+static cJSON *listFiles(const CommandArgs &args)
+{
+    std::string path = args.str(1);
+    if (path.empty())
+    {
+        path = "/";
+    }
 
-                                            cJSON *response = nullptr;
+    if (path != "/")
+    {
+        ResolvedPath resolved = resolveVirtualPath(path);
+        return getFileList(resolved.valid ? resolved.realPath : resolveToLittleFsPath(path));
+    }
 
-                                            if (path == "/")
-                                            {
-                                                response = cJSON_CreateArray();
+    cJSON *response = cJSON_CreateArray();
 
-                                                cJSON *flash = cJSON_CreateObject();
-                                                cJSON_AddStringToObject(flash, "name", "flash");
-                                                cJSON_AddNumberToObject(flash, "size", 0);
-                                                cJSON_AddBoolToObject(flash, "isDir", true);
-                                                cJSON_AddNumberToObject(flash, "lastWrite", 0);
-                                                cJSON_AddItemToArray(response, flash);
+    cJSON *flash = cJSON_CreateObject();
+    cJSON_AddStringToObject(flash, "name", "flash");
+    cJSON_AddNumberToObject(flash, "size", 0);
+    cJSON_AddBoolToObject(flash, "isDir", true);
+    cJSON_AddNumberToObject(flash, "lastWrite", 0);
+    cJSON_AddItemToArray(response, flash);
 
 #if ENABLE_SD_CARD
-                                                if (isSdMounted())
-                                                {
-                                                    cJSON *sd = cJSON_CreateObject();
-                                                    cJSON_AddStringToObject(sd, "name", "sd");
-                                                    cJSON_AddNumberToObject(sd, "size", 0);
-                                                    cJSON_AddBoolToObject(sd, "isDir", true);
-                                                    cJSON_AddNumberToObject(sd, "lastWrite", 0);
-                                                    cJSON_AddItemToArray(response, sd);
-                                                }
+    if (isSdMounted())
+    {
+        cJSON *sd = cJSON_CreateObject();
+        cJSON_AddStringToObject(sd, "name", "sd");
+        cJSON_AddNumberToObject(sd, "size", 0);
+        cJSON_AddBoolToObject(sd, "isDir", true);
+        cJSON_AddNumberToObject(sd, "lastWrite", 0);
+        cJSON_AddItemToArray(response, sd);
+    }
 #endif
-                                            }
-                                            else
-                                            {
-                                                ResolvedPath resolved = resolveVirtualPath(path);
-                                                if (resolved.valid)
-                                                {
-                                                    response = getFileList(resolved.realPath);
-                                                }
-                                                else
-                                                {
-                                                    response = getFileList(resolveToLittleFsPath(path));
-                                                }
-                                            }
-
-                                            std::string output = cJsonToString(response);
-                                            cJSON_Delete(response);
-                                            return output;
+
+    return response;
+}
+
+static void streamListFiles(const CommandArgs &args, JsonWriter &out)
+{
+    std::string path = args.str(1);
+    if (!path.empty() && path != "/")
+    {
+        // list <path> [offset=N] [limit=N] [sort=[-]name|size|mtime] [stat=0]
+        FileListQuery query;
+        for (size_t i = 2; i < args.size(); i++)
+        {
+            std::string option = args.str(i);
+            size_t eq = option.find('=');
+            if (eq == std::string::npos || !query.set(option.substr(0, eq), option.substr(eq + 1)))
+            {
+                out.beginObject().field("error", "Invalid list option: " + option).endObject();
+                return;
+            }
+        }
+
+        ResolvedPath resolved = resolveVirtualPath(path);
+        std::string realPath = resolved.valid ? resolved.realPath : resolveToLittleFsPath(path);
+        if (query.paged)
+        {
+            writeFileListPage(out, realPath, query);
+        }
+        else
+        {
+            writeFileList(out, realPath);
+        }
+        return;
+    }
+
+    // the root only holds the mount points, reuse the tree version
+    CJsonPtr roots(listFiles(args));
+    out.value(roots.get());
+}
+
+static FeatureAction listFilesAction = {.name = "list",
+                                        .handler =
+                                            [](const CommandArgs &args)
+                                        {
+                                            return JsonWriter::toString([&args](JsonWriter &out)
+                                                                        { streamListFiles(args, out); });
                                         },
-                                        .transports = {.cli = true, .rest = false, .ws = true, .scripting = true}};
+                                        .objectHandler = listFiles,
+                                        .streamHandler = streamListFiles,
+                                        .transports = {.cli = true, .rest = false, .ws = true, .scripting = true},
+                                        .async = true};
+
+// write <path> <text>: the file gets the rest of the line. Over REST the
+// request body is the content and goes to the file as it arrives:
+//     PUT /write?/flash/notes.txt
+static bool openForWrite(const CommandArgs &args, BufferedFileWriter &writer, std::string &error)
+{
+    std::string path = args.str(1);
+    ResolvedPath resolved = resolveVirtualPath(path);
+    if (!resolved.valid || path.find("..") != std::string::npos)
+    {
+        error = "Path must start with /flash or /sd";
+        return false;
+    }
+    vfsMkdirs(resolved.realPath);
+    if (!writer.open(resolved.realPath, vfsWriteBufferSize(resolved.realPath)))
+    {
+        error = "Failed to open file for writing";
+        return false;
+    }
+    return true;
+}
+
+static void writeResult(JsonWriter &out, const CommandArgs &args, BufferedFileWriter &writer, bool ok)
+{
+    size_t bytes = writer.bytesWritten();
+    if (!ok)
+        writer.abort(); // drops the partial file
+    else
+        ok = writer.close();
+    if (!ok)
+    {
+        out.beginObject().field("error", "Write failed").endObject();
+        return;
+    }
+#if ENABLE_BERRY
+    notifyBerryAppsChanged(resolveVirtualPath(args.str(1)).realPath);
+#endif
+    out.beginObject().field("event", "write").field("path", args.str(1)).field("bytes", bytes).endObject();
+}
+
+static void writeFromBody(const CommandArgs &args, RequestBody &body, JsonWriter &out)
+{
+    BufferedFileWriter writer;
+    std::string error;
+    if (!openForWrite(args, writer, error))
+    {
+        out.beginObject().field("error", error).endObject();
+        return;
+    }
+
+    char buf[1024];
+    int len;
+    bool ok = true;
+    while (ok && (len = body.read(buf, sizeof(buf))) != 0)
+        ok = len > 0 && writer.write((const uint8_t *)buf, len);
+    writeResult(out, args, writer, ok);
+}
+
+static void writeFromText(const CommandArgs &args, JsonWriter &out)
+{
+    BufferedFileWriter writer;
+    std::string error;
+    if (!openForWrite(args, writer, error))
+    {
+        out.beginObject().field("error", error).endObject();
+        return;
+    }
+    std::string_view text = args.rest(2);
+    writeResult(out, args, writer, writer.write((const uint8_t *)text.data(), text.size()));
+}
+
+static FeatureAction writeAction = {.name = "write",
+                                    .type = "PUT",
+                                    .handler =
+                                        [](const CommandArgs &args)
+                                    {
+                                        return JsonWriter::toString([&args](JsonWriter &out)
+                                                                    { writeFromText(args, out); });
+                                    },
+                                    .bodyHandler = writeFromBody,
+                                    .transports = {.cli = true, .rest = true, .ws = true, .scripting = true},
+                                    .async = true};
 
 Feature *LittleFsFeature = new Feature("LittleFsFeatures", []()
                                        {
@@ -89,6 +205,7 @@ Feature *LittleFsFeature = new Feature("LittleFsFeatures", []()
     }
 
     actionRegistryInstance->registerAction(&listFilesAction);
+    actionRegistryInstance->registerAction(&writeAction);
     return FeatureState::RUNNING; }, []() {
 
                                        });
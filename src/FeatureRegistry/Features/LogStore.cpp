@@ -0,0 +1,440 @@
+#include "LogStore.h"
+
+#if ENABLE_LOG_STORE
+
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#include "Logging.h"
+#include "../../ActionRegistry/ActionRegistry.h"
+#include "../../CommandInterpreter/CommandArgs.h"
+#include "../../fs/VirtualFS.h"
+#include "../../utils/JsonWriter.h"
+#include "../../utils/System.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "LogStore";
+
+// Segment files; guarded by fileMutex
+static std::mutex fileMutex;
+static std::string storeDir; // real path, empty until setup succeeded
+static size_t segmentBytes = 0;
+static uint32_t firstSegment = 0;
+static uint32_t currentSegment = 0;
+static size_t currentSize = 0;
+static uint32_t bytesWritten = 0;
+static uint32_t writeErrors = 0;
+
+// Two blocks: the log dispatcher fills the active one while the writer task
+// appends the other. Guarded by blockMutex.
+static std::mutex blockMutex;
+static_assert(LOG_STORE_BLOCK_SIZE >= LOG_DISPATCH_BATCH * (LOG_STORE_HEADER_SIZE + LOG_MESSAGE_MAX),
+              "one dispatch batch must fit into an empty block");
+static uint8_t blocks[2][LOG_STORE_BLOCK_SIZE];
+static size_t blockFill[2] = {0, 0};
+static int activeBlock = 0;
+static uint32_t recordsStored = 0;
+static uint32_t recordsDropped = 0;
+
+static TaskHandle_t writerTask = nullptr;
+
+static std::string segmentPath(uint32_t segment)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "/%08lu.bin", (unsigned long)segment);
+    return storeDir + name;
+}
+
+// Appends whole records to the current segment, starting the next one when
+// they do not fit. Caller holds fileMutex.
+static void appendToSegment(const uint8_t *data, size_t len)
+{
+    if (currentSize > 0 && currentSize + len > segmentBytes)
+    {
+        currentSegment++;
+        currentSize = 0;
+        while (currentSegment - firstSegment >= LOG_STORE_SEGMENTS)
+        {
+            remove(segmentPath(firstSegment).c_str());
+            firstSegment++;
+        }
+    }
+
+    FILE *f = fopen(segmentPath(currentSegment).c_str(), "ab");
+    if (!f)
+    {
+        // ESP_LOG only: going through the logger would feed this failure back in
+        ESP_LOGW(TAG, "Cannot open segment %lu", (unsigned long)currentSegment);
+        writeErrors++;
+        return;
+    }
+    size_t written = fwrite(data, 1, len, f);
+    fclose(f);
+    fsWrittenBytes.inc(written);
+    if (written != len)
+        writeErrors++;
+    currentSize += written;
+    bytesWritten += written;
+}
+
+// Writes the block waiting for the writer, and with partial also the records
+// collected in the active block so far.
+static void writePendingBlocks(bool partial)
+{
+    std::lock_guard<std::mutex> fileLock(fileMutex);
+    if (storeDir.empty())
+        return;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        int block;
+        size_t len;
+        {
+            std::lock_guard<std::mutex> lock(blockMutex);
+            block = 1 - activeBlock;
+            len = blockFill[block];
+            if (len == 0 && partial && blockFill[activeBlock] > 0)
+            {
+                block = activeBlock;
+                activeBlock = 1 - activeBlock;
+                len = blockFill[block];
+            }
+        }
+        if (len == 0)
+            return;
+
+        appendToSegment(blocks[block], len);
+
+        std::lock_guard<std::mutex> lock(blockMutex);
+        blockFill[block] = 0;
+    }
+}
+
+// Log listener, runs on the log dispatch task: only copies into a block
+static void storeLogRecords(const LogRecord *records, size_t count)
+{
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(blockMutex);
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t length = records[i].length > 255 ? 255 : records[i].length;
+            size_t size = LOG_STORE_HEADER_SIZE + length;
+            if (blockFill[activeBlock] + size > LOG_STORE_BLOCK_SIZE)
+            {
+                int other = 1 - activeBlock;
+                if (blockFill[other] != 0)
+                {
+                    // the writer has not caught up with the previous block
+                    recordsDropped++;
+                    continue;
+                }
+                activeBlock = other;
+                wake = true;
+            }
+            blockFill[activeBlock] += encodeLogStoreRecord(blocks[activeBlock] + blockFill[activeBlock],
+                                                           records[i].severity, records[i].epochTime,
+                                                           records[i].message, length);
+            recordsStored++;
+        }
+    }
+    if (wake && writerTask)
+        xTaskNotifyGive(writerTask);
+}
+
+static void logStoreWriterLoop(void *)
+{
+    while (true)
+    {
+        bool blockFull = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_STORE_FLUSH_MS)) > 0;
+        writePendingBlocks(!blockFull);
+    }
+}
+
+// Finds the existing segment numbers so numbering continues after a reboot
+static void scanSegments()
+{
+    bool found = false;
+    uint32_t lowest = 0, highest = 0;
+    DIR *dir = opendir(storeDir.c_str());
+    if (dir)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr)
+        {
+            char *end = nullptr;
+            unsigned long number = strtoul(entry->d_name, &end, 10);
+            if (end == entry->d_name || strcmp(end, ".bin") != 0)
+                continue;
+            if (!found || number < lowest)
+                lowest = number;
+            if (!found || number > highest)
+                highest = number;
+            found = true;
+        }
+        closedir(dir);
+    }
+
+    firstSegment = found ? lowest : 0;
+    currentSegment = found ? highest : 0;
+    while (currentSegment - firstSegment >= LOG_STORE_SEGMENTS)
+    {
+        remove(segmentPath(firstSegment).c_str());
+        firstSegment++;
+    }
+
+    struct stat st;
+    currentSize = stat(segmentPath(currentSegment).c_str(), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+struct LogStoreQuery
+{
+    time_t from = 0;
+    time_t to = 0; // 0 = no upper bound
+    bool text = false;
+
+    bool set(const std::string &key, const std::string &value)
+    {
+        if (key == "format")
+        {
+            if (value != "json" && value != "text")
+                return false;
+            text = value == "text";
+            return true;
+        }
+        char *end = nullptr;
+        unsigned long number = strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0')
+            return false;
+        if (key == "from")
+            from = (time_t)number;
+        else if (key == "to")
+            to = (time_t)number;
+        else
+            return false;
+        return true;
+    }
+};
+
+static void writeRecord(JsonWriter &out, const LogStoreRecord &record, bool text, UtcTimeCache &utcTimeCache,
+                        std::string &message)
+{
+    const char *utcTime = utcTimeCache.format(record.epochTime);
+
+    if (text)
+    {
+        message.assign(utcTime);
+        message += " [";
+        message += record.severity;
+        message += "] ";
+        message.append(record.message, record.length);
+        out.value(message);
+        return;
+    }
+
+    const char severity[2] = {record.severity, 0};
+    message.assign(record.message, record.length);
+    out.beginObject()
+        .field("severity", (const char *)severity)
+        .field("message", message)
+        .field("epochTime", (long long)record.epochTime)
+        .field("isoDateTime", utcTime)
+        .endObject();
+}
+
+// Decodes the segments oldest first and writes the records in the range
+static void writeStoredRecords(JsonWriter &out, const LogStoreQuery &query)
+{
+    // include what is still buffered
+    writePendingBlocks(true);
+
+    uint32_t first, last;
+    {
+        std::lock_guard<std::mutex> lock(fileMutex);
+        first = firstSegment;
+        last = currentSegment;
+    }
+
+    std::vector<uint8_t> buffer(LOG_STORE_BLOCK_SIZE + LOG_STORE_HEADER_SIZE + 255);
+    std::string message;
+    UtcTimeCache utcTime;
+    LogStoreRecord record;
+    out.beginArray();
+    for (uint32_t segment = first; segment <= last && out.ok(); segment++)
+    {
+        // a segment rotated away since the snapshot is simply missing
+        FILE *f = fopen(segmentPath(segment).c_str(), "rb");
+        if (!f)
+            continue;
+
+        size_t have = 0;
+        bool eof = false;
+        while (!eof || have > 0)
+        {
+            if (!eof)
+            {
+                size_t n = fread(buffer.data() + have, 1, buffer.size() - have, f);
+                fsReadBytes.inc(n);
+                have += n;
+                eof = n == 0;
+            }
+
+            size_t pos = 0;
+            while (pos < have)
+            {
+                int used = decodeLogStoreRecord(buffer.data() + pos, have - pos, record);
+                if (used == 0 && !eof)
+                    break; // need more data
+                if (used <= 0)
+                {
+                    pos++; // torn or corrupt record: resync on the next marker
+                    continue;
+                }
+                pos += used;
+                if (record.epochTime >= query.from && (query.to == 0 || record.epochTime <= query.to))
+                    writeRecord(out, record, query.text, utcTime, message);
+            }
+            memmove(buffer.data(), buffer.data() + pos, have - pos);
+            have -= pos;
+        }
+        fclose(f);
+    }
+    out.endArray();
+}
+
+static void writeLogStoreInfo(JsonWriter &out)
+{
+    std::string dir;
+    uint32_t first, current, written, errors;
+    size_t size;
+    {
+        std::lock_guard<std::mutex> lock(fileMutex);
+        dir = storeDir;
+        first = firstSegment;
+        current = currentSegment;
+        size = currentSize;
+        written = bytesWritten;
+        errors = writeErrors;
+    }
+    uint32_t stored, dropped;
+    size_t buffered;
+    {
+        std::lock_guard<std::mutex> lock(blockMutex);
+        stored = recordsStored;
+        dropped = recordsDropped;
+        buffered = blockFill[0] + blockFill[1];
+    }
+
+    out.beginObject()
+        .field("path", toVirtualPath(dir))
+        .field("firstSegment", first)
+        .field("currentSegment", current)
+        .field("currentBytes", size)
+        .field("segmentBytes", segmentBytes)
+        .field("segments", LOG_STORE_SEGMENTS)
+        .field("records", stored)
+        .field("dropped", dropped)
+        .field("buffered", buffered)
+        .field("bytesWritten", written)
+        .field("writeErrors", errors)
+        .endObject();
+}
+
+static void streamLogStore(const CommandArgs &args, JsonWriter &out)
+{
+    // logstore [read [from=<epoch>] [to=<epoch>] [format=json|text]]
+    if (args.str(1) != "read")
+    {
+        writeLogStoreInfo(out);
+        return;
+    }
+
+    LogStoreQuery query;
+    for (size_t i = 2; i < args.size(); i++)
+    {
+        std::string option = args.str(i);
+        size_t eq = option.find('=');
+        if (eq == std::string::npos || !query.set(option.substr(0, eq), option.substr(eq + 1)))
+        {
+            out.beginObject().field("error", "Invalid logstore option: " + option).endObject();
+            return;
+        }
+    }
+    writeStoredRecords(out, query);
+}
+
+static FeatureAction logStoreAction = {.name = "logstore",
+                                       .handler =
+                                           [](const CommandArgs &args)
+                                       {
+                                           return JsonWriter::toString([&args](JsonWriter &out)
+                                                                       { streamLogStore(args, out); });
+                                       },
+                                       .streamHandler = streamLogStore,
+                                       .transports = {.cli = true, .rest = true, .ws = true, .scripting = true},
+                                       .async = true};
+
+Feature *logStoreFeature = new Feature(
+    "LogStore",
+    []()
+    {
+        std::string root;
+#if ENABLE_SD_CARD
+        if (isSdCardMounted())
+        {
+            root = SD_MOUNT_POINT;
+            segmentBytes = LOG_STORE_SD_SEGMENT_BYTES;
+        }
+#endif
+#if ENABLE_LITTLEFS
+        if (root.empty())
+        {
+            root = LITTLEFS_MOUNT_POINT;
+            segmentBytes = LOG_STORE_FLASH_SEGMENT_BYTES;
+        }
+#endif
+        if (root.empty())
+        {
+            loggerInstance->Error("LogStore: no storage mounted");
+            return FeatureState::ERROR;
+        }
+
+        std::string dir = root + LOG_STORE_DIR;
+        mkdir(dir.c_str(), 0775);
+        if (!vfsIsDirectory(dir))
+        {
+            loggerInstance->Error("LogStore: cannot create " + toVirtualPath(dir));
+            return FeatureState::ERROR;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(fileMutex);
+            storeDir = dir;
+            scanSegments();
+        }
+
+        xTaskCreate(logStoreWriterLoop, "log_store", 3072, nullptr, 1, &writerTask);
+        watchTaskStack(writerTask);
+        loggerInstance->AddListener(storeLogRecords);
+        // write the buffered tail before a restart
+        esp_register_shutdown_handler(
+            []()
+            {
+                loggerInstance->flush();
+                writePendingBlocks(true);
+            });
+        actionRegistryInstance->registerAction(&logStoreAction);
+
+        loggerInstance->Info("LogStore: writing to " + toVirtualPath(dir));
+        return FeatureState::RUNNING;
+    },
+    []() {});
+
+#endif // ENABLE_LOG_STORE
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "../../config.h"
+
+#if ENABLE_LOG_STORE
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include "../Feature.h"
+
+/**
+ * Persistent log: every record the logger dispatches is appended to segment
+ * files under LOG_STORE_DIR, on the SD card when it is mounted at startup,
+ * otherwise on flash with the smaller LOG_STORE_FLASH_SEGMENT_BYTES cap.
+ *
+ * Segments are numbered files (00000012.bin); when the current one is full the
+ * next number is started and the oldest beyond LOG_STORE_SEGMENTS is deleted.
+ *
+ * Record layout, integers little-endian:
+ *
+ *   u8 0xA5, u8 severity ('I', 'E', 'D'), u8 length, u32 epochTime, u8 check,
+ *   length bytes of message
+ *
+ * check is the XOR of the epoch and message bytes. Together with the marker
+ * it lets the reader skip a record torn by a power loss and pick up at the
+ * next one.
+ */
+
+#define LOG_STORE_MARKER 0xA5
+#define LOG_STORE_HEADER_SIZE 8
+
+struct LogStoreRecord
+{
+    time_t epochTime;
+    char severity;
+    uint8_t length;
+    const char *message; // points into the decode buffer, not terminated
+};
+
+inline uint8_t logStoreCheck(const uint8_t *epoch, const uint8_t *message, size_t length)
+{
+    uint8_t check = epoch[0] ^ epoch[1] ^ epoch[2] ^ epoch[3];
+    for (size_t i = 0; i < length; i++)
+        check ^= message[i];
+    return check;
+}
+
+// Encodes one record into dst (at least LOG_STORE_HEADER_SIZE + 255 bytes).
+// Returns the encoded size.
+inline size_t encodeLogStoreRecord(uint8_t *dst, char severity, time_t epochTime, const char *message, size_t length)
+{
+    if (length > 255)
+        length = 255;
+    uint32_t epoch = (uint32_t)epochTime;
+    dst[0] = LOG_STORE_MARKER;
+    dst[1] = (uint8_t)severity;
+    dst[2] = (uint8_t)length;
+    dst[3] = (uint8_t)epoch;
+    dst[4] = (uint8_t)(epoch >> 8);
+    dst[5] = (uint8_t)(epoch >> 16);
+    dst[6] = (uint8_t)(epoch >> 24);
+    memcpy(dst + LOG_STORE_HEADER_SIZE, message, length);
+    dst[7] = logStoreCheck(dst + 3, dst + LOG_STORE_HEADER_SIZE, length);
+    return LOG_STORE_HEADER_SIZE + length;
+}
+
+inline bool isLogStoreSeverity(uint8_t c)
+{
+    return c == 'I' || c == 'E' || c == 'D';
+}
+
+// Decodes the record at data[0..len). Returns the bytes consumed, 0 when the
+// record is incomplete (read more), or -1 when data does not start with a
+// valid record (skip a byte and retry).
+inline int decodeLogStoreRecord(const uint8_t *data, size_t len, LogStoreRecord &record)
+{
+    if (len < LOG_STORE_HEADER_SIZE)
+        return len > 0 && data[0] != LOG_STORE_MARKER ? -1 : 0;
+    if (data[0] != LOG_STORE_MARKER || !isLogStoreSeverity(data[1]))
+        return -1;
+    size_t total = LOG_STORE_HEADER_SIZE + data[2];
+    if (len < total)
+        return 0;
+    if (logStoreCheck(data + 3, data + LOG_STORE_HEADER_SIZE, data[2]) != data[7])
+        return -1;
+    record.severity = (char)data[1];
+    record.length = data[2];
+    record.epochTime = (time_t)((uint32_t)data[3] | ((uint32_t)data[4] << 8) | ((uint32_t)data[5] << 16) |
+                                ((uint32_t)data[6] << 24));
+    record.message = (const char *)data + LOG_STORE_HEADER_SIZE;
+    return (int)total;
+}
+
+extern Feature *logStoreFeature;
+
+#endif // ENABLE_LOG_STORE
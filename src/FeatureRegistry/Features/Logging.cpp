@@ -1,19 +1,224 @@
 #include "Logging.h"
 #include "../../ActionRegistry/ActionRegistry.h"
 #include "../../utils/CJsonHelper.h"
+#include "../../utils/System.h"
+#include "../../CommandInterpreter/CommandArgs.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 // instantiate globals
 Logger *loggerInstance = new Logger();
 
+static TaskHandle_t logDispatchTask = nullptr;
+
+bool Logger::readRecord(uint32_t seq, LogRecord &record) const
+{
+    std::lock_guard<std::mutex> lock(_entriesMutex);
+    uint32_t oldest = _written > LOG_RING_CAPACITY ? _written - LOG_RING_CAPACITY : 0;
+    if (seq < oldest || seq >= _written)
+        return false;
+    record = _ring[seq % LOG_RING_CAPACITY];
+    return true;
+}
+
+void Logger::writeEntries(JsonWriter &out) const
+{
+    uint32_t end;
+    {
+        std::lock_guard<std::mutex> lock(_entriesMutex);
+        end = _written;
+    }
+    uint32_t seq = end > LOG_RING_CAPACITY ? end - LOG_RING_CAPACITY : 0;
+
+    LogRecord record;
+    char severity[2] = {0, 0};
+    UtcTimeCache utcTime;
+    out.beginArray();
+    for (; seq < end; seq++)
+    {
+        // records overwritten while we were writing are skipped
+        if (!readRecord(seq, record))
+            continue;
+        severity[0] = record.severity;
+        out.beginObject()
+            .field("severity", (const char *)severity)
+            .field("message", (const char *)record.message)
+            .field("epochTime", (long long)record.epochTime)
+            .field("isoDateTime", utcTime.format(record.epochTime));
+        if (record.scope != 0)
+            out.field("scope", scopeName(record.scope));
+        out.endObject();
+    }
+    out.endArray();
+}
+
+cJSON *Logger::createEntries() const
+{
+    uint32_t end;
+    {
+        std::lock_guard<std::mutex> lock(_entriesMutex);
+        end = _written;
+    }
+    uint32_t seq = end > LOG_RING_CAPACITY ? end - LOG_RING_CAPACITY : 0;
+
+    cJSON *entries = cJSON_CreateArray();
+    LogRecord record;
+    char severity[2] = {0, 0};
+    UtcTimeCache utcTime;
+    for (; seq < end; seq++)
+    {
+        if (!readRecord(seq, record))
+            continue;
+        severity[0] = record.severity;
+        cJSON *entry = cJSON_CreateObject();
+        cJSON_AddStringToObject(entry, "severity", severity);
+        cJSON_AddStringToObject(entry, "message", record.message);
+        cJSON_AddNumberToObject(entry, "epochTime", (double)record.epochTime);
+        cJSON_AddStringToObject(entry, "isoDateTime", utcTime.format(record.epochTime));
+        if (record.scope != 0)
+            cJSON_AddStringToObject(entry, "scope", scopeName(record.scope));
+        cJSON_AddItemToArray(entries, entry);
+    }
+    return entries;
+}
+
+void Logger::notifyDispatcher()
+{
+    if (logDispatchTask)
+        xTaskNotifyGive(logDispatchTask);
+    else
+        dispatchPending(false);
+}
+
+void Logger::dispatchPending(bool wait)
+{
+    std::unique_lock<std::mutex> dispatchLock(_dispatchMutex, std::defer_lock);
+    if (wait)
+        dispatchLock.lock();
+    else if (!dispatchLock.try_lock())
+        return;
+
+    while (true)
+    {
+        size_t count = 0;
+        {
+            std::lock_guard<std::mutex> lock(_entriesMutex);
+            uint32_t oldest = _written > LOG_RING_CAPACITY ? _written - LOG_RING_CAPACITY : 0;
+            if (_dispatched < oldest)
+            {
+                _dropped += oldest - _dispatched;
+                _dispatched = oldest;
+            }
+            while (_dispatched < _written && count < LOG_DISPATCH_BATCH)
+                _batch[count++] = _ring[_dispatched++ % LOG_RING_CAPACITY];
+        }
+        if (count == 0)
+            return;
+
+        LogListener listenersCopy[LOG_LISTENERS_COUNT];
+        uint8_t listenersCount;
+        {
+            std::lock_guard<std::mutex> lock(_listenersMutex);
+            listenersCount = this->_listenersCount;
+            memcpy(listenersCopy, this->_listeners, sizeof(LogListener) * listenersCount);
+        }
+        for (uint8_t i = 0; i < listenersCount; i++)
+            listenersCopy[i](_batch, count);
+
+        std::lock_guard<std::mutex> lock(_entriesMutex);
+        _delivered += count;
+        _batches++;
+    }
+}
+
+static void logDispatchLoop(void *)
+{
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // let a burst of log lines collect into one batch
+        vTaskDelay(pdMS_TO_TICKS(LOG_DISPATCH_DELAY_MS));
+        loggerInstance->flush();
+    }
+}
+
+void Logger::startDispatcher()
+{
+    if (logDispatchTask)
+        return;
+    xTaskCreate(logDispatchLoop, "log_dispatch", LOG_DISPATCH_STACK, nullptr, 1, &logDispatchTask);
+    watchTaskStack(logDispatchTask);
+    // records logged before the task existed may still be waiting
+    xTaskNotifyGive(logDispatchTask);
+}
+
+void Logger::writeStats(JsonWriter &out) const
+{
+    uint32_t written, dispatched, delivered, batches, dropped;
+    {
+        std::lock_guard<std::mutex> lock(_entriesMutex);
+        written = _written;
+        dispatched = _dispatched;
+        delivered = _delivered;
+        batches = _batches;
+        dropped = _dropped;
+    }
+    out.beginObject()
+        .field("written", written)
+        .field("pending", written - dispatched)
+        .field("delivered", delivered)
+        .field("batches", batches)
+        .field("dropped", dropped)
+        .field("capacity", LOG_RING_CAPACITY)
+        .endObject();
+}
+
+static void writeLogLevel(const CommandArgs &args, JsonWriter &out)
+{
+    std::string name = args.str(2);
+    uint8_t level;
+    if (!name.empty())
+    {
+        if (!parseLogLevel(name, level))
+        {
+            out.beginObject().field("error", "Unknown log level: " + name + " (debug, info, error)").endObject();
+            return;
+        }
+        loggerInstance->setLevel(level);
+    }
+    out.beginObject().field("level", logLevelName(loggerInstance->getLevel())).endObject();
+}
+
+// log | log stats | log level [debug|info|error]
+static void streamLogEntries(const CommandArgs &args, JsonWriter &out)
+{
+    std::string sub = args.str(1);
+    if (sub == "stats")
+        loggerInstance->writeStats(out);
+    else if (sub == "level")
+        writeLogLevel(args, out);
+    else
+        loggerInstance->writeEntries(out);
+}
+
 static FeatureAction logAction = {.name = "log",
                                   .handler =
-                                      [](const std::string & /*command*/)
+                                      [](const CommandArgs &args)
+                                  {
+                                      return JsonWriter::toString([&args](JsonWriter &out)
+                                                                  { streamLogEntries(args, out); });
+                                  },
+                                  .objectHandler =
+                                      [](const CommandArgs &args)
                                   {
-                                      std::string output;
-                                      loggerInstance->withEntries([&output](cJSON *entries)
-                                                                  { output = cJsonToString(entries); });
-                                      return output;
+                                      if (!args.has(1))
+                                          return loggerInstance->createEntries();
+                                      return cJSON_Parse(JsonWriter::toString([&args](JsonWriter &out)
+                                                                              { streamLogEntries(args, out); })
+                                                             .c_str());
                                   },
+                                  .streamHandler = streamLogEntries,
                                   .transports = {.cli = true, .rest = true, .ws = true, .scripting = true}};
 
 Feature *loggingFeature = new Feature(
@@ -21,6 +226,9 @@ Feature *loggingFeature = new Feature(
     []()
     {
         actionRegistryInstance->registerAction(&logAction);
+        loggerInstance->startDispatcher();
+        // deliver what is still queued when the system restarts
+        esp_register_shutdown_handler([]() { loggerInstance->flush(); });
         return FeatureState::RUNNING;
     },
     []() {});
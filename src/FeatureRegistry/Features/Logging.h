@@ -1,50 +1,145 @@
 #pragma once
 #include "cJSON.h"
+#include <atomic>
 #include <cstdint>
+#include <cstring>
+#include <ctime>
 #include <functional>
 #include <mutex>
 #include <string>
 #include "esp_log.h"
 #include "../../config.h"
+#include "../../utils/LogLevel.h"
 #include "../Feature.h"
 #include "./Time.h"
 
 // forward declaration of global logger so circular includes don't break
 class Logger;
 extern Logger *loggerInstance;
-
-using LogListener = void (*)(const std::string &, const std::string &);
+class JsonWriter;
 
 #define LOG_LISTENERS_COUNT 10
-#define MAX_LOG_ENTRIES 100
+#define LOG_MAX_SCOPES 16
+#define LOG_DEFAULT_SCOPE "Logger"
+
+// Level-checked logging on the global logger; see utils/LogLevel.h
+#define LOG_DEBUG(...) LOG_AT_WITH(loggerInstance, LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT_WITH(loggerInstance, LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT_WITH(loggerInstance, LOG_LEVEL_ERROR, __VA_ARGS__)
+
+/**
+ * One entry of the log history. Records live in a ring allocated with the
+ * logger, so logging never touches the heap; JSON is only built when the
+ * history is read.
+ */
+struct LogRecord
+{
+    time_t epochTime;
+    char severity;
+    uint8_t scope;   // index into the interned scope table
+    uint16_t length; // bytes used in message, excluding the terminator
+    char message[LOG_MESSAGE_MAX];
+};
+
+// Receives a batch of records, oldest first, on the log dispatch task
+using LogListener = void (*)(const LogRecord *records, size_t count);
 
 class Logger
 {
 public:
-    cJSON *getEntries() const
+    // Render the history as a JSON array, oldest first. The ring lock is only
+    // held while copying each record, never while writing to the sink.
+    void writeEntries(JsonWriter &out) const;
+
+    // Build the history as a cJSON array the caller owns
+    cJSON *createEntries() const;
+
+    void withEntries(std::function<void(cJSON *)> fn) const
     {
-        return _entries;
+        cJSON *entries = createEntries();
+        fn(entries);
+        cJSON_Delete(entries);
     }
 
-    void withEntries(std::function<void(cJSON *)> fn) const
+    bool isEnabled(uint8_t level) const
     {
-        std::lock_guard<std::mutex> lock(_entriesMutex);
-        fn(_entries);
+        return level >= LOG_COMPILE_LEVEL && level >= _level.load(std::memory_order_relaxed);
+    }
+
+    uint8_t getLevel() const
+    {
+        return _level.load(std::memory_order_relaxed);
+    }
+
+    void setLevel(uint8_t level)
+    {
+        _level.store(level, std::memory_order_relaxed);
+    }
+
+    void log(uint8_t level, const std::string &message)
+    {
+        if (isEnabled(level))
+            this->handle(level, 0, message);
+    }
+
+    // scope should be a string literal: it is interned by pointer and used as
+    // the ESP log tag.
+    void log(uint8_t level, const char *scope, const std::string &message)
+    {
+        if (isEnabled(level))
+            this->handle(level, internScope(scope), message);
     }
 
+    // The message is built by the caller even when the level is filtered out;
+    // prefer the LOG_* macros where that matters.
     void Info(const std::string &message)
     {
-        this->handle("I", message);
+        log(LOG_LEVEL_INFO, message);
     }
 
     void Error(const std::string &message)
     {
-        this->handle("E", message);
+        log(LOG_LEVEL_ERROR, message);
     }
 
     void Debug(const std::string &message)
     {
-        this->handle("D", message);
+        log(LOG_LEVEL_DEBUG, message);
+    }
+
+    void Info(const char *scope, const std::string &message)
+    {
+        log(LOG_LEVEL_INFO, scope, message);
+    }
+
+    void Error(const char *scope, const std::string &message)
+    {
+        log(LOG_LEVEL_ERROR, scope, message);
+    }
+
+    void Debug(const char *scope, const std::string &message)
+    {
+        log(LOG_LEVEL_DEBUG, scope, message);
+    }
+
+    // Starts the dispatch task. Until then listeners run on the logging task.
+    void startDispatcher();
+
+    // Delivers everything still pending to the listeners on the calling task.
+    // Meant for restart and crash paths; must not be called from a listener.
+    // Listeners that pass records on to a task of their own (WebSocket
+    // broadcast, log store) drain that in their own shutdown handler.
+    void flush()
+    {
+        dispatchPending(true);
+    }
+
+    // Dispatch counters as a JSON object
+    void writeStats(JsonWriter &out) const;
+
+    const char *scopeName(uint8_t scope) const
+    {
+        return scope < _scopeCount ? _scopes[scope] : LOG_DEFAULT_SCOPE;
     }
 
     void AddListener(LogListener listener)
@@ -57,75 +152,113 @@ public:
         }
     }
 
-    Logger()
+    Logger() : _level(LOG_DEFAULT_LEVEL)
     {
-        _entries = cJSON_CreateArray();
+        this->_scopes[0] = LOG_DEFAULT_SCOPE;
+        this->_scopeCount = 1;
         this->_listenersCount = 0;
-        this->_entryCount = 0;
-    }
-
-    ~Logger()
-    {
-        if (_entries)
-            cJSON_Delete(_entries);
+        this->_written = 0;
+        this->_dispatched = 0;
+        this->_delivered = 0;
+        this->_batches = 0;
+        this->_dropped = 0;
     }
 
 private:
+    std::atomic<uint8_t> _level;
     mutable std::mutex _entriesMutex;
     std::mutex _listenersMutex;
-    cJSON *_entries;
-    uint16_t _entryCount;
+    std::mutex _dispatchMutex;
+
+    LogRecord _ring[LOG_RING_CAPACITY];
+    uint32_t _written; // records ever written; the newest is at (_written - 1) % capacity
+    UtcTimeCache _utcTime; // console timestamp, guarded by _entriesMutex
+
+    // Listener delivery reads the ring too: _dispatched is the next record to
+    // hand out. Records overwritten before that happens count as dropped.
+    uint32_t _dispatched;
+    uint32_t _delivered;
+    uint32_t _batches;
+    uint32_t _dropped;
+    LogRecord _batch[LOG_DISPATCH_BATCH]; // guarded by _dispatchMutex
+
+    const char *_scopes[LOG_MAX_SCOPES];
+    uint8_t _scopeCount;
 
     uint8_t _listenersCount;
     LogListener _listeners[LOG_LISTENERS_COUNT];
 
-    void handle(const std::string &severity, const std::string &message)
-    {
-        unsigned long epochTime = getEpochTime();
-        std::string utcTime(getUtcTime().c_str());
+    // Copies the record with sequence number seq, unless it was overwritten
+    bool readRecord(uint32_t seq, LogRecord &record) const;
 
-        this->addEntry(severity, message, epochTime, utcTime);
-        if (severity == "E")
-            ESP_LOGE("Logger", "[%s] %s - %s", severity.c_str(), utcTime.c_str(), message.c_str());
-        else if (severity == "D")
-            ESP_LOGD("Logger", "[%s] %s - %s", severity.c_str(), utcTime.c_str(), message.c_str());
-        else
-            ESP_LOGI("Logger", "[%s] %s - %s", severity.c_str(), utcTime.c_str(), message.c_str());
+    // Wakes the dispatch task, or delivers inline before it is running
+    void notifyDispatcher();
 
-        LogListener listenersCopy[LOG_LISTENERS_COUNT];
-        uint8_t count;
-        {
-            std::lock_guard<std::mutex> lock(_listenersMutex);
-            count = this->_listenersCount;
-            memcpy(listenersCopy, this->_listeners, sizeof(LogListener) * count);
-        }
-        for (uint8_t i = 0; i < count; i++)
+    // Hands pending records to the listeners in batches. With wait unset it
+    // gives up when another task is already dispatching; that task picks up
+    // the new records before it stops.
+    void dispatchPending(bool wait);
+
+    uint8_t internScope(const char *scope)
+    {
+        if (!scope)
+            return 0;
+        std::lock_guard<std::mutex> lock(_entriesMutex);
+        for (uint8_t i = 0; i < _scopeCount; i++)
         {
-            listenersCopy[i](severity, message);
+            if (_scopes[i] == scope || strcmp(_scopes[i], scope) == 0)
+                return i;
         }
+        if (_scopeCount >= LOG_MAX_SCOPES)
+            return 0;
+        _scopes[_scopeCount] = scope;
+        return _scopeCount++;
     }
 
-    void addEntry(const std::string &severity, const std::string &message, unsigned long epochTime,
-                  const std::string &utcTime)
+    void handle(uint8_t level, uint8_t scope, const std::string &message)
     {
-        std::lock_guard<std::mutex> lock(_entriesMutex);
-        if (this->_entryCount >= MAX_LOG_ENTRIES)
+        char utcTime[UtcTimeCache::SIZE];
+        this->addEntry(logLevelSeverity(level), scope, message, getEpochTime(), utcTime);
+
+        const char *tag = scopeName(scope);
+        switch (level)
         {
-            cJSON *first = cJSON_DetachItemFromArray(_entries, 0);
-            if (first)
-                cJSON_Delete(first);
+        case LOG_LEVEL_DEBUG:
+            ESP_LOGD(tag, "[D] %s - %s", utcTime, message.c_str());
+            break;
+        case LOG_LEVEL_INFO:
+            ESP_LOGI(tag, "[I] %s - %s", utcTime, message.c_str());
+            break;
+        default:
+            ESP_LOGE(tag, "[E] %s - %s", utcTime, message.c_str());
+            break;
         }
-        else
+
+        this->notifyDispatcher();
+    }
+
+    // Stores the record and copies the cached timestamp text into utcTime
+    void addEntry(char severity, uint8_t scope, const std::string &message, time_t epochTime, char *utcTime)
+    {
+        size_t length = message.size();
+        if (length > LOG_MESSAGE_MAX - 1)
         {
-            this->_entryCount++;
+            length = LOG_MESSAGE_MAX - 1;
+            // do not cut a UTF-8 sequence in half
+            while (length > 0 && ((unsigned char)message[length] & 0xC0) == 0x80)
+                length--;
         }
 
-        cJSON *entry = cJSON_CreateObject();
-        cJSON_AddStringToObject(entry, "severity", severity.c_str());
-        cJSON_AddStringToObject(entry, "message", message.c_str());
-        cJSON_AddNumberToObject(entry, "epochTime", epochTime);
-        cJSON_AddStringToObject(entry, "isoDateTime", utcTime.c_str());
-        cJSON_AddItemToArray(_entries, entry);
+        std::lock_guard<std::mutex> lock(_entriesMutex);
+        LogRecord &record = _ring[_written % LOG_RING_CAPACITY];
+        record.epochTime = epochTime;
+        record.severity = severity;
+        record.scope = scope;
+        record.length = (uint16_t)length;
+        memcpy(record.message, message.data(), length);
+        record.message[length] = '\0';
+        _written++;
+        memcpy(utcTime, _utcTime.format(epochTime), UtcTimeCache::SIZE);
     }
 };
 
@@ -3,7 +3,7 @@
 #if ENABLE_SD_CARD
 
 #include "../../../ActionRegistry/ActionRegistry.h"
-#include "../../../CommandInterpreter/CommandParser.h"
+#include "../../../CommandInterpreter/CommandArgs.h"
 #include "../Logging.h"
 #include "cJSON.h"
 #include "../../../utils/CJsonHelper.h"
@@ -183,9 +183,9 @@ static std::string doInfo()
     return output;
 }
 
-static std::string sdHandler(const std::string &command)
+static std::string sdHandler(const CommandArgs &args)
 {
-    std::string operation = CommandParser::getCommandParameter(command, 1);
+    std::string operation = args.str(1);
 
     if (operation == "mount")
     {
@@ -210,8 +210,10 @@ static std::string sdHandler(const std::string &command)
     return {"{\"error\": \"Usage: sd mount | sd unmount | sd info\"}"};
 }
 
-static FeatureAction sdAction = {
-    .name = "sd", .handler = sdHandler, .transports = {.cli = true, .rest = false, .ws = true, .scripting = true}};
+static FeatureAction sdAction = {.name = "sd",
+                                 .handler = sdHandler,
+                                 .transports = {.cli = true, .rest = false, .ws = true, .scripting = true},
+                                 .async = true};
 
 Feature *SdCardFeature = new Feature(
     "SdCard",
@@ -33,6 +33,22 @@ Feature *serialReadFeature = new Feature(
         {
             buf[len] = '\0';
             std::string command(buf);
+            if (isCommandBatch(command))
+            {
+                // a JSON array or batch-headed lines: run together, answer once
+                CommandBatch batch;
+                std::string error;
+                std::string response = JsonWriter::toString(
+                    [&](JsonWriter &out)
+                    {
+                        if (parseCommandBatch(command, batch, error))
+                            actionRegistryInstance->executeBatch(batch, Transport::CLI, out);
+                        else
+                            out.beginObject().field("error", error).endObject();
+                    });
+                ESP_LOGI("SerialRead", "%s", response.c_str());
+                return;
+            }
             StringUtil::replaceAll(command, "\r", "");
             StringUtil::replaceAll(command, "\n", "");
             if (!command.empty())
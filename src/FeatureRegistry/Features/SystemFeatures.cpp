@@ -1,13 +1,14 @@
 #include "SystemFeatures.h"
 #include "Logging.h"
 #include "../../ActionRegistry/ActionRegistry.h"
-#include "../../CommandInterpreter/CommandParser.h"
+#include "../../CommandInterpreter/CommandArgs.h"
 #include "../../hw/RgbLed.h"
 #include "../../hw/lightSensor.h"
 #include "../registeredFeatures.h"
 #include "../../utils/System.h"
 #include "../../fs/LittleFsInit.h"
 #include "../../utils/CJsonHelper.h"
+#include "../../utils/Metrics.h"
 #include "esp_system.h"
 #include "esp_chip_info.h"
 #include "esp_flash.h"
@@ -69,14 +70,14 @@ cJSON *getInfo()
 
 #if ENABLE_WIFI
 
-static std::string wifiHandler(const std::string &command)
+static std::string wifiHandler(const CommandArgs &args)
 {
-    std::string operation = CommandParser::getCommandParameter(command, 1);
+    std::string operation = args.str(1);
 
     if (operation == "connect")
     {
-        std::string ssid = CommandParser::getCommandParameter(command, 2);
-        std::string password = CommandParser::getCommandParameter(command, 3);
+        std::string ssid = args.str(2);
+        std::string password = args.str(3);
         if (ssid.length() < 3 || password.length() < 5)
         {
             return "{\"error\": \"ssid or password too short\"}";
@@ -134,8 +135,8 @@ static std::string wifiHandler(const std::string &command)
 
     if (operation == "startSTA")
     {
-        std::string ssid = CommandParser::getCommandParameter(command, 2);
-        std::string passphrase = CommandParser::getCommandParameter(command, 3);
+        std::string ssid = args.str(2);
+        std::string passphrase = args.str(3);
         if (ssid.length() < 3 || passphrase.length() < 5)
         {
             return "{\"error\": \"ssid or passphrase too short\"}";
@@ -219,7 +220,7 @@ static std::string wifiHandler(const std::string &command)
 static FeatureAction restartAction = {.name = "restart",
                                       .type = "POST",
                                       .handler =
-                                          [](const std::string & /*command*/)
+                                          [](const CommandArgs & /*args*/)
                                       {
                                           vTaskDelay(pdMS_TO_TICKS(100));
                                           systemRestart();
@@ -227,38 +228,55 @@ static FeatureAction restartAction = {.name = "restart",
                                       },
                                       .transports = {.cli = true, .rest = true, .ws = false, .scripting = true}};
 
+// A copy taken under the lock: writing may wait on a slow client, which must
+// not hold up feature state updates
+static cJSON *copyRegisteredFeatures()
+{
+    cJSON *copy = nullptr;
+    withRegisteredFeatures([&copy](cJSON *doc) { copy = cJSON_Duplicate(doc, true); });
+    return copy;
+}
+
+static void streamFeatures(const CommandArgs & /*args*/, JsonWriter &out)
+{
+    CJsonPtr features(copyRegisteredFeatures());
+    out.value((const cJSON *)features.get());
+}
+
 static FeatureAction featuresAction = {.name = "features",
                                        .handler =
-                                           [](const std::string & /*command*/)
+                                           [](const CommandArgs &args)
                                        {
-                                           std::string output;
-                                           withRegisteredFeatures([&output](cJSON *doc)
-                                                                  { output = cJsonToString(doc); });
-                                           return output;
+                                           return JsonWriter::toString([&args](JsonWriter &out)
+                                                                       { streamFeatures(args, out); });
                                        },
+                                       .objectHandler = [](const CommandArgs & /*args*/)
+                                       { return copyRegisteredFeatures(); },
+                                       .streamHandler = streamFeatures,
                                        .transports = {.cli = true, .rest = true, .ws = true, .scripting = true}};
 
 static FeatureAction infoAction = {.name = "info",
                                    .handler =
-                                       [](const std::string & /*command*/)
+                                       [](const CommandArgs & /*args*/)
                                    {
                                        cJSON *response = getInfo();
                                        std::string output = cJsonToString(response);
                                        cJSON_Delete(response);
                                        return output;
                                    },
+                                   .objectHandler = [](const CommandArgs & /*args*/) { return getInfo(); },
                                    .transports = {.cli = true, .rest = true, .ws = true, .scripting = true}};
 
 static FeatureAction rgbLedAction = {.name = "rgbLed",
                                      .handler =
-                                         [](const std::string &command)
+                                         [](const CommandArgs &args)
                                      {
-                                         const std::string SUB = CommandParser::getCommandParameter(command, 1);
+                                         const std::string SUB = args.str(1);
                                          if (SUB == "setColor")
                                          {
-                                             int r = atoi(CommandParser::getCommandParameter(command, 2).c_str());
-                                             int g = atoi(CommandParser::getCommandParameter(command, 3).c_str());
-                                             int b = atoi(CommandParser::getCommandParameter(command, 4).c_str());
+                                             int r = args.toInt(2);
+                                             int g = args.toInt(3);
+                                             int b = args.toInt(4);
                                              setRgbLedColor(r, g, b);
                                              char logBuf[48];
                                              snprintf(logBuf, sizeof(logBuf), "Set RGB LED color to %d,%d,%d", r, g, b);
@@ -279,7 +297,7 @@ static FeatureAction rgbLedAction = {.name = "rgbLed",
 
 static FeatureAction lightSensorAction = {.name = "getLightSensorValue",
                                           .handler =
-                                              [](const std::string & /*command*/)
+                                              [](const CommandArgs & /*args*/)
                                           {
                                               uint16_t value = readLightSensor();
                                               char buf[80];
@@ -292,18 +310,26 @@ static FeatureAction lightSensorAction = {.name = "getLightSensorValue",
                                           .transports = {.cli = true, .rest = true, .ws = true, .scripting = true}};
 
 #if ENABLE_WIFI
-static FeatureAction wifiAction = {
-    .name = "wifi", .handler = wifiHandler, .transports = {.cli = true, .rest = false, .ws = true, .scripting = true}};
+static FeatureAction wifiAction = {.name = "wifi",
+                                   .handler = wifiHandler,
+                                   .transports = {.cli = true, .rest = false, .ws = true, .scripting = true},
+                                   .async = true};
 #endif
 
 // forward declaration to avoid circular include
 class FeatureRegistry;
 extern FeatureRegistry *featureRegistryInstance;
 
-static std::string memoryHandler(const std::string &command);
+static void streamMemory(const CommandArgs &args, JsonWriter &out);
 
 static FeatureAction memoryAction = {.name = "memory",
-                                     .handler = memoryHandler,
+                                     .handler =
+                                         [](const CommandArgs &args)
+                                     {
+                                         return JsonWriter::toString([&args](JsonWriter &out)
+                                                                     { streamMemory(args, out); });
+                                     },
+                                     .streamHandler = streamMemory,
                                      .transports = {.cli = true, .rest = true, .ws = true, .scripting = true}};
 
 // --- Feature ---
@@ -333,29 +359,63 @@ Feature *systemFeatures = new Feature(
 
 #include "../FeatureRegistry.h"
 
-static std::string memoryHandler(const std::string & /*command*/)
+static void streamMemory(const CommandArgs & /*args*/, JsonWriter &out)
 {
-    cJSON *doc = cJSON_CreateObject();
-    cJSON_AddNumberToObject(doc, "freeHeap", getFreeHeap());
-    cJSON_AddNumberToObject(doc, "minFreeHeap", esp_get_minimum_free_heap_size());
-    cJSON_AddNumberToObject(doc, "heapSize", heap_caps_get_total_size(MALLOC_CAP_DEFAULT));
-    cJSON_AddNumberToObject(doc, "maxAllocHeap", heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+    out.beginObject()
+        .field("freeHeap", getFreeHeap())
+        .field("minFreeHeap", esp_get_minimum_free_heap_size())
+        .field("heapSize", heap_caps_get_total_size(MALLOC_CAP_DEFAULT))
+        .field("maxAllocHeap", heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
 
-    cJSON *tasks = cJSON_AddArrayToObject(doc, "tasks");
+    out.key("tasks").beginArray();
     for (uint8_t i = 0; i < featureRegistryInstance->getFeatureCount(); i++)
     {
         Feature *f = featureRegistryInstance->RegisteredFeatures[i];
         if (f->isTaskBased())
         {
-            cJSON *t = cJSON_CreateObject();
-            cJSON_AddStringToObject(t, "name", f->GetFeatureName().c_str());
-            cJSON_AddBoolToObject(t, "running", f->isTaskRunning());
-            cJSON_AddNumberToObject(t, "stackHighWaterMark", f->getTaskStackHighWaterMark());
-            cJSON_AddItemToArray(tasks, t);
+            out.beginObject()
+                .field("name", f->GetFeatureName())
+                .field("running", f->isTaskRunning())
+                .field("stackHighWaterMark", f->getTaskStackHighWaterMark())
+                .endObject();
         }
     }
+    out.endArray().endObject();
+}
+
+// --- Metrics ---
 
-    std::string output = cJsonToString(doc);
-    cJSON_Delete(doc);
-    return output;
+static Gauge freeHeapGauge("heap_free_bytes", "Free heap", nullptr, []() { return (double)getFreeHeap(); });
+static Gauge minFreeHeapGauge("heap_min_free_bytes", "Lowest free heap since boot", nullptr,
+                              []() { return (double)esp_get_minimum_free_heap_size(); });
+static Gauge largestFreeBlockGauge("heap_largest_free_block_bytes", "Largest block that can be allocated", nullptr,
+                                   []() { return (double)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT); });
+
+static void writeTaskStack(MetricsWriter &out, const char *name, const char *task, UBaseType_t highWater)
+{
+    char label[64];
+    snprintf(label, sizeof(label), "task=\"%s\"", task);
+    out.sample(name, "", label, highWater);
 }
+
+// Feature tasks come and go with their feature, so only the mark they publish
+// themselves is read; service tasks stay once watched
+static MetricsCollector taskStackCollector("task_stack_high_water_bytes", "Least free stack a task has had", "gauge",
+                                           [](MetricsWriter &out, const char *name)
+                                           {
+                                               for (uint8_t i = 0; i < featureRegistryInstance->getFeatureCount(); i++)
+                                               {
+                                                   Feature *f = featureRegistryInstance->RegisteredFeatures[i];
+                                                   UBaseType_t highWater = f->getTaskStackHighWaterMark();
+                                                   if (f->isTaskRunning() && highWater > 0)
+                                                       writeTaskStack(out, name, f->GetFeatureName().c_str(),
+                                                                      highWater);
+                                               }
+                                               for (std::atomic<TaskHandle_t> &task : watchedTasks)
+                                               {
+                                                   TaskHandle_t handle = task.load();
+                                                   if (handle != nullptr)
+                                                       writeTaskStack(out, name, pcTaskGetName(handle),
+                                                                      uxTaskGetStackHighWaterMark(handle));
+                                               }
+                                           });
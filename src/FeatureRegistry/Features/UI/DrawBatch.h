@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+
+namespace UI
+{
+
+/**
+ * Packed draw commands, the binary counterpart of `screen pixel|rect|...`.
+ *
+ * A batch is a sequence of ops, each an opcode byte followed by its
+ * little-endian fields (coordinates int16, colors RGB565 uint16):
+ *
+ *   0x01 pixel       x, y, color
+ *   0x02 rect        x, y, w, h, color
+ *   0x03 fillrect    x, y, w, h, color
+ *   0x04 circle      x, y, r, color
+ *   0x05 fillcircle  x, y, r, color
+ *   0x06 line        x0, y0, x1, y1, color
+ *   0x07 text        x, y, fg, bg, u8 size, u8 len, len bytes of text
+ *   0x08 clear       color
+ *
+ * The whole batch is validated before anything is drawn, so a malformed batch
+ * leaves the screen untouched.
+ */
+enum DrawOpCode : uint8_t
+{
+    DRAW_PIXEL = 0x01,
+    DRAW_RECT = 0x02,
+    DRAW_FILL_RECT = 0x03,
+    DRAW_CIRCLE = 0x04,
+    DRAW_FILL_CIRCLE = 0x05,
+    DRAW_LINE = 0x06,
+    DRAW_TEXT = 0x07,
+    DRAW_CLEAR = 0x08
+};
+
+class DrawBatchReader
+{
+public:
+    DrawBatchReader(const uint8_t *data, size_t len) : _p(data), _end(data + len)
+    {
+    }
+
+    bool atEnd() const
+    {
+        return _p >= _end;
+    }
+
+    bool has(size_t n) const
+    {
+        return (size_t)(_end - _p) >= n;
+    }
+
+    uint8_t u8()
+    {
+        return *_p++;
+    }
+
+    int16_t i16()
+    {
+        int16_t v = (int16_t)(_p[0] | (_p[1] << 8));
+        _p += 2;
+        return v;
+    }
+
+    uint16_t u16()
+    {
+        return (uint16_t)i16();
+    }
+
+    const char *bytes(size_t n)
+    {
+        const char *s = (const char *)_p;
+        _p += n;
+        return s;
+    }
+
+private:
+    const uint8_t *_p;
+    const uint8_t *_end;
+};
+
+// Size of an op's fields after the opcode, or -1 for an unknown opcode.
+// For text this is the fixed part, up to and including the length byte.
+inline int drawOpFieldSize(uint8_t op)
+{
+    switch (op)
+    {
+    case DRAW_PIXEL:
+        return 6;
+    case DRAW_RECT:
+    case DRAW_FILL_RECT:
+    case DRAW_LINE:
+        return 10;
+    case DRAW_CIRCLE:
+    case DRAW_FILL_CIRCLE:
+        return 8;
+    case DRAW_TEXT:
+        return 10;
+    case DRAW_CLEAR:
+        return 2;
+    default:
+        return -1;
+    }
+}
+
+// Walks the batch without drawing. Returns the op count, or -1 and sets error.
+inline int validateDrawBatch(const uint8_t *data, size_t len, std::string &error)
+{
+    DrawBatchReader in(data, len);
+    int ops = 0;
+    while (!in.atEnd())
+    {
+        uint8_t op = in.u8();
+        int size = drawOpFieldSize(op);
+        if (size < 0)
+        {
+            error = "unknown opcode " + std::to_string(op) + " at op " + std::to_string(ops);
+            return -1;
+        }
+        if (!in.has(size))
+        {
+            error = "truncated op " + std::to_string(ops);
+            return -1;
+        }
+        if (op != DRAW_TEXT)
+        {
+            in.bytes(size);
+        }
+        else
+        {
+            in.bytes(size - 1);
+            uint8_t textLen = in.u8(); // last byte of the fixed part
+            if (!in.has(textLen))
+            {
+                error = "truncated text in op " + std::to_string(ops);
+                return -1;
+            }
+            in.bytes(textLen);
+        }
+        ops++;
+    }
+    return ops;
+}
+
+// Rows a batch may have touched, [y0, y1); empty when y0 >= y1. Text counts
+// down to the bottom of the screen, since it can wrap.
+struct DrawRows
+{
+    int y0 = INT_MAX;
+    int y1 = INT_MIN;
+
+    void add(int top, int bottom)
+    {
+        y0 = std::min(y0, top);
+        y1 = std::max(y1, bottom);
+    }
+
+    // LovyanGFX draws a negative height upwards from y
+    void addRect(int y, int h)
+    {
+        add(std::min(y, y + h), std::max(y, y + h));
+    }
+
+    void addCircle(int y, int r)
+    {
+        r = std::abs(r);
+        add(y - r, y + r + 1);
+    }
+};
+
+// Draws a validated batch and returns the rows it touched. Gfx is LGFX on the
+// device; any type with the same drawing methods works.
+template <typename Gfx> DrawRows runDrawBatch(Gfx &gfx, const uint8_t *data, size_t len)
+{
+    DrawBatchReader in(data, len);
+    DrawRows rows;
+    std::string text;
+    while (!in.atEnd())
+    {
+        uint8_t op = in.u8();
+        switch (op)
+        {
+        case DRAW_PIXEL:
+        {
+            int16_t x = in.i16(), y = in.i16();
+            gfx.drawPixel(x, y, in.u16());
+            rows.add(y, y + 1);
+            break;
+        }
+        case DRAW_RECT:
+        case DRAW_FILL_RECT:
+        {
+            int16_t x = in.i16(), y = in.i16(), w = in.i16(), h = in.i16();
+            uint16_t color = in.u16();
+            if (op == DRAW_RECT)
+                gfx.drawRect(x, y, w, h, color);
+            else
+                gfx.fillRect(x, y, w, h, color);
+            rows.addRect(y, h);
+            break;
+        }
+        case DRAW_CIRCLE:
+        case DRAW_FILL_CIRCLE:
+        {
+            int16_t x = in.i16(), y = in.i16(), r = in.i16();
+            uint16_t color = in.u16();
+            if (op == DRAW_CIRCLE)
+                gfx.drawCircle(x, y, r, color);
+            else
+                gfx.fillCircle(x, y, r, color);
+            rows.addCircle(y, r);
+            break;
+        }
+        case DRAW_LINE:
+        {
+            int16_t x0 = in.i16(), y0 = in.i16(), x1 = in.i16(), y1 = in.i16();
+            gfx.drawLine(x0, y0, x1, y1, in.u16());
+            rows.add(std::min(y0, y1), std::max(y0, y1) + 1);
+            break;
+        }
+        case DRAW_TEXT:
+        {
+            int16_t x = in.i16(), y = in.i16();
+            uint16_t fg = in.u16(), bg = in.u16();
+            uint8_t size = in.u8();
+            uint8_t textLen = in.u8();
+            text.assign(in.bytes(textLen), textLen);
+            gfx.setCursor(x, y);
+            gfx.setTextColor(fg, bg);
+            gfx.setTextSize(size);
+            gfx.print(text.c_str());
+            rows.add(y, INT_MAX);
+            break;
+        }
+        case DRAW_CLEAR:
+            gfx.fillScreen(in.u16());
+            rows.add(INT_MIN, INT_MAX);
+            break;
+        default:
+            return rows; // not reached for validated batches
+        }
+    }
+    return rows;
+}
+
+} // namespace UI
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace UI
+{
+
+// Row encoding and change hashes of the screen mirror stream (see
+// ScreenMirror.h for the message layout). Kept free of the display so the
+// encoder can be tested on the host.
+
+inline void putMirror16(std::vector<uint8_t> &out, uint16_t v)
+{
+    out.push_back(v & 0xFF);
+    out.push_back(v >> 8);
+}
+
+// Pixels keep their in-memory byte order, which is RGB565 high byte first
+inline void putMirrorPixel(std::vector<uint8_t> &out, const uint16_t &px)
+{
+    const uint8_t *b = (const uint8_t *)&px;
+    out.push_back(b[0]);
+    out.push_back(b[1]);
+}
+
+// One row as RLE runs: c < 128 is followed by c + 1 literal pixels, c >= 128
+// by one pixel repeated c - 125 times (3..130)
+inline void encodeMirrorRow(std::vector<uint8_t> &out, const uint16_t *px, int n)
+{
+    int i = 0;
+    while (i < n)
+    {
+        int run = 1;
+        while (i + run < n && run < 130 && px[i + run] == px[i])
+            run++;
+        if (run >= 3)
+        {
+            out.push_back((uint8_t)(125 + run));
+            putMirrorPixel(out, px[i]);
+            i += run;
+            continue;
+        }
+
+        // literals up to the next run of three
+        int start = i;
+        int count = 0;
+        while (i < n && count < 128 && !(i + 2 < n && px[i] == px[i + 1] && px[i] == px[i + 2]))
+        {
+            i++;
+            count++;
+        }
+        out.push_back((uint8_t)(count - 1));
+        for (int k = start; k < start + count; k++)
+            putMirrorPixel(out, px[k]);
+    }
+}
+
+inline uint32_t hashMirrorSegment(const uint16_t *px, int n)
+{
+    uint32_t h = 2166136261u; // FNV-1a over pixels
+    for (int i = 0; i < n; i++)
+        h = (h ^ px[i]) * 16777619u;
+    return h;
+}
+
+} // namespace UI
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace UI
+{
+namespace Raster
+{
+
+// Raw view over a sprite buffer. Pixels are stored in the sprite's native
+// encoding (palette index for 1/2/4/8-bit palette sprites, byte-swapped RGB565
+// for 16-bit), sub-byte depths packed MSB first like LovyanGFX does.
+struct Surface
+{
+    uint8_t *buf = nullptr;
+    int width = 0;
+    int height = 0;
+    int bpp = 16;
+    int stride = 0; // bytes per row
+
+    bool valid() const
+    {
+        return buf != nullptr && width > 0 && height > 0 && stride > 0;
+    }
+
+    bool contains(int x, int y) const
+    {
+        return x >= 0 && y >= 0 && x < width && y < height;
+    }
+
+    uint8_t *row(int y) const
+    {
+        return buf + (size_t)y * stride;
+    }
+
+    uint32_t get(int x, int y) const
+    {
+        const uint8_t *r = row(y);
+        switch (bpp)
+        {
+        case 16:
+            return ((const uint16_t *)r)[x];
+        case 8:
+            return r[x];
+        case 24:
+            return r[x * 3] | (r[x * 3 + 1] << 8) | (r[x * 3 + 2] << 16);
+        default:
+        {
+            int bit = x * bpp;
+            int shift = 8 - bpp - (bit & 7);
+            return (r[bit >> 3] >> shift) & ((1 << bpp) - 1);
+        }
+        }
+    }
+
+    void set(int x, int y, uint32_t raw) const
+    {
+        uint8_t *r = row(y);
+        switch (bpp)
+        {
+        case 16:
+            ((uint16_t *)r)[x] = (uint16_t)raw;
+            break;
+        case 8:
+            r[x] = (uint8_t)raw;
+            break;
+        case 24:
+            r[x * 3] = raw & 0xFF;
+            r[x * 3 + 1] = (raw >> 8) & 0xFF;
+            r[x * 3 + 2] = (raw >> 16) & 0xFF;
+            break;
+        default:
+        {
+            int bit = x * bpp;
+            int shift = 8 - bpp - (bit & 7);
+            uint8_t mask = ((1 << bpp) - 1) << shift;
+            uint8_t &b = r[bit >> 3];
+            b = (b & ~mask) | ((raw << shift) & mask);
+            break;
+        }
+        }
+    }
+
+    // Fill [x0, x1] inclusive on row y. Caller guarantees the span is in bounds.
+    void fillSpan(int x0, int x1, int y, uint32_t raw) const
+    {
+        uint8_t *r = row(y);
+        if (bpp == 16)
+        {
+            uint16_t *p = (uint16_t *)r + x0;
+            for (int x = x0; x <= x1; x++)
+                *p++ = (uint16_t)raw;
+            return;
+        }
+        if (bpp == 8)
+        {
+            memset(r + x0, (int)raw, x1 - x0 + 1);
+            return;
+        }
+        if (bpp < 8)
+        {
+            int ppb = 8 / bpp;
+            // leading partial byte
+            while (x0 <= x1 && (x0 % ppb) != 0)
+                set(x0++, y, raw);
+            // trailing partial byte
+            while (x1 >= x0 && ((x1 + 1) % ppb) != 0)
+                set(x1--, y, raw);
+            if (x0 <= x1)
+            {
+                uint8_t pattern = 0;
+                for (int i = 0; i < ppb; i++)
+                    pattern = (pattern << bpp) | (raw & ((1 << bpp) - 1));
+                memset(r + (x0 * bpp >> 3), pattern, (x1 - x0 + 1) * bpp >> 3);
+            }
+            return;
+        }
+        for (int x = x0; x <= x1; x++)
+            set(x, y, raw);
+    }
+};
+
+// Clip a w x h copy from (sx, sy) in src to (dx, dy) in dst against both surfaces.
+inline bool clipCopy(const Surface &dst, int &dx, int &dy, const Surface &src, int &sx, int &sy, int &w, int &h)
+{
+    if (sx < 0)
+    {
+        w += sx;
+        dx -= sx;
+        sx = 0;
+    }
+    if (sy < 0)
+    {
+        h += sy;
+        dy -= sy;
+        sy = 0;
+    }
+    if (dx < 0)
+    {
+        w += dx;
+        sx -= dx;
+        dx = 0;
+    }
+    if (dy < 0)
+    {
+        h += dy;
+        sy -= dy;
+        dy = 0;
+    }
+    if (sx + w > src.width)
+        w = src.width - sx;
+    if (sy + h > src.height)
+        h = src.height - sy;
+    if (dx + w > dst.width)
+        w = dst.width - dx;
+    if (dy + h > dst.height)
+        h = dst.height - dy;
+    return w > 0 && h > 0;
+}
+
+// Copy a rectangle between surfaces of the same depth. src and dst may be the
+// same surface with overlapping rectangles (rows and pixels are walked in the
+// direction that keeps unread source data intact).
+inline bool blit(const Surface &dst, int dx, int dy, const Surface &src, int sx, int sy, int w, int h)
+{
+    if (!dst.valid() || !src.valid() || dst.bpp != src.bpp)
+        return false;
+    if (!clipCopy(dst, dx, dy, src, sx, sy, w, h))
+        return true;
+
+    bool sameBuf = dst.buf == src.buf;
+    bool bottomUp = sameBuf && dy > sy;
+    bool byteAligned = dst.bpp >= 8 || ((sx * src.bpp) & 7) == ((dx * dst.bpp) & 7);
+
+    for (int i = 0; i < h; i++)
+    {
+        int row = bottomUp ? (h - 1 - i) : i;
+        int srow = sy + row;
+        int drow = dy + row;
+
+        if (byteAligned && dst.bpp >= 8)
+        {
+            int bytesPP = dst.bpp >> 3;
+            memmove(dst.row(drow) + dx * bytesPP, src.row(srow) + sx * bytesPP, (size_t)w * bytesPP);
+            continue;
+        }
+
+        // sub-byte depth: copy edge pixels one by one, whole bytes with memmove
+        bool rightToLeft = sameBuf && drow == srow && dx > sx;
+        int ppb = 8 / dst.bpp;
+        int head = byteAligned ? (ppb - (dx % ppb)) % ppb : w;
+        if (head > w)
+            head = w;
+        int midBytes = byteAligned ? ((w - head) / ppb) : 0;
+        int tail = w - head - midBytes * ppb;
+
+        auto copyPixels = [&](int from, int count)
+        {
+            if (rightToLeft)
+            {
+                for (int k = count - 1; k >= 0; k--)
+                    dst.set(dx + from + k, drow, src.get(sx + from + k, srow));
+            }
+            else
+            {
+                for (int k = 0; k < count; k++)
+                    dst.set(dx + from + k, drow, src.get(sx + from + k, srow));
+            }
+        };
+
+        if (rightToLeft)
+            copyPixels(head + midBytes * ppb, tail);
+        else
+            copyPixels(0, head);
+        if (midBytes > 0)
+        {
+            memmove(dst.row(drow) + ((dx + head) * dst.bpp >> 3), src.row(srow) + ((sx + head) * src.bpp >> 3),
+                    midBytes);
+        }
+        if (rightToLeft)
+            copyPixels(0, head);
+        else
+            copyPixels(head + midBytes * ppb, tail);
+    }
+    return true;
+}
+
+// Shift the whole surface contents by (dx, dy); uncovered area is filled with raw.
+inline void scroll(const Surface &s, int dx, int dy, uint32_t raw)
+{
+    if (!s.valid() || (dx == 0 && dy == 0))
+        return;
+
+    blit(s, dx, dy, s, 0, 0, s.width, s.height);
+
+    int y0 = dy > 0 ? 0 : s.height + dy;
+    int y1 = dy > 0 ? dy : s.height;
+    for (int y = (y0 < 0 ? 0 : y0); y < y1 && y < s.height; y++)
+        s.fillSpan(0, s.width - 1, y, raw);
+
+    if (dx != 0)
+    {
+        int x0 = dx > 0 ? 0 : s.width + dx;
+        int x1 = dx > 0 ? dx - 1 : s.width - 1;
+        if (x0 < 0)
+            x0 = 0;
+        if (x1 >= s.width)
+            x1 = s.width - 1;
+        if (x0 <= x1)
+        {
+            for (int y = 0; y < s.height; y++)
+                s.fillSpan(x0, x1, y, raw);
+        }
+    }
+}
+
+// Scanline span flood fill (Heckbert). Replaces the 4-connected region of
+// pixels matching the raw value at (x, y) with fillRaw. The span stack grows
+// as needed, so the whole region is always filled. Returns filled pixel count.
+inline uint32_t floodFill(const Surface &s, int x, int y, uint32_t fillRaw)
+{
+    if (!s.valid() || !s.contains(x, y))
+        return 0;
+
+    uint32_t target = s.get(x, y);
+    if (target == fillRaw)
+        return 0;
+
+    struct Span
+    {
+        int16_t x1, x2, y, dy;
+    };
+    std::vector<Span> stack;
+    stack.reserve(64);
+
+    auto inside = [&](int px, int py) { return px >= 0 && px < s.width && s.get(px, py) == target; };
+    auto push = [&](int x1, int x2, int py, int dy)
+    {
+        if (py >= 0 && py < s.height)
+            stack.push_back({(int16_t)x1, (int16_t)x2, (int16_t)py, (int16_t)dy});
+    };
+
+    uint32_t filled = 0;
+    push(x, x, y, 1);
+    push(x, x, y - 1, -1);
+
+    while (!stack.empty())
+    {
+        Span sp = stack.back();
+        stack.pop_back();
+        int x1 = sp.x1;
+        int x2 = sp.x2;
+        int py = sp.y;
+        int dy = sp.dy;
+
+        int cx = x1;
+        if (inside(cx, py))
+        {
+            while (inside(cx - 1, py))
+                cx--;
+            if (cx < x1)
+                push(cx, x1 - 1, py - dy, -dy);
+        }
+        while (x1 <= x2)
+        {
+            while (inside(x1, py))
+                x1++;
+            if (x1 > cx)
+            {
+                // [cx, x1) is one run of target pixels, including the left extension
+                s.fillSpan(cx, x1 - 1, py, fillRaw);
+                filled += x1 - cx;
+                push(cx, x1 - 1, py + dy, dy);
+            }
+            if (x1 - 1 > x2)
+                push(x2 + 1, x1 - 1, py - dy, -dy);
+            x1++;
+            while (x1 < x2 && !inside(x1, py))
+                x1++;
+            cx = x1;
+        }
+    }
+    return filled;
+}
+
+} // namespace Raster
+} // namespace UI
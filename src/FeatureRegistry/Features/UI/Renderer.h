@@ -33,6 +33,43 @@ inline int &stripOffsetY()
     return oy;
 }
 
+// Observer for finished strips, e.g. remote screen mirroring. Called on the UI
+// task right after each strip went to the panel with the strip's pixels
+// (byte-swapped RGB565, w pixels per row), then once with h = 0 and pixels =
+// nullptr when the frame is complete. nullptr (the default) costs one check per strip.
+using StripTap = void (*)(int y, int w, int h, const uint16_t *pixels);
+
+inline StripTap &stripTap()
+{
+    static StripTap tap = nullptr;
+    return tap;
+}
+
+// Observer for drawing that goes straight to the panel instead of through
+// renderStrips (screen commands, draw batches). Called on the UI task with the
+// rows that changed, so e.g. the mirror can read them back from the panel.
+using PanelDrawTap = void (*)(int y, int h);
+
+inline PanelDrawTap &panelDrawTap()
+{
+    static PanelDrawTap tap = nullptr;
+    return tap;
+}
+
+// Report rows [y0, y1) drawn directly to the panel; clipped to the screen
+inline void markRowsDrawn(int y0, int y1)
+{
+    PanelDrawTap tap = panelDrawTap();
+    if (tap == nullptr)
+        return;
+    if (y0 < 0)
+        y0 = 0;
+    if (y1 > tft.height())
+        y1 = tft.height();
+    if (y0 < y1)
+        tap(y0, y1 - y0);
+}
+
 inline bool initRenderer()
 {
     size_t bufSize = MAX_DIM * STRIP_H * 2; // 16-bit
@@ -96,10 +133,16 @@ template <typename DrawFn> inline void renderStrips(DrawFn drawFn)
 
         // Push strip to screen. Use pushImage for partial height strips.
         tft.pushImage(0, sy, sw, stripH, (uint16_t *)stripBuffer());
+
+        if (StripTap tap = stripTap())
+            tap(sy, sw, stripH, (const uint16_t *)stripBuffer());
     }
 
     stripOffsetY() = 0;
     tft.endWrite();
+
+    if (StripTap tap = stripTap())
+        tap(sh, sw, 0, nullptr);
 }
 
 inline void flush()
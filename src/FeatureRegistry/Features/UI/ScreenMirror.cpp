@@ -0,0 +1,440 @@
+#include "ScreenMirror.h"
+
+#if ENABLE_UI && ENABLE_WEBSERVER
+
+#include "MirrorCodec.h"
+#include "Renderer.h"
+#include "../Logging.h"
+#include "../../../ActionRegistry/ActionRegistry.h"
+#include "../../../CommandInterpreter/CommandArgs.h"
+#include "../../../services/WebServer.h"
+#include "../../../utils/Metrics.h"
+#include "../../../utils/System.h"
+
+#include <esp_http_server.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace UI
+{
+
+static const char *MIRROR_TAG = "ScreenMirror";
+
+static constexpr int SEG_W = 32;
+static constexpr int SEGS_PER_ROW = MAX_DIM / SEG_W;
+
+enum MirrorPacketType : uint8_t
+{
+    MIRROR_STRIP = 1,
+    MIRROR_FRAME_END = 2
+};
+
+// --- Shared between httpd, sender and UI task ---
+
+static std::mutex s_mutex; // guards s_viewers and s_queue
+static std::vector<int> s_viewers;
+static std::deque<std::vector<uint8_t>> s_queue;
+static size_t s_queuedBytes = 0;
+
+static std::atomic<int> s_viewerCount{0};
+static std::atomic<bool> s_resync{false};       // next captured frame is sent in full
+static std::atomic<bool> s_pendingFrame{false}; // a frame was skipped, ask the UI for another one
+static std::atomic<int64_t> s_frameIntervalUs{1000000 / SCREEN_MIRROR_DEFAULT_FPS};
+static TaskHandle_t s_senderTask = nullptr;
+
+// Bumped on the UI and sender tasks, read by the `mirror` action and /metrics
+static Counter s_framesSent("mirror_frames_sent_total", "Screen mirror frames sent to viewers");
+static Counter s_stripsSent("mirror_strips_sent_total", "Screen mirror strip updates sent to viewers");
+static Counter s_framesSkipped("mirror_frames_skipped_total", "Screen mirror frames skipped for slow viewers");
+static Counter s_bytesSent("mirror_sent_bytes_total", "Screen mirror bytes sent to viewers");
+
+// --- UI task only ---
+
+static uint32_t *s_hashes = nullptr; // [MAX_DIM][SEGS_PER_ROW] hashes of what viewers have
+static bool s_capturing = false;
+static bool s_fullFrame = false;
+static bool s_frameHasStrips = false;
+static int64_t s_lastFrameUs = 0;
+static int s_lastW = 0;
+static int s_lastH = 0;
+static uint32_t s_frameNo = 0;
+
+static void putHeader(std::vector<uint8_t> &out, MirrorPacketType type, int w, int h)
+{
+    out.push_back(type);
+    out.push_back(type == MIRROR_STRIP ? 1 : 0);
+    putMirror16(out, w);
+    putMirror16(out, h);
+}
+
+static bool enqueue(std::vector<uint8_t> &&packet)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_queuedBytes + packet.size() > SCREEN_MIRROR_QUEUE_BYTES)
+        return false;
+    s_queuedBytes += packet.size();
+    s_queue.push_back(std::move(packet));
+    return true;
+}
+
+static void mirrorTap(int y, int w, int h, const uint16_t *pixels);
+static void mirrorPanelTap(int y, int h);
+
+static void releaseCapture()
+{
+    free(s_hashes);
+    s_hashes = nullptr;
+    s_capturing = false;
+
+    stripTap() = nullptr;
+    panelDrawTap() = nullptr;
+    // a viewer may have connected (and installed the taps) since the count was read
+    if (s_viewerCount > 0)
+    {
+        stripTap() = mirrorTap;
+        panelDrawTap() = mirrorPanelTap;
+    }
+}
+
+static void beginFrame(int w, int h)
+{
+    s_capturing = false;
+    if (s_viewerCount == 0)
+    {
+        releaseCapture();
+        return;
+    }
+
+    if (!s_hashes)
+    {
+        s_hashes = (uint32_t *)malloc(sizeof(uint32_t) * MAX_DIM * SEGS_PER_ROW);
+        if (!s_hashes)
+        {
+            ESP_LOGE(MIRROR_TAG, "No memory for the change table");
+            return;
+        }
+        s_resync = true;
+    }
+
+    int64_t now = esp_timer_get_time();
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        queued = s_queuedBytes;
+    }
+    if (now - s_lastFrameUs < s_frameIntervalUs || queued > SCREEN_MIRROR_QUEUE_BYTES / 2)
+    {
+        s_pendingFrame = true;
+        s_framesSkipped.inc();
+        return;
+    }
+
+    s_capturing = true;
+    s_pendingFrame = false;
+    s_lastFrameUs = now;
+    s_frameHasStrips = false;
+    s_fullFrame = s_resync.exchange(false) || w != s_lastW || h != s_lastH;
+    s_lastW = w;
+    s_lastH = h;
+}
+
+static void captureStrip(int y, int w, int h, const uint16_t *pixels)
+{
+    static uint32_t fresh[STRIP_H * SEGS_PER_ROW];
+    int segs = (w + SEG_W - 1) / SEG_W;
+
+    // bounding box of the segments that differ from what viewers have
+    int minSeg = segs, maxSeg = -1, minRow = h, maxRow = -1;
+    for (int r = 0; r < h; r++)
+    {
+        const uint16_t *row = pixels + r * w;
+        uint32_t *known = s_hashes + (y + r) * SEGS_PER_ROW;
+        for (int s = 0; s < segs; s++)
+        {
+            int x = s * SEG_W;
+            uint32_t hash = hashMirrorSegment(row + x, std::min(SEG_W, w - x));
+            fresh[r * SEGS_PER_ROW + s] = hash;
+            if (s_fullFrame || hash != known[s])
+            {
+                minSeg = std::min(minSeg, s);
+                maxSeg = std::max(maxSeg, s);
+                minRow = std::min(minRow, r);
+                maxRow = std::max(maxRow, r);
+            }
+        }
+    }
+    if (maxSeg < 0)
+        return;
+
+    int x0 = minSeg * SEG_W;
+    int x1 = std::min(w, (maxSeg + 1) * SEG_W);
+    int rw = x1 - x0;
+    int rh = maxRow - minRow + 1;
+
+    std::vector<uint8_t> packet;
+    packet.reserve(16 + (size_t)rw * rh); // typical UI content compresses well below 2 bytes/pixel
+    putHeader(packet, MIRROR_STRIP, s_lastW, s_lastH);
+    putMirror16(packet, x0);
+    putMirror16(packet, y + minRow);
+    putMirror16(packet, rw);
+    putMirror16(packet, rh);
+    for (int r = minRow; r <= maxRow; r++)
+        encodeMirrorRow(packet, pixels + r * w + x0, rw);
+
+    size_t size = packet.size();
+    if (!enqueue(std::move(packet)))
+    {
+        // the known hashes stay as they are, so the next frame sends this area
+        // again; a full frame has to be repeated as a whole
+        if (s_fullFrame)
+            s_resync = true;
+        s_pendingFrame = true;
+        return;
+    }
+
+    for (int r = minRow; r <= maxRow; r++)
+        memcpy(s_hashes + (y + r) * SEGS_PER_ROW, fresh + r * SEGS_PER_ROW, sizeof(uint32_t) * segs);
+    s_frameHasStrips = true;
+    s_stripsSent.inc();
+    s_bytesSent.inc(size);
+}
+
+static void endFrame()
+{
+    if (!s_capturing || !s_frameHasStrips)
+        return;
+
+    std::vector<uint8_t> packet;
+    putHeader(packet, MIRROR_FRAME_END, s_lastW, s_lastH);
+    uint32_t frameNo = ++s_frameNo;
+    putMirror16(packet, frameNo & 0xFFFF);
+    putMirror16(packet, frameNo >> 16);
+    if (enqueue(std::move(packet)))
+        s_framesSent.inc();
+    xTaskNotifyGive(s_senderTask);
+}
+
+static void mirrorTap(int y, int w, int h, const uint16_t *pixels)
+{
+    if (h == 0)
+    {
+        endFrame();
+        return;
+    }
+    if (y == 0)
+        beginFrame(w, tft.height());
+    if (s_capturing && s_hashes)
+        captureStrip(y, w, h, pixels);
+}
+
+// Rows drawn straight to the panel never pass through the strip tap. They are
+// read back from the panel a strip at a time, into the strip buffer that is
+// idle between renders (readRect gives the byte order pushImage takes), and
+// sent as a frame of their own.
+static void mirrorPanelTap(int y, int h)
+{
+    uint16_t *pixels = (uint16_t *)stripBuffer();
+    int w = tft.width();
+    // with a full frame due, that frame covers these rows
+    if (s_viewerCount == 0 || !s_hashes || !pixels || s_resync || w != s_lastW || tft.height() != s_lastH)
+        return;
+
+    s_capturing = true;
+    s_fullFrame = false;
+    s_frameHasStrips = false;
+    for (int sy = y; sy < y + h; sy += STRIP_H)
+    {
+        int stripH = std::min(STRIP_H, y + h - sy);
+        tft.readRect(0, sy, w, stripH, pixels);
+        captureStrip(sy, w, stripH, pixels);
+    }
+    endFrame();
+    s_capturing = false;
+}
+
+// --- Viewers ---
+
+static void removeViewer(int fd)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto it = std::find(s_viewers.begin(), s_viewers.end(), fd);
+    if (it != s_viewers.end())
+    {
+        s_viewers.erase(it);
+        s_viewerCount = s_viewers.size();
+    }
+    if (s_viewers.empty())
+    {
+        s_queue.clear();
+        s_queuedBytes = 0;
+    }
+}
+
+void mirrorOnSessionClose(int sockfd)
+{
+    removeViewer(sockfd);
+}
+
+static void mirrorSenderTask(void *)
+{
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(s_frameIntervalUs / 1000));
+
+        httpd_handle_t server = getHttpServer();
+        while (server)
+        {
+            std::vector<uint8_t> packet;
+            std::vector<int> viewers;
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                if (s_queue.empty())
+                    break;
+                packet = std::move(s_queue.front());
+                s_queue.pop_front();
+                s_queuedBytes -= packet.size();
+                viewers = s_viewers;
+            }
+
+            httpd_ws_frame_t frame;
+            memset(&frame, 0, sizeof(frame));
+            frame.type = HTTPD_WS_TYPE_BINARY;
+            frame.payload = packet.data();
+            frame.len = packet.size();
+            for (int fd : viewers)
+            {
+                if (httpd_ws_send_frame_async(server, fd, &frame) != ESP_OK)
+                {
+                    ESP_LOGW(MIRROR_TAG, "Dropping viewer fd %d", fd);
+                    removeViewer(fd);
+                    httpd_sess_trigger_close(server, fd);
+                }
+            }
+        }
+
+        // frames skipped by the rate limit still have to reach the viewers,
+        // even if the UI goes idle right after
+        if (s_pendingFrame && s_viewerCount > 0 && esp_timer_get_time() - s_lastFrameUs >= s_frameIntervalUs)
+            markDirty();
+    }
+}
+
+static esp_err_t mirrorWsHandler(httpd_req_t *req)
+{
+    int fd = httpd_req_to_sockfd(req);
+    if (req->method == HTTP_GET)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (std::find(s_viewers.begin(), s_viewers.end(), fd) == s_viewers.end())
+                s_viewers.push_back(fd);
+            s_viewerCount = s_viewers.size();
+        }
+        s_resync = true;
+        s_pendingFrame = true;
+        stripTap() = mirrorTap;
+        panelDrawTap() = mirrorPanelTap;
+        markDirty();
+        loggerInstance->Info("Screen viewer connected: fd=" + std::to_string(fd));
+        return ESP_OK;
+    }
+
+    // viewers only listen; read and discard whatever they send
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, 0);
+    if (ret != ESP_OK)
+        return ret;
+
+    if (frame.len > 0)
+    {
+        std::vector<uint8_t> buf(frame.len);
+        frame.payload = buf.data();
+        ret = httpd_ws_recv_frame(req, &frame, frame.len);
+        if (ret != ESP_OK)
+            return ret;
+    }
+
+    if (frame.type == HTTPD_WS_TYPE_CLOSE)
+    {
+        removeViewer(fd);
+        loggerInstance->Info("Screen viewer closed: fd=" + std::to_string(fd));
+    }
+    return ESP_OK;
+}
+
+// --- mirror action ---
+
+static std::string mirrorHandler(const CommandArgs &args)
+{
+    std::string sub = args.str(1);
+    if (sub == "fps")
+    {
+        int fps = args.toInt(2);
+        if (fps < 1 || fps > 30)
+        {
+            return "{\"error\": \"fps must be 1..30\"}";
+        }
+        s_frameIntervalUs = 1000000 / fps;
+    }
+    else if (!sub.empty())
+    {
+        return "{\"error\": \"Usage: mirror [fps <1..30>]\"}";
+    }
+
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        queued = s_queuedBytes;
+    }
+    return JsonWriter::toString(
+        [queued](JsonWriter &out)
+        {
+            out.beginObject()
+                .field("viewers", s_viewerCount.load())
+                .field("fps", 1000000 / s_frameIntervalUs)
+                .field("frames", s_framesSent.value())
+                .field("strips", s_stripsSent.value())
+                .field("skipped", s_framesSkipped.value())
+                .field("bytes", s_bytesSent.value())
+                .field("queuedBytes", queued)
+                .endObject();
+        });
+}
+
+static FeatureAction mirrorAction = {.name = "mirror",
+                                     .handler = mirrorHandler,
+                                     .transports = {.cli = true, .rest = true, .ws = true, .scripting = true}};
+
+void initScreenMirror()
+{
+    httpd_handle_t server = getHttpServer();
+    if (!server)
+    {
+        loggerInstance->Error("Cannot init screen mirror: HTTP server not started");
+        return;
+    }
+
+    static const httpd_uri_t mirrorUri = {.uri = SCREEN_MIRROR_URL,
+                                          .method = HTTP_GET,
+                                          .handler = mirrorWsHandler,
+                                          .user_ctx = nullptr,
+                                          .is_websocket = true};
+    httpd_register_uri_handler(server, &mirrorUri);
+
+    xTaskCreate(mirrorSenderTask, "screen_mirror", 3072, nullptr, 3, &s_senderTask);
+    watchTaskStack(s_senderTask);
+    actionRegistryInstance->registerAction(&mirrorAction);
+}
+
+} // namespace UI
+
+#endif // ENABLE_UI && ENABLE_WEBSERVER
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../../../config.h"
+
+#if ENABLE_UI && ENABLE_WEBSERVER
+
+/**
+ * Live screen mirroring over a binary WebSocket (SCREEN_MIRROR_URL).
+ *
+ * Every connected viewer gets the same stream of messages, all integers
+ * little-endian:
+ *
+ *   strip update   u8 type = 1, u8 encoding = 1 (RLE), u16 screenW, u16 screenH,
+ *                  u16 x, u16 y, u16 w, u16 h, RLE data
+ *   frame end      u8 type = 2, u8 0, u16 screenW, u16 screenH, u32 frameNo
+ *
+ * A strip update covers the changed part of one render strip. The RLE data
+ * holds the rectangle row by row. Each row is a sequence of runs, and each run
+ * starts with a control byte c:
+ *   c < 128    c + 1 literal pixels follow
+ *   c >= 128   one pixel follows, repeated c - 125 times (3..130)
+ * Pixels are 16-bit RGB565, high byte first, exactly as sent to the panel.
+ *
+ * Change detection keeps one hash per 32 pixel row segment of what was last
+ * sent (a few KB), never a frame copy. A new viewer, or a rotation, triggers a
+ * full frame. Drawing that bypasses the renderer (screen commands, draw
+ * batches) reports its rows with markRowsDrawn(); those rows are read back
+ * from the panel and sent the same way. Without viewers the renderer hooks are
+ * removed and the hash table freed.
+ */
+
+namespace UI
+{
+
+// Registers the WebSocket endpoint and the `mirror` action. Call after the
+// HTTP server is running.
+void initScreenMirror();
+
+// Drops a viewer whose socket was closed
+void mirrorOnSessionClose(int sockfd);
+
+} // namespace UI
+
+#endif
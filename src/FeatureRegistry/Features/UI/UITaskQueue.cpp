@@ -20,6 +20,8 @@ static TaskHandle_t sUiTaskHandle = nullptr;
 static SemaphoreHandle_t sSyncMutex = nullptr;
 static SemaphoreHandle_t sSyncDone = nullptr;
 
+static IdleHandler sIdleHandler = nullptr;
+
 void initTaskQueue()
 {
     sCmdQueue = xQueueCreate(8, sizeof(UICommand));
@@ -83,6 +85,19 @@ std::string postToUITaskWithResult(std::function<std::string()> action)
     return result;
 }
 
+void setIdleHandler(IdleHandler handler)
+{
+    sIdleHandler = handler;
+}
+
+void runIdleHandler(int64_t budgetUs)
+{
+    if (sIdleHandler != nullptr && budgetUs > 0)
+    {
+        sIdleHandler(budgetUs);
+    }
+}
+
 } // namespace UI
 
 #endif // ENABLE_UI
@@ -23,6 +23,12 @@ void postToUITaskSync(std::function<void()> action);
 
 std::string postToUITaskWithResult(std::function<std::string()> action);
 
+// Deferred work hook, called on the UI task when the loop is idle (no touch in
+// progress, frame drawn) with the time left before the next frame is due.
+using IdleHandler = void (*)(int64_t budgetUs);
+void setIdleHandler(IdleHandler handler);
+void runIdleHandler(int64_t budgetUs);
+
 } // namespace UI
 
 #endif // ENABLE_UI
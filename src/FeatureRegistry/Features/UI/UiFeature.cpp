@@ -3,6 +3,7 @@
 #if ENABLE_UI
 
 #include <string>
+#include <atomic>
 #include <cstdlib>
 #include <esp_timer.h>
 #include "../Logging.h"
@@ -13,22 +14,76 @@
 #include "Desktop.h"
 #include "WindowManager.h"
 #include "UITaskQueue.h"
+#include "ScreenMirror.h"
+#include "DrawBatch.h"
 #include <LovyanGFX.hpp>
 #include "../../../hw/Screen.h"
 #include "../../Feature.h"
 #include "../../../ActionRegistry/FeatureAction.h"
-#include "../../../CommandInterpreter/CommandParser.h"
+#include "../../../CommandInterpreter/CommandArgs.h"
+#include "../../../utils/CJsonHelper.h"
+#include "../../../utils/Metrics.h"
 #include "./Calibration.h"
 
+#if ENABLE_WEBSERVER
+#include "../../../services/WebSocketServer.h"
+#endif
+
+#define FRAME_PERIOD_US 33000
+
 static volatile bool frameReady = true;
+// Set by the timer task, read by the UI task; a 64-bit volatile could tear
+static std::atomic<int64_t> frameTickUs{0};
 static esp_timer_handle_t frameTimer = nullptr;
 static bool uiTaskInitDone = false;
 
+// Anything above FRAME_PERIOD_US costs a frame
+static const uint32_t FRAME_DRAW_US[] = {1000, 2000, 5000, 10000, 16000, 33000, 50000, 100000, 250000};
+static Histogram frameDrawTime("ui_frame_draw_seconds", "Time to draw one frame", nullptr, FRAME_DRAW_US, 1e-6);
+
+// --- Results ---
+
+// The UI handlers build their result as a cJSON tree on the UI task; the
+// transport encodes it (JSON text or CBOR) after the hop.
+static cJSON *uiEvent(const char *event)
+{
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "event", event);
+    return result;
+}
+
+static cJSON *uiError(const char *message)
+{
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "error", message);
+    return result;
+}
+
+static cJSON *uiStatusOk()
+{
+    cJSON *result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "status", "ok");
+    return result;
+}
+
+static cJSON *runOnUITask(cJSON *(*impl)(const CommandArgs &), const CommandArgs &args)
+{
+    cJSON *result = nullptr;
+    UI::postToUITaskSync([&]() { result = impl(args); });
+    return result;
+}
+
+static std::string printResult(cJSON *result)
+{
+    CJsonPtr owned(result);
+    return cJsonToString(owned.get());
+}
+
 // --- Screen command handler ---
 
-static std::string screenCommandHandlerImpl(const std::string &command)
+static cJSON *screenCommandImpl(const CommandArgs &args)
 {
-    std::string sub = CommandParser::getCommandParameter(command, 1);
+    std::string sub = args.str(1);
 
     if (sub == "calibrate")
     {
@@ -36,16 +91,20 @@ static std::string screenCommandHandlerImpl(const std::string &command)
         vTaskDelay(pdMS_TO_TICKS(1000)); // Let user see "Calibration complete!" message
         tft.fillScreen(TFT_BLACK);
         tft.waitDisplay(); // Wait for fillScreen to complete
+        cJSON *result = uiEvent("calibrate");
         if (!UI::reinitRenderer())
         {
             loggerInstance->Error("Failed to reinit renderer after calibration");
-            return std::string("{\"event\":\"calibrate\", \"status\":\"error\", \"message\":\"renderer_init_failed\"}");
+            cJSON_AddStringToObject(result, "status", "error");
+            cJSON_AddStringToObject(result, "message", "renderer_init_failed");
+            return result;
         }
         UI::windowManager().relayoutAll();
         frameReady = true; // Ensure next frame will render
         UI::markDirty();   // Ensure UI knows it needs redraw
         loggerInstance->Info("Calibrated touch screen");
-        return std::string("{\"event\":\"calibrate\", \"status\":\"success\"}");
+        cJSON_AddStringToObject(result, "status", "success");
+        return result;
     }
     else if (sub == "demo")
     {
@@ -57,138 +116,169 @@ static std::string screenCommandHandlerImpl(const std::string &command)
 
         tft.drawCircle(120, 160, 50, TFT_MAGENTA);
         tft.drawEllipse(200, 160, 60, 40, TFT_GOLD);
+        UI::markRowsDrawn(0, tft.height());
 
         loggerInstance->Info("Displayed hello world demo");
-        return std::string("{\"event\":\"helloDemo\"}");
+        return uiEvent("helloDemo");
     }
     else if (sub == "rotate")
     {
-        std::string rotateParam = CommandParser::getCommandParameter(command, 2);
-        uint16_t rotate = 0;
-        if (rotateParam.length() > 0)
-        {
-            rotate = (uint16_t)strtoul(rotateParam.c_str(), NULL, 0);
-        }
+        uint16_t rotate = args.toInt(2, 0);
         tft.setRotation(rotate);
         tft.fillScreen(TFT_BLACK);
         tft.waitDisplay(); // Wait for fillScreen to complete
+        cJSON *result = uiEvent("rotate");
+        cJSON_AddNumberToObject(result, "rotation", rotate);
         if (!UI::reinitRenderer())
         {
             loggerInstance->Error("Failed to reinit renderer after rotation");
-            return std::string("{\"event\":\"rotate\",\"rotation\":") + std::to_string(rotate) +
-                   ",\"error\":\"renderer_init_failed\"}";
+            cJSON_AddStringToObject(result, "error", "renderer_init_failed");
+            return result;
         }
         readCalibrationData(); // Loads rotation-specific calibration
         UI::windowManager().relayoutAll();
         frameReady = true; // Ensure next frame will render
         UI::markDirty();   // Ensure UI knows it needs redraw
         loggerInstance->Info("Screen rotated to " + std::to_string(rotate));
-        return std::string("{\"event\":\"rotate\",\"rotation\":") + std::to_string(rotate) + "}";
+        return result;
     }
     else if (sub == "clear")
     {
-        std::string colorParam = CommandParser::getCommandParameter(command, 2);
-        uint16_t color = TFT_BLACK;
-        if (colorParam.length() > 0)
-        {
-            color = (uint16_t)strtoul(colorParam.c_str(), NULL, 0);
-        }
+        uint16_t color = args.toColor(2, TFT_BLACK);
         tft.fillScreen(color);
+        UI::markRowsDrawn(0, tft.height());
         loggerInstance->Info("Screen cleared");
-        return std::string("{\"event\":\"clear\",\"color\":\"") + colorParam + "\"}";
+        cJSON *result = uiEvent("clear");
+        cJSON_AddStringToObject(result, "color", args.str(2).c_str());
+        return result;
     }
     else if (sub == "text")
     {
-        int x = atoi(CommandParser::getCommandParameter(command, 2).c_str());
-        int y = atoi(CommandParser::getCommandParameter(command, 3).c_str());
-        uint16_t fg = (uint16_t)strtoul(CommandParser::getCommandParameter(command, 4).c_str(), NULL, 0);
-        uint16_t bg = (uint16_t)strtoul(CommandParser::getCommandParameter(command, 5).c_str(), NULL, 0);
-        int sz = atoi(CommandParser::getCommandParameter(command, 6).c_str());
-        int count = 0;
-        int pos = -1;
-        for (int i = 0; i < (int)command.length(); ++i)
-        {
-            if (command[i] == ' ')
-            {
-                if (++count == 6)
-                {
-                    pos = i;
-                    break;
-                }
-            }
-        }
-        std::string msg = (pos >= 0) ? command.substr(pos + 1) : std::string();
+        int x = args.toInt(2);
+        int y = args.toInt(3);
+        uint16_t fg = args.toColor(4);
+        uint16_t bg = args.toColor(5);
+        int sz = args.toInt(6);
+        // "quoted text" is one word; unquoted text runs to the end of the line
+        std::string msg = args.size() > 8 ? std::string(args.rest(7)) : args.str(7);
         tft.setCursor(x, y);
         tft.setTextColor(fg, bg);
         tft.setTextSize(sz);
         tft.print(msg.c_str());
-        loggerInstance->Info("Drew text: " + msg);
-        return std::string("{\"event\":\"text\"}");
+        UI::markRowsDrawn(y, tft.height()); // the text may wrap
+        LOG_DEBUG("Drew text: " + msg);
+        return uiEvent("text");
     }
     else if (sub == "pixel")
     {
-        int x = atoi(CommandParser::getCommandParameter(command, 2).c_str());
-        int y = atoi(CommandParser::getCommandParameter(command, 3).c_str());
-        uint16_t color = (uint16_t)strtoul(CommandParser::getCommandParameter(command, 4).c_str(), NULL, 0);
+        int x = args.toInt(2);
+        int y = args.toInt(3);
+        uint16_t color = args.toColor(4);
         tft.drawPixel(x, y, color);
-        loggerInstance->Info("Drew pixel at " + std::to_string(x) + "," + std::to_string(y));
-        return std::string("{\"event\":\"pixel\"}");
+        UI::markRowsDrawn(y, y + 1);
+        LOG_DEBUG("Drew pixel at " + std::to_string(x) + "," + std::to_string(y));
+        return uiEvent("pixel");
     }
     else if (sub == "rect")
     {
-        int x = atoi(CommandParser::getCommandParameter(command, 2).c_str());
-        int y = atoi(CommandParser::getCommandParameter(command, 3).c_str());
-        int w = atoi(CommandParser::getCommandParameter(command, 4).c_str());
-        int h = atoi(CommandParser::getCommandParameter(command, 5).c_str());
-        uint16_t color = (uint16_t)strtoul(CommandParser::getCommandParameter(command, 6).c_str(), NULL, 0);
+        int x = args.toInt(2);
+        int y = args.toInt(3);
+        int w = args.toInt(4);
+        int h = args.toInt(5);
+        uint16_t color = args.toColor(6);
         tft.drawRect(x, y, w, h, color);
-        loggerInstance->Info("Drew rect at " + std::to_string(x) + "," + std::to_string(y));
-        return std::string("{\"event\":\"rect\"}");
+        UI::DrawRows rows;
+        rows.addRect(y, h);
+        UI::markRowsDrawn(rows.y0, rows.y1);
+        LOG_DEBUG("Drew rect at " + std::to_string(x) + "," + std::to_string(y));
+        return uiEvent("rect");
     }
     else if (sub == "fillrect")
     {
-        int x = atoi(CommandParser::getCommandParameter(command, 2).c_str());
-        int y = atoi(CommandParser::getCommandParameter(command, 3).c_str());
-        int w = atoi(CommandParser::getCommandParameter(command, 4).c_str());
-        int h = atoi(CommandParser::getCommandParameter(command, 5).c_str());
-        uint16_t color = (uint16_t)strtoul(CommandParser::getCommandParameter(command, 6).c_str(), NULL, 0);
+        int x = args.toInt(2);
+        int y = args.toInt(3);
+        int w = args.toInt(4);
+        int h = args.toInt(5);
+        uint16_t color = args.toColor(6);
         tft.fillRect(x, y, w, h, color);
-        loggerInstance->Info("Drew filled rect at " + std::to_string(x) + "," + std::to_string(y));
-        return std::string("{\"event\":\"fillrect\"}");
+        UI::DrawRows rows;
+        rows.addRect(y, h);
+        UI::markRowsDrawn(rows.y0, rows.y1);
+        LOG_DEBUG("Drew filled rect at " + std::to_string(x) + "," + std::to_string(y));
+        return uiEvent("fillrect");
     }
     else if (sub == "circle")
     {
-        int x = atoi(CommandParser::getCommandParameter(command, 2).c_str());
-        int y = atoi(CommandParser::getCommandParameter(command, 3).c_str());
-        int r = atoi(CommandParser::getCommandParameter(command, 4).c_str());
-        uint16_t color = (uint16_t)strtoul(CommandParser::getCommandParameter(command, 5).c_str(), NULL, 0);
+        int x = args.toInt(2);
+        int y = args.toInt(3);
+        int r = args.toInt(4);
+        uint16_t color = args.toColor(5);
         tft.drawCircle(x, y, r, color);
-        loggerInstance->Info("Drew circle at " + std::to_string(x) + "," + std::to_string(y));
-        return std::string("{\"event\":\"circle\"}");
+        UI::DrawRows rows;
+        rows.addCircle(y, r);
+        UI::markRowsDrawn(rows.y0, rows.y1);
+        LOG_DEBUG("Drew circle at " + std::to_string(x) + "," + std::to_string(y));
+        return uiEvent("circle");
     }
     else if (sub == "fillcircle")
     {
-        int x = atoi(CommandParser::getCommandParameter(command, 2).c_str());
-        int y = atoi(CommandParser::getCommandParameter(command, 3).c_str());
-        int r = atoi(CommandParser::getCommandParameter(command, 4).c_str());
-        uint16_t color = (uint16_t)strtoul(CommandParser::getCommandParameter(command, 5).c_str(), NULL, 0);
+        int x = args.toInt(2);
+        int y = args.toInt(3);
+        int r = args.toInt(4);
+        uint16_t color = args.toColor(5);
         tft.fillCircle(x, y, r, color);
-        loggerInstance->Info("Drew filled circle at " + std::to_string(x) + "," + std::to_string(y));
-        return std::string("{\"event\":\"fillcircle\"}");
+        UI::DrawRows rows;
+        rows.addCircle(y, r);
+        UI::markRowsDrawn(rows.y0, rows.y1);
+        LOG_DEBUG("Drew filled circle at " + std::to_string(x) + "," + std::to_string(y));
+        return uiEvent("fillcircle");
     }
     else if (sub == "brightness")
     {
-        std::string val = CommandParser::getCommandParameter(command, 2);
-        uint8_t b = (uint8_t)strtoul(val.c_str(), NULL, 0);
+        uint8_t b = args.toInt(2);
         tft.setBrightness(b);
         loggerInstance->Info("Brightness set to " + std::to_string(b));
-        return std::string("{\"event\":\"brightness\",\"value\":") + std::to_string(b) + "}";
+        cJSON *result = uiEvent("brightness");
+        cJSON_AddNumberToObject(result, "value", b);
+        return result;
     }
 
     loggerInstance->Info("Unknown screen subcommand: " + sub);
-    return std::string("{\"event\":\"screen\",\"error\":\"unknown\",\"sub\":\"") + sub + "\"}";
+    cJSON *result = uiEvent("screen");
+    cJSON_AddStringToObject(result, "error", "unknown");
+    cJSON_AddStringToObject(result, "sub", sub.c_str());
+    return result;
+}
+
+// --- Binary draw batches ---
+
+#if ENABLE_WEBSERVER
+
+// One UI task hop and one panel transaction for the whole batch, one reply
+static std::string drawBatchHandler(const uint8_t *data, size_t len)
+{
+    std::string error;
+    int ops = UI::validateDrawBatch(data, len, error);
+    if (ops < 0)
+    {
+        return "{\"error\": \"Invalid draw batch: " + error + "\"}";
+    }
+
+    int64_t start = esp_timer_get_time();
+    UI::postToUITaskSync(
+        [data, len]()
+        {
+            tft.startWrite();
+            UI::DrawRows rows = UI::runDrawBatch(tft, data, len);
+            tft.endWrite();
+            UI::markRowsDrawn(rows.y0, rows.y1);
+        });
+    int64_t us = esp_timer_get_time() - start;
+    return "{\"event\":\"draw\",\"ops\":" + std::to_string(ops) + ",\"us\":" + std::to_string(us) + "}";
 }
 
+#endif
+
 // --- Page command handler ---
 
 struct PageEntry
@@ -203,14 +293,19 @@ static const PageEntry PAGE_TABLE[] = {
     {"features", "Features"}, {"log", "Log Viewer"},  {"files", "File Manager"},
 };
 
-static std::string screenCommandHandler(const std::string &command)
+static cJSON *screenCommandObject(const CommandArgs &args)
 {
-    return UI::postToUITaskWithResult([&command]() -> std::string { return screenCommandHandlerImpl(command); });
+    return runOnUITask(screenCommandImpl, args);
 }
 
-static std::string pageCommandHandlerImpl(const std::string &command)
+static std::string screenCommandHandler(const CommandArgs &args)
 {
-    std::string sub = CommandParser::getCommandParameter(command, 1);
+    return printResult(screenCommandObject(args));
+}
+
+static cJSON *pageCommandImpl(const CommandArgs &args)
+{
+    std::string sub = args.str(1);
 
     for (const auto &entry : PAGE_TABLE)
     {
@@ -218,101 +313,124 @@ static std::string pageCommandHandlerImpl(const std::string &command)
         {
             UI::windowManager().openApp(entry.appName);
             loggerInstance->Info(std::string("Opening ") + entry.appName + " app");
-            return std::string("{\"event\":\"page\", \"status\":\"success\", \"page\":\"") + sub + "\"}";
+            cJSON *result = uiEvent("page");
+            cJSON_AddStringToObject(result, "status", "success");
+            cJSON_AddStringToObject(result, "page", sub.c_str());
+            return result;
         }
     }
 
     loggerInstance->Info("Unknown page subcommand: " + sub);
-    return std::string("{\"event\":\"page\",\"error\":\"unknown\",\"sub\":\"") + sub + "\"}";
+    cJSON *result = uiEvent("page");
+    cJSON_AddStringToObject(result, "error", "unknown");
+    cJSON_AddStringToObject(result, "sub", sub.c_str());
+    return result;
+}
+
+static cJSON *pageCommandObject(const CommandArgs &args)
+{
+    return runOnUITask(pageCommandImpl, args);
+}
+
+static std::string pageCommandHandler(const CommandArgs &args)
+{
+    return printResult(pageCommandObject(args));
 }
 
 // --- Window manager command handler ---
 
-static std::string pageCommandHandler(const std::string &command)
+static void addWindow(cJSON *apps, const std::string &name, bool focused, bool windowed)
 {
-    return UI::postToUITaskWithResult([&command]() -> std::string { return pageCommandHandlerImpl(command); });
+    cJSON *app = cJSON_CreateObject();
+    cJSON_AddStringToObject(app, "name", name.c_str());
+    cJSON_AddBoolToObject(app, "focused", focused);
+    cJSON_AddBoolToObject(app, "windowed", windowed);
+    cJSON_AddItemToArray(apps, app);
 }
 
-static std::string wmCommandHandlerImpl(const std::string &command)
+static cJSON *wmCommandImpl(const CommandArgs &args)
 {
-    std::string sub = CommandParser::getCommandParameter(command, 1);
+    std::string sub = args.str(1);
 
     if (sub == "list")
     {
-        auto &apps = UI::windowManager().getOpenApps();
+        auto &openApps = UI::windowManager().getOpenApps();
         auto *focused = UI::windowManager().getFocused();
         auto *panel = UI::windowManager().getPanelSlot();
-        std::string json = "{\"apps\":[";
-        bool first = true;
+        cJSON *result = cJSON_CreateObject();
+        cJSON *apps = cJSON_CreateArray();
+        cJSON_AddItemToObject(result, "apps", apps);
         if (panel != nullptr)
         {
-            json += "{\"name\":\"" + panel->name + "\",\"focused\":false,\"windowed\":false}";
-            first = false;
+            addWindow(apps, panel->name, false, false);
         }
-        for (size_t i = 0; i < apps.size(); i++)
+        for (size_t i = 0; i < openApps.size(); i++)
         {
-            if (!first)
-            {
-                json += ",";
-            }
-            first = false;
-            bool isFocused = ((focused != nullptr) && &apps[i] == focused);
-            json += R"({"name":")" + apps[i].name + "\",\"focused\":" + (isFocused ? "true" : "false") +
-                    ",\"windowed\":true}";
+            addWindow(apps, openApps[i].name, focused != nullptr && &openApps[i] == focused, true);
         }
-        json += "]}";
-        return json;
+        return result;
     }
 
     if (sub == "focus")
     {
-        std::string name = CommandParser::getCommandParameter(command, 2);
+        std::string name = args.str(2);
         if (name.empty())
         {
-            return "{\"error\":\"No app name\"}";
+            return uiError("No app name");
         }
         UI::windowManager().restoreApp(name.c_str());
-        return "{\"status\":\"ok\"}";
+        return uiStatusOk();
     }
 
     if (sub == "close")
     {
-        std::string name = CommandParser::getCommandParameter(command, 2);
+        std::string name = args.str(2);
         if (name.empty())
         {
-            return "{\"error\":\"No app name\"}";
+            return uiError("No app name");
         }
         UI::windowManager().closeApp(name.c_str());
-        return "{\"status\":\"ok\"}";
+        return uiStatusOk();
     }
 
     if (sub == "keyboard")
     {
         UI::desktop().toggleKeyboard();
-        return "{\"status\":\"ok\"}";
+        return uiStatusOk();
     }
 
-    return "{\"error\":\"Usage: wm list | wm focus <name> | wm close <name> | wm keyboard\"}";
+    return uiError("Usage: wm list | wm focus <name> | wm close <name> | wm keyboard");
 }
 
-static std::string wmCommandHandler(const std::string &command)
+static cJSON *wmCommandObject(const CommandArgs &args)
 {
-    return UI::postToUITaskWithResult([&command]() -> std::string { return wmCommandHandlerImpl(command); });
+    return runOnUITask(wmCommandImpl, args);
+}
+
+static std::string wmCommandHandler(const CommandArgs &args)
+{
+    return printResult(wmCommandObject(args));
 }
 
 // --- Action definitions ---
 
 static FeatureAction wmAction = {.name = "wm",
                                  .handler = wmCommandHandler,
-                                 .transports = {.cli = true, .rest = false, .ws = true, .scripting = true}};
+                                 .objectHandler = wmCommandObject,
+                                 .transports = {.cli = true, .rest = false, .ws = true, .scripting = true},
+                                 .uiTask = true};
 
 static FeatureAction screenAction = {.name = "screen",
                                      .handler = screenCommandHandler,
-                                     .transports = {.cli = true, .rest = false, .ws = true, .scripting = true}};
+                                     .objectHandler = screenCommandObject,
+                                     .transports = {.cli = true, .rest = false, .ws = true, .scripting = true},
+                                     .uiTask = true};
 
 static FeatureAction pageAction = {.name = "page",
                                    .handler = pageCommandHandler,
-                                   .transports = {.cli = true, .rest = false, .ws = true, .scripting = true}};
+                                   .objectHandler = pageCommandObject,
+                                   .transports = {.cli = true, .rest = false, .ws = true, .scripting = true},
+                                   .uiTask = true};
 
 // --- Feature ---
 
@@ -343,15 +461,21 @@ static Feature *createuiFeature()
             actionRegistryInstance->registerAction(&screenAction);
             actionRegistryInstance->registerAction(&pageAction);
             actionRegistryInstance->registerAction(&wmAction);
+            actionRegistryInstance->setUiTaskRunner([](const std::function<void()> &fn) { UI::postToUITaskSync(fn); });
+#if ENABLE_WEBSERVER
+            UI::initScreenMirror();
+            wsRegisterBinaryHandler(WS_BINARY_DRAW_BATCH, drawBatchHandler);
+#endif
 
             esp_timer_create_args_t args = {};
             args.callback = [](void *)
             {
                 frameReady = true;
+                frameTickUs.store(esp_timer_get_time(), std::memory_order_relaxed);
             };
             args.name = "ui_frame";
             esp_timer_create(&args, &frameTimer);
-            esp_timer_start_periodic(frameTimer, 33000);
+            esp_timer_start_periodic(frameTimer, FRAME_PERIOD_US);
 
             loggerInstance->Info("UI feature initialized (Win95 desktop)");
 
@@ -400,9 +524,19 @@ static Feature *createuiFeature()
             if (UI::isDirty() && frameReady)
             {
                 frameReady = false;
+                int64_t drawStartUs = esp_timer_get_time();
                 UI::desktop().draw();
+                frameDrawTime.observe(esp_timer_get_time() - drawStartUs);
                 UI::clearDirty();
             }
+
+            // hand the slack before the next frame to deferred work (Berry GC),
+            // but never while a gesture is in progress
+            if (!touched && !(UI::isDirty() && frameReady))
+            {
+                int64_t nextFrameUs = frameTickUs.load(std::memory_order_relaxed) + FRAME_PERIOD_US;
+                UI::runIdleHandler(nextFrameUs - esp_timer_get_time());
+            }
         },
         []()
         {
@@ -1,7 +1,7 @@
 #include "i2c.h"
 #include "../../ActionRegistry/ActionRegistry.h"
 #include "../../ActionRegistry/FeatureAction.h"
-#include "../../CommandInterpreter/CommandParser.h"
+#include "../../CommandInterpreter/CommandArgs.h"
 
 // CYD: GPIO 21 is display backlight; use GPIO 27 (SDA) and 22 (SCL) to avoid conflict
 #define I2C_SDA_PIN 27
@@ -12,24 +12,23 @@ i2c_master_bus_handle_t i2cBusHandle = nullptr;
 static FeatureAction i2cAction = {
     .name = "i2c",
     .handler =
-        [](const std::string &command)
+        [](const CommandArgs &args)
     {
-        std::string sub = CommandParser::getCommandParameter(command, 1);
+        std::string sub = args.str(1);
         if (sub == "scan")
         {
             return scanDevices();
         }
         else if (sub == "read")
         {
-            uint16_t address = atoi(CommandParser::getCommandParameter(command, 2).c_str());
-            uint16_t size = atoi(CommandParser::getCommandParameter(command, 3).c_str());
+            uint16_t address = args.toInt(2);
+            uint16_t size = args.toInt(3);
             return readDevice(address, size);
         }
         else if (sub == "write")
         {
-            uint16_t address = strtol(CommandParser::getCommandParameter(command, 2).c_str(), 0, 16);
-            std::string prefix = std::string("i2c write ") + CommandParser::getCommandParameter(command, 2) + " ";
-            std::string data = command.substr(prefix.length());
+            uint16_t address = args.toHex(2);
+            std::string data(args.rest(3));
             writeDevice(address, data);
             return std::string("Written.");
         }
@@ -37,7 +36,8 @@ static FeatureAction i2cAction = {
         std::string fallback = "The available I2C Commands are: scan, read, write";
         return fallback;
     },
-    .transports = {.cli = true, .rest = true, .ws = true, .scripting = true}};
+    .transports = {.cli = true, .rest = true, .ws = true, .scripting = true},
+    .async = true};
 
 Feature *i2cFeature = new Feature(
     "i2c",
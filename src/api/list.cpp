@@ -2,31 +2,43 @@
 #include "../fs/VirtualFS.h"
 #include "../mime.h"
 #include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+#include <vector>
 
 #include <dirent.h>
 #include <sys/stat.h>
 #include <cstring>
 
-cJSON *getFileList()
+struct FileListEntry
 {
-    return getFileList(resolveToLittleFsPath("/"));
-}
+    const char *name;
+    const std::string &path;
+    size_t size;
+    bool isDir;
+    time_t lastWrite;
+};
 
-cJSON *getFileList(const char *path)
+// withStat = false skips stat() whenever readdir already reports the type;
+// size and lastWrite are then left at 0. The first skip entries are passed over
+// without a stat() and without calling fn.
+template <typename Fn>
+static void forEachFileListEntry(const std::string &realPath, bool withStat, Fn fn, size_t skip = 0)
 {
-    return getFileList(resolveToLittleFsPath(path));
-}
-
-cJSON *getFileList(const std::string &realPath)
-{
-    cJSON *fileList = cJSON_CreateArray();
-
     DIR *dir = opendir(realPath.c_str());
     if (!dir)
     {
-        return fileList;
+        return;
     }
 
+    std::string entryPath = realPath;
+    if (entryPath.back() != '/')
+    {
+        entryPath += '/';
+    }
+    size_t baseLen = entryPath.length();
+
     struct dirent *entry;
     while ((entry = readdir(dir)) != nullptr)
     {
@@ -34,12 +46,13 @@ cJSON *getFileList(const std::string &realPath)
         {
             continue;
         }
-
-        std::string entryPath = realPath;
-        if (entryPath.back() != '/')
+        if (skip > 0)
         {
-            entryPath += '/';
+            skip--;
+            continue;
         }
+
+        entryPath.resize(baseLen);
         entryPath += entry->d_name;
 
         struct stat st;
@@ -47,22 +60,220 @@ cJSON *getFileList(const std::string &realPath)
         size_t fileSize = 0;
         time_t lastWrite = 0;
 
-        if (stat(entryPath.c_str(), &st) == 0)
+        if ((withStat || entry->d_type == DT_UNKNOWN) && stat(entryPath.c_str(), &st) == 0)
         {
             isDir = S_ISDIR(st.st_mode);
             fileSize = st.st_size;
             lastWrite = st.st_mtime;
         }
 
-        cJSON *o = cJSON_CreateObject();
-        cJSON_AddStringToObject(o, "name", entry->d_name);
-        cJSON_AddNumberToObject(o, "size", fileSize);
-        cJSON_AddBoolToObject(o, "isDir", isDir);
-        cJSON_AddStringToObject(o, "path", entryPath.c_str());
-        cJSON_AddNumberToObject(o, "lastWrite", (double)lastWrite);
-        cJSON_AddItemToArray(fileList, o);
+        if (!fn(FileListEntry{entry->d_name, entryPath, fileSize, isDir, lastWrite}))
+        {
+            break;
+        }
     }
 
     closedir(dir);
+}
+
+cJSON *getFileList()
+{
+    return getFileList(resolveToLittleFsPath("/"));
+}
+
+cJSON *getFileList(const char *path)
+{
+    return getFileList(resolveToLittleFsPath(path));
+}
+
+cJSON *getFileList(const std::string &realPath)
+{
+    cJSON *fileList = cJSON_CreateArray();
+
+    forEachFileListEntry(realPath, true,
+                         [fileList](const FileListEntry &e)
+                         {
+                             cJSON *o = cJSON_CreateObject();
+                             cJSON_AddStringToObject(o, "name", e.name);
+                             cJSON_AddNumberToObject(o, "size", e.size);
+                             cJSON_AddBoolToObject(o, "isDir", e.isDir);
+                             cJSON_AddStringToObject(o, "path", e.path.c_str());
+                             cJSON_AddNumberToObject(o, "lastWrite", (double)e.lastWrite);
+                             cJSON_AddItemToArray(fileList, o);
+                             return true;
+                         });
+
     return fileList;
 }
+
+static void writeEntry(JsonWriter &out, const char *name, const std::string &path, bool isDir, bool withStat,
+                       size_t size, time_t lastWrite)
+{
+    out.beginObject().field("name", name);
+    if (withStat)
+    {
+        out.field("size", size);
+    }
+    out.field("isDir", isDir).field("path", path);
+    if (withStat)
+    {
+        out.field("lastWrite", (long long)lastWrite);
+    }
+    out.endObject();
+}
+
+void writeFileList(JsonWriter &out, const std::string &realPath)
+{
+    out.beginArray();
+    forEachFileListEntry(realPath, true,
+                         [&out](const FileListEntry &e)
+                         {
+                             writeEntry(out, e.name, e.path, e.isDir, true, e.size, e.lastWrite);
+                             return true;
+                         });
+    out.endArray();
+}
+
+bool FileListQuery::set(const std::string &key, const std::string &value)
+{
+    char *end = nullptr;
+    if (key == "offset" || key == "cursor" || key == "limit")
+    {
+        unsigned long n = strtoul(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0')
+            return false;
+        (key == "limit" ? limit : offset) = n;
+    }
+    else if (key == "sort")
+    {
+        std::string k = value;
+        descending = !k.empty() && k[0] == '-';
+        if (descending)
+            k.erase(0, 1);
+        if (k == "name")
+            sortKey = 'n';
+        else if (k == "size")
+            sortKey = 's';
+        else if (k == "mtime" || k == "lastWrite")
+            sortKey = 'm';
+        else
+            return false;
+    }
+    else if (key == "stat")
+    {
+        withStat = !(value == "0" || value == "false");
+    }
+    else
+    {
+        return false;
+    }
+    paged = true;
+    return true;
+}
+
+struct SortedFileEntry
+{
+    std::string name;
+    bool isDir;
+    size_t size;
+    time_t lastWrite;
+};
+
+void writeFileListPage(JsonWriter &out, const std::string &realPath, const FileListQuery &query)
+{
+    // sorting by size or date needs the stat data even if the caller does not want it back
+    bool needStat = query.withStat || query.sortKey == 's' || query.sortKey == 'm';
+    std::string base = realPath;
+    if (base.back() != '/')
+    {
+        base += '/';
+    }
+
+    out.beginObject().key("entries").beginArray();
+
+    size_t end = query.limit == 0 ? SIZE_MAX : query.offset + query.limit;
+    bool hasMore = false;
+
+    if (query.sortKey == 0)
+    {
+        // entries before the offset are only counted, so page N costs no stat() calls for pages 0..N-1
+        size_t index = query.offset;
+        forEachFileListEntry(
+            realPath, needStat,
+            [&](const FileListEntry &e)
+            {
+                if (index++ >= end)
+                {
+                    hasMore = true;
+                    return false;
+                }
+                writeEntry(out, e.name, e.path, e.isDir, query.withStat, e.size, e.lastWrite);
+                return true;
+            },
+            query.offset);
+        out.endArray().field("offset", query.offset);
+    }
+    else
+    {
+        // "a comes before b" in the requested order, name as tie breaker
+        auto before = [&query](const SortedFileEntry &a, const SortedFileEntry &b)
+        {
+            int cmp = 0;
+            if (query.sortKey == 's')
+                cmp = a.size < b.size ? -1 : (a.size > b.size ? 1 : 0);
+            else if (query.sortKey == 'm')
+                cmp = a.lastWrite < b.lastWrite ? -1 : (a.lastWrite > b.lastWrite ? 1 : 0);
+            if (cmp == 0)
+                cmp = a.name.compare(b.name);
+            return query.descending ? cmp > 0 : cmp < 0;
+        };
+
+        // max-heap on the sort order: the top is the worst entry that still makes the page
+        std::priority_queue<SortedFileEntry, std::vector<SortedFileEntry>, decltype(before)> best(before);
+        size_t total = 0;
+        forEachFileListEntry(realPath, needStat,
+                             [&](const FileListEntry &e)
+                             {
+                                 total++;
+                                 SortedFileEntry entry{e.name, e.isDir, e.size, e.lastWrite};
+                                 if (best.size() < end)
+                                 {
+                                     best.push(std::move(entry));
+                                 }
+                                 else if (before(entry, best.top()))
+                                 {
+                                     best.pop();
+                                     best.push(std::move(entry));
+                                 }
+                                 return true;
+                             });
+
+        std::vector<SortedFileEntry> page;
+        page.reserve(best.size());
+        while (!best.empty())
+        {
+            page.push_back(std::move(const_cast<SortedFileEntry &>(best.top())));
+            best.pop();
+        }
+        std::reverse(page.begin(), page.end());
+
+        for (size_t i = query.offset; i < page.size(); i++)
+        {
+            const SortedFileEntry &e = page[i];
+            writeEntry(out, e.name.c_str(), base + e.name, e.isDir, query.withStat, e.size, e.lastWrite);
+        }
+        hasMore = end < total;
+        out.endArray().field("offset", query.offset).field("total", total);
+    }
+
+    out.key("next");
+    if (hasMore)
+    {
+        out.value(end);
+    }
+    else
+    {
+        out.null();
+    }
+    out.endObject();
+}
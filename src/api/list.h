@@ -3,7 +3,31 @@
 #include "../config.h"
 #include <string>
 #include "cJSON.h"
+#include "../utils/JsonWriter.h"
 
 cJSON *getFileList();
 cJSON *getFileList(const char *path);
 cJSON *getFileList(const std::string &realPath);
+
+// Same entries as getFileList(realPath), streamed as a JSON array
+void writeFileList(JsonWriter &out, const std::string &realPath);
+
+// Paging/sorting options for large directories (e.g. SD card data folders)
+struct FileListQuery
+{
+    size_t offset = 0;
+    size_t limit = 0;       // 0 = everything after offset
+    char sortKey = 0;       // 0 = directory order, 'n' = name, 's' = size, 'm' = mtime
+    bool descending = false;
+    bool withStat = true;   // size and lastWrite need one stat() per entry
+    bool paged = false;     // any option was given: answer with the page object
+
+    // Apply one option: offset|cursor, limit, sort ([-]name|size|mtime), stat (0/1).
+    // Returns false for unknown keys or bad values.
+    bool set(const std::string &key, const std::string &value);
+};
+
+// {"entries":[...], "offset":n, "next":<cursor>|null[, "total":n]}
+// Unsorted pages are streamed in directory order without holding the listing;
+// sorted pages keep only the best offset + limit entries while scanning.
+void writeFileListPage(JsonWriter &out, const std::string &realPath, const FileListQuery &query);
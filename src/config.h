@@ -2,11 +2,98 @@
 
 #define WEBSOCKETS_URL "/ws"
 
+/**
+ * Per-client WebSocket send queue. Log messages beyond these limits are dropped
+ * oldest first; a client whose oldest queued message is older than
+ * WS_CLIENT_MAX_LAG_MS is disconnected. A client whose socket is full is
+ * skipped and retried after WS_BUSY_RETRY_MS instead of blocking the others.
+ */
+#define WS_QUEUE_MAX_MESSAGES 64
+#define WS_QUEUE_MAX_BYTES 16384
+#define WS_CLIENT_MAX_LAG_MS 10000
+#define WS_BUSY_RETRY_MS 20
+
+/**
+ * Screen mirroring WebSocket (binary strip updates, see UI/ScreenMirror.h).
+ * Frame rate can be changed at runtime with `mirror fps <n>`.
+ */
+#define SCREEN_MIRROR_URL "/screen"
+#define SCREEN_MIRROR_DEFAULT_FPS 10
+#define SCREEN_MIRROR_QUEUE_BYTES 65536
+
 #define STA_SSID "sticky"
 #define STA_PASSPHRASE "sticky1234"
 
 #define JSON_BUFFER_SIZE 2048
 
+/**
+ * Log levels. LOG_* macro calls below LOG_COMPILE_LEVEL are compiled out;
+ * LOG_DEFAULT_LEVEL is the runtime threshold at boot (`log level <name>`).
+ */
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_ERROR 2
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO
+
+/**
+ * Log history kept in RAM for the `log` action: a preallocated ring of
+ * LOG_RING_CAPACITY records, each holding up to LOG_MESSAGE_MAX - 1 bytes of
+ * message text. Longer messages are truncated in the history and for the
+ * listeners (WebSocket clients, log store); the console gets the full text.
+ */
+#define LOG_RING_CAPACITY 100
+#define LOG_MESSAGE_MAX 120
+
+/**
+ * Log listeners (e.g. the WebSocket broadcast) run on a low priority task that
+ * hands them up to LOG_DISPATCH_BATCH records per call. After a wake-up it
+ * waits LOG_DISPATCH_DELAY_MS so bursts end up in one batch.
+ */
+#define LOG_DISPATCH_BATCH 16
+#define LOG_DISPATCH_DELAY_MS 20
+#define LOG_DISPATCH_STACK 4096
+
+/**
+ * Persistent log segments (see FeatureRegistry/Features/LogStore.h). Records
+ * are collected in LOG_STORE_BLOCK_SIZE blocks and appended when a block is
+ * full or LOG_STORE_FLUSH_MS after the last write. A block holds a whole
+ * dispatch batch of full-length records, so a burst is not dropped while the
+ * writer is still busy with the previous block. Flash gets a much smaller
+ * segment size than the SD card.
+ */
+#define LOG_STORE_DIR "/logs"
+#define LOG_STORE_SEGMENTS 8
+#define LOG_STORE_SD_SEGMENT_BYTES (256 * 1024)
+#define LOG_STORE_FLASH_SEGMENT_BYTES (8 * 1024)
+#define LOG_STORE_BLOCK_SIZE 2048
+#define LOG_STORE_FLUSH_MS 5000
+
+/**
+ * Worker tasks for actions marked async (slow scans, SD listings), so they do
+ * not hold up the HTTP server task. Jobs beyond the queue size are refused.
+ */
+#define HTTP_WORKER_COUNT 2
+#define HTTP_WORKER_QUEUE 8
+#define HTTP_WORKER_STACK 6144
+
+/**
+ * Most commands accepted in one batch (a JSON array or several lines sent as
+ * one WS message or serial read), answered together in one response.
+ */
+#define COMMAND_BATCH_MAX 32
+
+/**
+ * Largest REST request body (bytes) read into an action's arguments. Actions
+ * with a bodyHandler stream their body instead and have no limit.
+ */
+#define REST_BODY_MAX 4096
+
+/**
+ * Read buffer (bytes) used when streaming static files from LittleFS
+ */
+#define STATIC_FILE_BUFFER_SIZE 4096
+
 // --- Network ---
 
 /**
@@ -43,6 +130,11 @@
  */
 #define ENABLE_SD_CARD true
 
+/**
+ * Keep the log in rotating segment files on the SD card (or flash)
+ */
+#define ENABLE_LOG_STORE true
+
 /**
  * Enable to read input from a serial console
  */
@@ -77,6 +169,10 @@
 #error "ENABLE_UI requires ENABLE_SCREEN"
 #endif
 
+#if ENABLE_LOG_STORE && !ENABLE_LITTLEFS && !ENABLE_SD_CARD
+#error "ENABLE_LOG_STORE requires ENABLE_LITTLEFS or ENABLE_SD_CARD"
+#endif
+
 #if ENABLE_BERRY && !ENABLE_LITTLEFS
 #error "ENABLE_BERRY requires ENABLE_LITTLEFS"
 #endif
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "../utils/Metrics.h"
+
+// Bytes moved through files on flash and SD by the file helpers, uploads,
+// downloads, static files and the log store
+inline Counter fsReadBytes("fs_read_bytes_total", "Bytes read from files");
+inline Counter fsWrittenBytes("fs_written_bytes_total", "Bytes written to files");
@@ -3,6 +3,7 @@
 #include "../config.h"
 #include "../utils/StringUtil.h"
 #include "LittleFsInit.h"
+#include "FsMetrics.h"
 #include <string>
 
 #include <cstdio>
@@ -114,6 +115,7 @@ inline std::string vfsReadFileAsString(const std::string &path)
     }
     std::string content(size, '\0');
     size_t bytesRead = fread(&content[0], 1, size, f);
+    fsReadBytes.inc(bytesRead);
     content.resize(bytesRead);
     fclose(f);
     return content;
@@ -135,3 +137,14 @@ inline bool vfsMkdirs(const std::string &filePath)
     }
     return true;
 }
+
+// Staging buffer for BufferedFileWriter: one LittleFS block (flash erase
+// sector), several FAT sectors on SD so FatFs can write straight to the card
+// without its window
+#define VFS_WRITE_BUFFER_LITTLEFS 4096
+#define VFS_WRITE_BUFFER_SD 8192
+
+inline size_t vfsWriteBufferSize(const std::string &realPath)
+{
+    return StringUtil::startsWith(realPath, LITTLEFS_MOUNT_POINT) ? VFS_WRITE_BUFFER_LITTLEFS : VFS_WRITE_BUFFER_SD;
+}
@@ -18,6 +18,7 @@
 #endif
 
 #include "./FeatureRegistry/FeatureRegistry.h"
+#include "./utils/System.h"
 
 static const char *TAG = "main";
 
@@ -51,5 +52,7 @@ extern "C" void app_main(void)
     featureRegistryInstance->setupFeatures();
     featureRegistryInstance->startFeatureTasks();
 
-    xTaskCreate(loopTask, "main_loop", 4096, NULL, 1, NULL);
+    TaskHandle_t loop = nullptr;
+    xTaskCreate(loopTask, "main_loop", 4096, NULL, 1, &loop);
+    watchTaskStack(loop);
 }
@@ -3,4 +3,7 @@
 #define MIME_PLAIN_TEXT "text/plain"
 #define MIME_HTML "text/html"
 #define MIME_JPEG "image/jpeg"
-#define MIME_JSON "application/json"
\ No newline at end of file
+#define MIME_JSON "application/json"
+#define MIME_CBOR "application/cbor"
+#define MIME_FORM "application/x-www-form-urlencoded"
+#define MIME_PROMETHEUS "text/plain; version=0.0.4; charset=utf-8"
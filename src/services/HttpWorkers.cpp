@@ -0,0 +1,168 @@
+#include "HttpWorkers.h"
+
+#if ENABLE_WEBSERVER
+
+#include "../mime.h"
+#include "../ActionRegistry/ActionRegistry.h"
+#include "../FeatureRegistry/Features/Logging.h"
+#include "../utils/System.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <atomic>
+#include <mutex>
+
+struct HttpJob
+{
+    std::function<void()> run;
+    int64_t queuedUs;
+};
+
+struct LatencyStats
+{
+    uint32_t count = 0;
+    int64_t totalUs = 0;
+    int64_t maxUs = 0;
+};
+
+static QueueHandle_t s_jobQueue = nullptr;
+static std::atomic<uint32_t> s_busy{0};
+static std::atomic<uint32_t> s_completed{0};
+static std::atomic<uint32_t> s_rejected{0};
+
+static std::mutex s_statsMutex;
+static LatencyStats s_latency[3];
+
+void httpRecordLatency(HttpLatency kind, int64_t us)
+{
+    std::lock_guard<std::mutex> lock(s_statsMutex);
+    LatencyStats &s = s_latency[(int)kind];
+    s.count++;
+    s.totalUs += us;
+    if (us > s.maxUs)
+        s.maxUs = us;
+}
+
+static void httpWorkerTask(void *)
+{
+    while (true)
+    {
+        HttpJob *job = nullptr;
+        if (xQueueReceive(s_jobQueue, &job, portMAX_DELAY) != pdTRUE || !job)
+            continue;
+
+        httpRecordLatency(HttpLatency::ASYNC_WAIT, esp_timer_get_time() - job->queuedUs);
+        s_busy++;
+        job->run();
+        s_busy--;
+        s_completed++;
+        delete job;
+    }
+}
+
+bool httpWorkersSubmit(std::function<void()> job)
+{
+    if (!s_jobQueue)
+    {
+        job(); // no pool: behave like before and run inline
+        return true;
+    }
+
+    HttpJob *item = new HttpJob{std::move(job), esp_timer_get_time()};
+    if (xQueueSend(s_jobQueue, &item, 0) != pdTRUE)
+    {
+        delete item;
+        s_rejected++;
+        return false;
+    }
+    return true;
+}
+
+esp_err_t httpdRunAsync(httpd_req_t *req, esp_err_t (*handler)(httpd_req_t *req))
+{
+    httpd_req_t *copy = nullptr;
+    if (!s_jobQueue || httpd_req_async_handler_begin(req, &copy) != ESP_OK)
+    {
+        return handler(req);
+    }
+
+    bool queued = httpWorkersSubmit(
+        [copy, handler]()
+        {
+            handler(copy);
+            httpd_req_async_handler_complete(copy);
+        });
+    if (!queued)
+    {
+        httpd_resp_set_status(copy, "503 Service Unavailable");
+        httpd_resp_set_type(copy, MIME_JSON);
+        httpd_resp_sendstr(copy, "{\"error\": \"Server busy, try again\"}");
+        httpd_req_async_handler_complete(copy);
+    }
+    return ESP_OK;
+}
+
+static void streamHttpStats(const CommandArgs & /*args*/, JsonWriter &out)
+{
+    LatencyStats latency[3];
+    {
+        std::lock_guard<std::mutex> lock(s_statsMutex);
+        for (int i = 0; i < 3; i++)
+            latency[i] = s_latency[i];
+    }
+
+    out.beginObject()
+        .key("workers")
+        .beginObject()
+        .field("count", HTTP_WORKER_COUNT)
+        .field("busy", s_busy.load())
+        .field("queued", s_jobQueue ? uxQueueMessagesWaiting(s_jobQueue) : 0)
+        .field("completed", s_completed.load())
+        .field("rejected", s_rejected.load())
+        .endObject();
+
+    static const char *const names[] = {"static", "wsFrame", "asyncWait"};
+    out.key("latencyUs").beginObject();
+    for (int i = 0; i < 3; i++)
+    {
+        out.key(names[i])
+            .beginObject()
+            .field("count", latency[i].count)
+            .field("avg", latency[i].count ? latency[i].totalUs / latency[i].count : 0)
+            .field("max", latency[i].maxUs)
+            .endObject();
+    }
+    out.endObject().endObject();
+}
+
+static FeatureAction httpAction = {.name = "http",
+                                   .handler =
+                                       [](const CommandArgs &args)
+                                   {
+                                       return JsonWriter::toString([&args](JsonWriter &out)
+                                                                   { streamHttpStats(args, out); });
+                                   },
+                                   .streamHandler = streamHttpStats,
+                                   .transports = {.cli = true, .rest = true, .ws = true, .scripting = true}};
+
+void initHttpWorkers()
+{
+    s_jobQueue = xQueueCreate(HTTP_WORKER_QUEUE, sizeof(HttpJob *));
+    if (!s_jobQueue)
+    {
+        loggerInstance->Error("HTTP workers: queue allocation failed, slow actions run inline");
+        return;
+    }
+    for (int i = 0; i < HTTP_WORKER_COUNT; i++)
+    {
+        std::string name = "http_worker" + std::to_string(i);
+        // below the server task (priority 5), which stays responsive while actions run
+        TaskHandle_t task = nullptr;
+        xTaskCreate(httpWorkerTask, name.c_str(), HTTP_WORKER_STACK, nullptr, 4, &task);
+        watchTaskStack(task);
+    }
+    actionRegistryInstance->registerAction(&httpAction);
+}
+
+#endif // ENABLE_WEBSERVER
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../config.h"
+
+#if ENABLE_WEBSERVER
+
+#include <cstdint>
+#include <functional>
+#include <esp_http_server.h>
+#include <esp_timer.h>
+
+// Worker tasks for actions that block (FeatureAction.async), so the single
+// esp_http_server task keeps serving files and WebSocket frames meanwhile.
+void initHttpWorkers();
+
+// Queue a job on the pool. Returns false if the backlog is full.
+bool httpWorkersSubmit(std::function<void()> job);
+
+// Detach req from the server task and finish it on a worker with handler.
+// Answers 503 when the pool is saturated.
+esp_err_t httpdRunAsync(httpd_req_t *req, esp_err_t (*handler)(httpd_req_t *req));
+
+enum class HttpLatency : uint8_t
+{
+    STATIC,    // static file requests
+    WS_FRAME,  // inline WebSocket frame handling
+    ASYNC_WAIT // time a job waited for a worker
+};
+
+void httpRecordLatency(HttpLatency kind, int64_t us);
+
+// Records the lifetime of the scope as one sample
+class HttpLatencyScope
+{
+public:
+    explicit HttpLatencyScope(HttpLatency kind) : _kind(kind), _start(esp_timer_get_time())
+    {
+    }
+
+    ~HttpLatencyScope()
+    {
+        httpRecordLatency(_kind, esp_timer_get_time() - _start);
+    }
+
+private:
+    HttpLatency _kind;
+    int64_t _start;
+};
+
+#endif
@@ -6,9 +6,12 @@
 #include "../mime.h"
 #include "../utils/System.h"
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <esp_http_server.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <sys/stat.h>
 #include <cstdio>
 #include <unistd.h>
@@ -16,9 +19,18 @@
 #include "../fs/LittleFsInit.h"
 #include "../utils/StringUtil.h"
 #include "../utils/MultipartParser.h"
+#include "../utils/BufferedFileWriter.h"
 #include "../utils/CJsonHelper.h"
+#include "../utils/Metrics.h"
 #include "../api/list.h"
 #include "WebSocketServer.h"
+#include "HttpWorkers.h"
+#if ENABLE_BERRY
+#include "../FeatureRegistry/Features/Berry/BerryAppIndex.h"
+#endif
+#if ENABLE_UI
+#include "../FeatureRegistry/Features/UI/ScreenMirror.h"
+#endif
 
 static const char *TAG = "WebServer";
 static httpd_handle_t s_server = nullptr;
@@ -77,11 +89,24 @@ static esp_err_t heapGetHandler(httpd_req_t *req)
     return httpd_resp_send(req, heap.c_str(), HTTPD_RESP_USE_STRLEN);
 }
 
+// --- /metrics endpoint ---
+
+// Every registered metric in the Prometheus text format, sent in chunks
+static esp_err_t metricsGetHandler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, MIME_PROMETHEUS);
+    MetricsWriter out([req](const char *data, size_t len) { return httpd_resp_send_chunk(req, data, len) == ESP_OK; });
+    if (!Metric::writeAll(out))
+        return ESP_FAIL;
+    return httpd_resp_send_chunk(req, nullptr, 0);
+}
+
 // --- /listFiles endpoint ---
 
-static esp_err_t listFilesHandler(httpd_req_t *req)
+static esp_err_t sendFileList(httpd_req_t *req)
 {
-    cJSON *response = nullptr;
+    std::string realPath = resolveToLittleFsPath("/");
+    FileListQuery query;
 
     char queryBuf[256] = {};
     if (httpd_req_get_url_query_str(req, queryBuf, sizeof(queryBuf)) == ESP_OK)
@@ -91,29 +116,37 @@ static esp_err_t listFilesHandler(httpd_req_t *req)
         {
             std::string path(pathVal);
             ResolvedPath resolved = resolveVirtualPath(path);
-            if (resolved.valid)
-            {
-                response = getFileList(resolved.realPath);
-            }
-            else
-            {
-                response = getFileList(resolveToLittleFsPath(path));
-            }
+            realPath = resolved.valid ? resolved.realPath : resolveToLittleFsPath(path);
         }
-        else
+
+        // ?offset=&limit=&sort=[-]name|size|mtime&stat=0, cursor= takes the "next" of the previous page
+        static const char *const options[] = {"offset", "cursor", "limit", "sort", "stat"};
+        for (const char *option : options)
         {
-            response = getFileList();
+            char val[16] = {};
+            if (httpd_query_key_value(queryBuf, option, val, sizeof(val)) == ESP_OK &&
+                !query.set(option, val))
+            {
+                httpd_resp_set_status(req, "400 Bad Request");
+                httpd_resp_set_type(req, MIME_JSON);
+                return httpd_resp_sendstr(req, "{\"error\": \"Invalid list option\"}");
+            }
         }
     }
-    else
-    {
-        response = getFileList();
-    }
 
-    std::string responseStr = cJsonToString(response);
-    cJSON_Delete(response);
     httpd_resp_set_type(req, MIME_JSON);
-    return httpd_resp_send(req, responseStr.c_str(), HTTPD_RESP_USE_STRLEN);
+    JsonWriter out(httpdChunkSink(req), JSON_BUFFER_SIZE);
+    if (query.paged)
+        writeFileListPage(out, realPath, query);
+    else
+        writeFileList(out, realPath);
+    return out.finish() ? ESP_OK : ESP_FAIL;
+}
+
+// Large SD directories take a while; list them on a worker
+static esp_err_t listFilesHandler(httpd_req_t *req)
+{
+    return httpdRunAsync(req, sendFileList);
 }
 
 // --- /uploadFiles endpoint ---
@@ -147,6 +180,10 @@ static esp_err_t uploadFilesHandler(httpd_req_t *req)
     std::string targetPath;
     std::string basePath;
     std::string errorMsg;
+    BufferedFileWriter writer;
+    int64_t startUs = 0;
+    size_t uploadedBytes = 0;
+    int64_t uploadUs = 0;
 
     esp_err_t ret = parseMultipartRequest(
         req,
@@ -189,22 +226,40 @@ static esp_err_t uploadFilesHandler(httpd_req_t *req)
 
                 // Store resolved path for subsequent chunks
                 targetPath = resolved.realPath;
+
+                if (!writer.open(targetPath, vfsWriteBufferSize(targetPath)))
+                {
+                    errorMsg = "{\"error\":\"Failed to open file for writing\"}";
+                    return false;
+                }
+                startUs = esp_timer_get_time();
             }
 
-            const char *mode = isFirst ? "w" : "a";
-            FILE *f = fopen(targetPath.c_str(), mode);
-            if (!f)
+            if (data && len > 0 && !writer.write(data, len))
             {
-                errorMsg = "{\"error\":\"Failed to open file for writing\"}";
+                errorMsg = "{\"error\":\"Failed to write file\"}";
                 return false;
             }
-            if (data && len > 0)
-                fwrite(data, 1, len, f);
-            fclose(f);
 
             if (isFinal)
             {
-                loggerInstance->Info(std::string("Upload finished: ") + targetPath);
+                size_t bytes = writer.bytesWritten();
+                if (!writer.close())
+                {
+                    errorMsg = "{\"error\":\"Failed to write file\"}";
+                    return false;
+                }
+                int64_t elapsedUs = esp_timer_get_time() - startUs;
+                uploadedBytes += bytes;
+                uploadUs += elapsedUs;
+
+                char rate[16];
+                snprintf(rate, sizeof(rate), "%.2f", elapsedUs > 0 ? (double)bytes / elapsedUs : 0.0);
+                loggerInstance->Info(std::string("Upload finished: ") + targetPath + " (" + std::to_string(bytes) +
+                                     " bytes, " + rate + " MB/s)");
+#if ENABLE_BERRY
+                notifyBerryAppsChanged(targetPath);
+#endif
             }
             return true;
         });
@@ -223,14 +278,77 @@ static esp_err_t uploadFilesHandler(httpd_req_t *req)
         return httpd_resp_send(req, "{\"error\":\"Upload failed\"}", HTTPD_RESP_USE_STRLEN);
     }
 
+    char resp[96];
+    snprintf(resp, sizeof(resp), "{\"status\":\"ok\",\"bytes\":%u,\"ms\":%lld,\"mbps\":%.2f}",
+             (unsigned)uploadedBytes, (long long)(uploadUs / 1000),
+             uploadUs > 0 ? (double)uploadedBytes / uploadUs : 0.0);
     httpd_resp_set_type(req, MIME_JSON);
-    return httpd_resp_send(req, "{\"status\":\"ok\"}", HTTPD_RESP_USE_STRLEN);
+    return httpd_resp_send(req, resp, HTTPD_RESP_USE_STRLEN);
 }
 
 // --- Static file serving via 404 error handler ---
 
+struct StaticEtag
+{
+    time_t mtime;
+    off_t size;
+    std::string etag;
+};
+
+// ETags of served files keyed by real path; only touched from the httpd task
+static std::unordered_map<std::string, StaticEtag> s_etagCache;
+#define STATIC_ETAG_CACHE_MAX 64
+
+static const std::string &getEtag(const std::string &filepath, const struct stat &st)
+{
+    auto it = s_etagCache.find(filepath);
+    if (it != s_etagCache.end() && it->second.mtime == st.st_mtime && it->second.size == st.st_size)
+    {
+        return it->second.etag;
+    }
+
+    if (it == s_etagCache.end() && s_etagCache.size() >= STATIC_ETAG_CACHE_MAX)
+    {
+        s_etagCache.clear();
+    }
+
+    char etag[40];
+    snprintf(etag, sizeof(etag), "\"%lx-%llx\"", (unsigned long)st.st_mtime, (unsigned long long)st.st_size);
+    StaticEtag &entry = s_etagCache[filepath];
+    entry = {st.st_mtime, st.st_size, etag};
+    return entry.etag;
+}
+
+std::string getRequestHeader(httpd_req_t *req, const char *name)
+{
+    size_t len = httpd_req_get_hdr_value_len(req, name);
+    if (len == 0)
+        return "";
+    std::string value(len + 1, '\0');
+    if (httpd_req_get_hdr_value_str(req, name, &value[0], value.size()) != ESP_OK)
+        return "";
+    value.resize(len);
+    return value;
+}
+
+WireFormat acceptedWireFormat(httpd_req_t *req)
+{
+    return getRequestHeader(req, "Accept").find(MIME_CBOR) != std::string::npos ? WireFormat::CBOR : WireFormat::JSON;
+}
+
+static bool etagMatches(const std::string &ifNoneMatch, const std::string &etag)
+{
+    if (ifNoneMatch.empty())
+        return false;
+    if (StringUtil::trim(ifNoneMatch) == "*")
+        return true;
+    return ifNoneMatch.find(etag) != std::string::npos;
+}
+
 static esp_err_t staticFileHandler(httpd_req_t *req, httpd_err_code_t err)
 {
+    HttpLatencyScope latency(HttpLatency::STATIC);
+
     std::string uri(req->uri);
 
     // Strip query string
@@ -243,15 +361,37 @@ static esp_err_t staticFileHandler(httpd_req_t *req, httpd_err_code_t err)
 
     std::string filepath = std::string(LITTLEFS_MOUNT_POINT) + uri;
 
+    // prefer a pre-compressed sibling (see gzip_data.py) when the client accepts it
     struct stat st;
-    if (stat(filepath.c_str(), &st) != 0)
+    std::string gzPath = filepath + ".gz";
+    bool hasGz = stat(gzPath.c_str(), &st) == 0;
+    bool useGz = hasGz && getRequestHeader(req, "Accept-Encoding").find("gzip") != std::string::npos;
+    if (useGz)
+    {
+        filepath = gzPath;
+    }
+    else if (stat(filepath.c_str(), &st) != 0)
     {
         httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
         return ESP_OK;
     }
 
+    const std::string &etag = getEtag(filepath, st);
+
     httpd_resp_set_type(req, getMimeType(uri));
     httpd_resp_set_hdr(req, "Cache-Control", "max-age=600");
+    httpd_resp_set_hdr(req, "ETag", etag.c_str());
+    if (hasGz)
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+
+    if (etagMatches(getRequestHeader(req, "If-None-Match"), etag))
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, nullptr, 0);
+    }
+
+    if (useGz)
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
 
     FILE *f = fopen(filepath.c_str(), "r");
     if (!f)
@@ -260,14 +400,15 @@ static esp_err_t staticFileHandler(httpd_req_t *req, httpd_err_code_t err)
         return ESP_OK;
     }
 
-    char buf[1024];
+    std::vector<char> buf(STATIC_FILE_BUFFER_SIZE);
     size_t readBytes;
     do
     {
-        readBytes = fread(buf, 1, sizeof(buf), f);
+        readBytes = fread(buf.data(), 1, buf.size(), f);
+        fsReadBytes.inc(readBytes);
         if (readBytes > 0)
         {
-            if (httpd_resp_send_chunk(req, buf, readBytes) != ESP_OK)
+            if (httpd_resp_send_chunk(req, buf.data(), readBytes) != ESP_OK)
             {
                 fclose(f);
                 httpd_resp_send_chunk(req, nullptr, 0);
@@ -281,11 +422,198 @@ static esp_err_t staticFileHandler(httpd_req_t *req, httpd_err_code_t err)
     return ESP_OK;
 }
 
+// --- /download endpoint (GET/HEAD with Range) over /flash and /sd ---
+
+struct ByteRange
+{
+    uint64_t start;
+    uint64_t end; // inclusive
+};
+
+// A byte offset: digits only, no sign, no overflow
+static bool parseOffset(const std::string &text, uint64_t &value)
+{
+    if (text.empty() || text.size() > 19 || text.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+    value = strtoull(text.c_str(), nullptr, 10);
+    return true;
+}
+
+// Parse a single "bytes=a-b", "bytes=a-" or "bytes=-n" range. Returns false for
+// headers that should be ignored (missing, malformed or multiple ranges);
+// sets unsatisfiable when the range lies outside the file.
+static bool parseRange(const std::string &header, uint64_t size, ByteRange &range, bool &unsatisfiable)
+{
+    unsatisfiable = false;
+    if (!StringUtil::startsWith(header, "bytes=") || header.find(',') != std::string::npos)
+        return false;
+
+    std::string spec = StringUtil::trim(header.substr(6));
+    size_t dash = spec.find('-');
+    if (dash == std::string::npos)
+        return false;
+
+    std::string first = spec.substr(0, dash);
+    std::string last = spec.substr(dash + 1);
+    if (first.empty())
+    {
+        uint64_t suffix;
+        if (!parseOffset(last, suffix))
+            return false;
+        if (suffix == 0 || size == 0)
+        {
+            unsatisfiable = true;
+            return true;
+        }
+        range.start = suffix >= size ? 0 : size - suffix;
+        range.end = size - 1;
+        return true;
+    }
+
+    if (!parseOffset(first, range.start))
+        return false;
+    if (last.empty())
+    {
+        range.end = UINT64_MAX;
+    }
+    else if (!parseOffset(last, range.end) || range.end < range.start)
+    {
+        return false;
+    }
+    if (range.start >= size)
+    {
+        unsatisfiable = true;
+        return true;
+    }
+    if (range.end >= size)
+        range.end = size - 1;
+    return true;
+}
+
+static esp_err_t sendAll(httpd_req_t *req, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        int sent = httpd_send(req, data, len);
+        if (sent <= 0)
+            return ESP_FAIL;
+        data += sent;
+        len -= sent;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t downloadHandler(httpd_req_t *req)
+{
+    std::string path;
+    char queryBuf[256] = {};
+    char pathVal[192] = {};
+    if (httpd_req_get_url_query_str(req, queryBuf, sizeof(queryBuf)) == ESP_OK &&
+        httpd_query_key_value(queryBuf, "path", pathVal, sizeof(pathVal)) == ESP_OK)
+    {
+        path = sanitizePath(StringUtil::urlDecode(pathVal));
+    }
+
+    ResolvedPath resolved = resolveVirtualPath(path);
+    if (path.empty() || !resolved.valid)
+    {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Path must start with /flash or /sd");
+        return ESP_OK;
+    }
+
+    struct stat st;
+    if (stat(resolved.realPath.c_str(), &st) != 0 || S_ISDIR(st.st_mode))
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Not found");
+        return ESP_OK;
+    }
+
+    uint64_t size = (uint64_t)st.st_size;
+    const std::string &etag = getEtag(resolved.realPath, st);
+    ByteRange range = {0, size == 0 ? 0 : size - 1};
+    bool partial = false;
+    bool unsatisfiable = false;
+
+    // If-Range: only honour Range when the client still has the same version
+    std::string ifRange = getRequestHeader(req, "If-Range");
+    if (ifRange.empty() || ifRange == etag)
+    {
+        ByteRange requested;
+        partial = parseRange(getRequestHeader(req, "Range"), size, requested, unsatisfiable);
+        if (partial && !unsatisfiable)
+            range = requested; // an ignored header may have left it half parsed
+    }
+
+    // The body is streamed with a known length, so the response is written raw
+    // instead of with httpd_resp_send_chunk (which forces chunked encoding).
+    std::string fileName = path.substr(path.find_last_of('/') + 1);
+    StringUtil::replaceAll(fileName, "\"", "_");
+    std::string head;
+    char line[96];
+    if (unsatisfiable)
+    {
+        snprintf(line, sizeof(line), "Content-Range: bytes */%llu\r\n", (unsigned long long)size);
+        head = std::string("HTTP/1.1 416 Range Not Satisfiable\r\n") + line + "Content-Length: 0\r\n";
+    }
+    else
+    {
+        uint64_t length = size == 0 ? 0 : range.end - range.start + 1;
+        head = partial ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n";
+        head += std::string("Content-Type: ") + getMimeType(path) + "\r\n";
+        snprintf(line, sizeof(line), "Content-Length: %llu\r\n", (unsigned long long)length);
+        head += line;
+        if (partial)
+        {
+            snprintf(line, sizeof(line), "Content-Range: bytes %llu-%llu/%llu\r\n", (unsigned long long)range.start,
+                     (unsigned long long)range.end, (unsigned long long)size);
+            head += line;
+        }
+        head += "Content-Disposition: attachment; filename=\"" + fileName + "\"\r\n";
+    }
+    head += "Accept-Ranges: bytes\r\nETag: " + etag + "\r\n\r\n";
+
+    if (sendAll(req, head.data(), head.size()) != ESP_OK)
+        return ESP_FAIL;
+    if (unsatisfiable || req->method == HTTP_HEAD || size == 0)
+        return ESP_OK;
+
+    FILE *f = fopen(resolved.realPath.c_str(), "rb");
+    if (!f)
+        return ESP_FAIL; // headers are already out; dropping the connection is all that is left
+
+    if (range.start > 0 && fseeko(f, (off_t)range.start, SEEK_SET) != 0)
+    {
+        fclose(f);
+        return ESP_FAIL;
+    }
+
+    std::vector<char> buf(STATIC_FILE_BUFFER_SIZE);
+    uint64_t remaining = range.end - range.start + 1;
+    while (remaining > 0)
+    {
+        size_t want = remaining < buf.size() ? (size_t)remaining : buf.size();
+        size_t readBytes = fread(buf.data(), 1, want, f);
+        fsReadBytes.inc(readBytes);
+        if (readBytes == 0 || sendAll(req, buf.data(), readBytes) != ESP_OK)
+        {
+            fclose(f);
+            return ESP_FAIL;
+        }
+        remaining -= readBytes;
+    }
+
+    fclose(f);
+    return ESP_OK;
+}
+
 // --- Session close callback (delegates to WebSocket cleanup) ---
 
 static void onHttpSessionClose(httpd_handle_t hd, int sockfd)
 {
     wsOnSessionClose(sockfd);
+#if ENABLE_UI
+    UI::mirrorOnSessionClose(sockfd);
+#endif
     close(sockfd);
 }
 
@@ -307,10 +635,18 @@ void initWebServer()
         return;
     }
 
+    initHttpWorkers();
+    watchTaskStack(xTaskGetHandle("httpd"));
+
     // /heap
     const httpd_uri_t heapUri = {.uri = "/heap", .method = HTTP_GET, .handler = heapGetHandler, .user_ctx = nullptr};
     httpd_register_uri_handler(s_server, &heapUri);
 
+    // /metrics
+    const httpd_uri_t metricsUri = {
+        .uri = "/metrics", .method = HTTP_GET, .handler = metricsGetHandler, .user_ctx = nullptr};
+    httpd_register_uri_handler(s_server, &metricsUri);
+
     // /listFiles
     const httpd_uri_t listUri = {
         .uri = "/listFiles", .method = HTTP_GET, .handler = listFilesHandler, .user_ctx = nullptr};
@@ -321,6 +657,14 @@ void initWebServer()
         .uri = "/uploadFiles", .method = HTTP_POST, .handler = uploadFilesHandler, .user_ctx = nullptr};
     httpd_register_uri_handler(s_server, &uploadUri);
 
+    // /download?path=/flash/... or /sd/... (Range, HEAD)
+    const httpd_uri_t downloadUri = {
+        .uri = "/download", .method = HTTP_GET, .handler = downloadHandler, .user_ctx = nullptr};
+    httpd_register_uri_handler(s_server, &downloadUri);
+    const httpd_uri_t downloadHeadUri = {
+        .uri = "/download", .method = HTTP_HEAD, .handler = downloadHandler, .user_ctx = nullptr};
+    httpd_register_uri_handler(s_server, &downloadHeadUri);
+
     // 404 handler → static file serving from LittleFS
     httpd_register_err_handler(s_server, HTTPD_404_NOT_FOUND, staticFileHandler);
 
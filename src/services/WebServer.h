@@ -5,10 +5,29 @@
 #if ENABLE_WEBSERVER
 
 #include <esp_http_server.h>
+#include "../utils/JsonWriter.h"
+#include <string>
 
 httpd_handle_t getHttpServer();
 void stopWebServer();
 
+// Value of a request header, empty if it is missing
+std::string getRequestHeader(httpd_req_t *req, const char *name);
+
+// CBOR if the Accept header asks for application/cbor, JSON otherwise
+WireFormat acceptedWireFormat(httpd_req_t *req);
+
+// JsonWriter sink that streams into a chunked HTTP response
+inline JsonWriter::Sink httpdChunkSink(httpd_req_t *req)
+{
+    return [req](const char *data, size_t len, bool isFinal)
+    {
+        if (len > 0 && httpd_resp_send_chunk(req, data, len) != ESP_OK)
+            return false;
+        return !isFinal || httpd_resp_send_chunk(req, nullptr, 0) == ESP_OK;
+    };
+}
+
 #include "./FeatureRegistry/Features/Logging.h"
 
 void initWebServer();
@@ -8,30 +8,102 @@
 
 #include <esp_http_server.h>
 #include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sys/select.h>
+#include <deque>
+#include <memory>
 #include <vector>
 #include <mutex>
 #include <algorithm>
 #include "WebServer.h"
 #include "../ActionRegistry/ActionRegistry.h"
+#include "HttpWorkers.h"
+#include "../ActionRegistry/CommandBatch.h"
+#include "../utils/Metrics.h"
+#include "../utils/System.h"
 
 static const char *WS_TAG = "WebSocket";
 
-static std::vector<int> wsClients;
+struct WsOutMessage
+{
+    std::string payload;
+    int64_t enqueuedUs;
+};
+
+// Broadcasts are queued per client and sent by wsSenderTask, so a slow client
+// only ever delays itself. Responses to a client's own requests are sent
+// directly from the httpd task; sendMutex keeps them from interleaving with
+// queued frames on the same socket.
+struct WsClient
+{
+    int fd;
+    std::mutex sendMutex;
+    std::deque<WsOutMessage> queue;
+    size_t queuedBytes = 0;
+    uint32_t sent = 0;
+    uint32_t dropped = 0;
+    uint32_t pendingDrops = 0; // dropped since the last delivery, reported in one notice
+    int64_t lastLagUs = 0;
+    int64_t maxLagUs = 0;
+    WireFormat format = WireFormat::JSON; // of action replies, chosen at connect
+};
+
+static std::vector<std::shared_ptr<WsClient>> wsClients;
 static std::mutex wsClientsMutex;
+static TaskHandle_t wsSenderTaskHandle = nullptr;
 
-static void wsAddClient(int fd)
+static Gauge wsClientsGauge("ws_clients", "Connected WebSocket clients", nullptr,
+                            []()
+                            {
+                                std::lock_guard<std::mutex> lock(wsClientsMutex);
+                                return (double)wsClients.size();
+                            });
+static Counter wsDropped("ws_dropped_messages_total", "Log messages dropped from slow clients' queues");
+static Counter wsLagDisconnects("ws_lag_disconnects_total", "Clients disconnected for falling too far behind");
+
+static std::shared_ptr<WsClient> wsFindClient(int fd)
 {
     std::lock_guard<std::mutex> lock(wsClientsMutex);
-    if (std::find(wsClients.begin(), wsClients.end(), fd) == wsClients.end())
+    for (auto &client : wsClients)
     {
-        wsClients.push_back(fd);
+        if (client->fd == fd)
+            return client;
+    }
+    return nullptr;
+}
+
+static void wsAddClient(int fd, WireFormat format)
+{
+    std::lock_guard<std::mutex> lock(wsClientsMutex);
+    for (auto &client : wsClients)
+    {
+        if (client->fd == fd)
+        {
+            client->format = format;
+            return;
+        }
     }
+    auto client = std::make_shared<WsClient>();
+    client->fd = fd;
+    client->format = format;
+    wsClients.push_back(client);
 }
 
 static void wsRemoveClient(int fd)
 {
     std::lock_guard<std::mutex> lock(wsClientsMutex);
-    wsClients.erase(std::remove(wsClients.begin(), wsClients.end(), fd), wsClients.end());
+    wsClients.erase(std::remove_if(wsClients.begin(), wsClients.end(),
+                                   [fd](const std::shared_ptr<WsClient> &c) { return c->fd == fd; }),
+                    wsClients.end());
+}
+
+static void wsWakeSender()
+{
+    if (wsSenderTaskHandle)
+        xTaskNotifyGive(wsSenderTaskHandle);
 }
 
 void wsOnSessionClose(int sockfd)
@@ -41,36 +113,292 @@ void wsOnSessionClose(int sockfd)
 
 void wsBroadcast(const std::string &msg)
 {
-    httpd_handle_t server = getHttpServer();
-    if (!server)
-        return;
+    int64_t now = esp_timer_get_time();
+    {
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        for (auto &client : wsClients)
+        {
+            // log traffic: make room by dropping the oldest messages
+            while (!client->queue.empty() && (client->queue.size() >= WS_QUEUE_MAX_MESSAGES ||
+                                              client->queuedBytes + msg.length() > WS_QUEUE_MAX_BYTES))
+            {
+                client->queuedBytes -= client->queue.front().payload.length();
+                client->queue.pop_front();
+                client->dropped++;
+                wsDropped.inc();
+                client->pendingDrops++;
+            }
+            client->queue.push_back({msg, now});
+            client->queuedBytes += msg.length();
+        }
+    }
+    wsWakeSender();
+}
 
+static bool wsSendText(httpd_handle_t server, int fd, const std::string &text)
+{
     httpd_ws_frame_t frame;
     memset(&frame, 0, sizeof(frame));
     frame.type = HTTPD_WS_TYPE_TEXT;
-    frame.payload = (uint8_t *)msg.c_str();
-    frame.len = msg.length();
+    frame.payload = (uint8_t *)text.c_str();
+    frame.len = text.length();
+    return httpd_ws_send_frame_async(server, fd, &frame) == ESP_OK;
+}
+
+// True if the socket has room for a frame right now. Queued frames are log
+// lines well below the send low-water mark, so a writable socket takes them
+// without blocking the sender task.
+static bool wsWritable(int fd)
+{
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(fd, &writeSet);
+    struct timeval noWait = {0, 0};
+    return select(fd + 1, nullptr, &writeSet, nullptr, &noWait) > 0;
+}
+
+// Sends at most one queued message to the client. Returns true if it did;
+// busy clients are skipped and keep their queue.
+static bool wsSendNext(httpd_handle_t server, WsClient &client, bool *busy = nullptr)
+{
+    std::unique_lock<std::mutex> sendLock(client.sendMutex, std::try_to_lock);
+    if (!sendLock.owns_lock())
+        return false; // a response is in flight, the queue waits for it
+
+    {
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        if (client.queue.empty())
+            return false;
+    }
+    if (!wsWritable(client.fd))
+    {
+        if (busy)
+            *busy = true;
+        return false;
+    }
+
+    WsOutMessage msg;
+    uint32_t drops;
+    {
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        if (client.queue.empty())
+            return false;
+        msg = std::move(client.queue.front());
+        client.queue.pop_front();
+        client.queuedBytes -= msg.payload.length();
+        drops = client.pendingDrops;
+        client.pendingDrops = 0;
+    }
+
+    bool ok = true;
+    if (drops > 0)
+        ok = wsSendText(server, client.fd, "I:WS: " + std::to_string(drops) + " log messages dropped");
+    ok = ok && wsSendText(server, client.fd, msg.payload);
+    if (!ok)
+    {
+        // a half written frame leaves the stream unusable
+        ESP_LOGW(WS_TAG, "Failed to send WS frame to fd %d, closing", client.fd);
+        wsRemoveClient(client.fd);
+        httpd_sess_trigger_close(server, client.fd);
+        return false;
+    }
 
+    int64_t lag = esp_timer_get_time() - msg.enqueuedUs;
     std::lock_guard<std::mutex> lock(wsClientsMutex);
-    for (int fd : wsClients)
+    client.sent++;
+    client.lastLagUs = lag;
+    if (lag > client.maxLagUs)
+        client.maxLagUs = lag;
+    return true;
+}
+
+static void wsSenderTask(void *)
+{
+    std::vector<std::shared_ptr<WsClient>> clients;
+    bool busy = false;
+    while (true)
+    {
+        // the timeout keeps the lag check running while nothing new is queued,
+        // and comes sooner while a busy client still has frames waiting
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(busy ? WS_BUSY_RETRY_MS : 1000));
+        busy = false;
+
+        httpd_handle_t server = getHttpServer();
+        if (!server)
+            continue;
+
+        // round robin, one message per client and pass
+        bool progress = true;
+        while (progress)
+        {
+            {
+                std::lock_guard<std::mutex> lock(wsClientsMutex);
+                clients = wsClients;
+            }
+            progress = false;
+            for (auto &client : clients)
+                progress = wsSendNext(server, *client, &busy) || progress;
+        }
+
+        // clients that stay behind are cut off instead of holding memory
+        int64_t now = esp_timer_get_time();
+        for (auto &client : clients)
+        {
+            bool lagging;
+            {
+                std::lock_guard<std::mutex> lock(wsClientsMutex);
+                lagging = !client->queue.empty() &&
+                          now - client->queue.front().enqueuedUs > (int64_t)WS_CLIENT_MAX_LAG_MS * 1000;
+            }
+            std::unique_lock<std::mutex> sendLock(client->sendMutex, std::try_to_lock);
+            if (lagging && sendLock.owns_lock())
+            {
+                ESP_LOGW(WS_TAG, "Closing lagging WS client fd %d", client->fd);
+                wsRemoveClient(client->fd);
+                wsLagDisconnects.inc();
+                httpd_sess_trigger_close(server, client->fd);
+            }
+        }
+        clients.clear();
+    }
+}
+
+// Shutdown handler: the sender task does not run again before the restart, so
+// the log tail still queued for the clients is sent from the restarting task
+static void wsDrainQueues()
+{
+    loggerInstance->flush();
+    httpd_handle_t server = getHttpServer();
+    if (!server)
+        return;
+
+    std::vector<std::shared_ptr<WsClient>> clients;
     {
-        if (httpd_ws_send_frame_async(server, fd, &frame) != ESP_OK)
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        clients = wsClients;
+    }
+    for (auto &client : clients)
+    {
+        while (wsSendNext(server, *client))
         {
-            ESP_LOGW(WS_TAG, "Failed to send WS frame to fd %d", fd);
         }
     }
 }
 
+static void streamWsStats(const CommandArgs & /*args*/, JsonWriter &out)
+{
+    struct Stats
+    {
+        int fd;
+        size_t queued, queuedBytes;
+        uint32_t sent, dropped;
+        int64_t lagUs, maxLagUs;
+        WireFormat format;
+    };
+
+    // copy first: writing may send to a WS client, which must not happen under wsClientsMutex
+    std::vector<Stats> stats;
+    {
+        std::lock_guard<std::mutex> lock(wsClientsMutex);
+        for (auto &c : wsClients)
+            stats.push_back(
+                {c->fd, c->queue.size(), c->queuedBytes, c->sent, c->dropped, c->lastLagUs, c->maxLagUs, c->format});
+    }
+
+    out.beginObject().key("clients").beginArray();
+    for (const Stats &c : stats)
+    {
+        out.beginObject()
+            .field("fd", c.fd)
+            .field("format", c.format == WireFormat::CBOR ? "cbor" : "json")
+            .field("queued", c.queued)
+            .field("queuedBytes", c.queuedBytes)
+            .field("sent", c.sent)
+            .field("dropped", c.dropped)
+            .field("lagMs", c.lagUs / 1000)
+            .field("maxLagMs", c.maxLagUs / 1000)
+            .endObject();
+    }
+    out.endArray().field("lagDisconnects", wsLagDisconnects.value()).endObject();
+}
+
+static WsBinaryHandler wsBinaryHandlers[WS_BINARY_TYPES] = {};
+
+void wsRegisterBinaryHandler(WsBinaryType type, WsBinaryHandler handler)
+{
+    if (type < WS_BINARY_TYPES)
+        wsBinaryHandlers[type] = handler;
+}
+
+static FeatureAction wsAction = {.name = "ws",
+                                 .handler =
+                                     [](const CommandArgs &args)
+                                 {
+                                     return JsonWriter::toString([&args](JsonWriter &out)
+                                                                 { streamWsStats(args, out); });
+                                 },
+                                 .streamHandler = streamWsStats,
+                                 .transports = {.cli = true, .rest = true, .ws = true, .scripting = true}};
+
+// Sends one reply as a message fragmented into one frame per JsonWriter chunk:
+// text for JSON clients, binary for CBOR clients. The client's queued
+// broadcasts are held off from the first frame to the last. send transmits a
+// single frame.
+template <typename SendFn, typename WriteFn>
+static esp_err_t wsReply(const std::shared_ptr<WsClient> &client, SendFn send, WriteFn write)
+{
+    std::unique_lock<std::mutex> sendLock;
+    bool firstFrame = true;
+    WireFormat format = client ? client->format : WireFormat::JSON;
+    JsonWriter out(
+        [&](const char *data, size_t len, bool isFinal)
+        {
+            if (firstFrame && client)
+                sendLock = std::unique_lock<std::mutex>(client->sendMutex);
+            httpd_ws_frame_t resp;
+            memset(&resp, 0, sizeof(resp));
+            resp.type = !firstFrame                   ? HTTPD_WS_TYPE_CONTINUE
+                        : format == WireFormat::CBOR ? HTTPD_WS_TYPE_BINARY
+                                                     : HTTPD_WS_TYPE_TEXT;
+            resp.fragmented = !(firstFrame && isFinal);
+            resp.final = isFinal;
+            resp.payload = reinterpret_cast<uint8_t *>(const_cast<char *>(data));
+            resp.len = len;
+            firstFrame = false;
+            return send(&resp) == ESP_OK;
+        },
+        JSON_BUFFER_SIZE, format);
+    write(out);
+    esp_err_t ret = out.finish() ? ESP_OK : ESP_FAIL;
+    if (sendLock.owns_lock())
+    {
+        sendLock.unlock();
+        wsWakeSender();
+    }
+    return ret;
+}
+
 static esp_err_t wsHandler(httpd_req_t *req)
 {
     if (req->method == HTTP_GET)
     {
+        // /ws?format=cbor: action replies to this connection are CBOR
+        WireFormat format = WireFormat::JSON;
+        char query[32] = {};
+        char value[8] = {};
+        if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+            httpd_query_key_value(query, "format", value, sizeof(value)) == ESP_OK && strcmp(value, "cbor") == 0)
+        {
+            format = WireFormat::CBOR;
+        }
         int fd = httpd_req_to_sockfd(req);
-        wsAddClient(fd);
-        loggerInstance->Info("WS connected: fd=" + std::to_string(fd));
+        wsAddClient(fd, format);
+        loggerInstance->Info("WS connected: fd=" + std::to_string(fd) + (format == WireFormat::CBOR ? " (cbor)" : ""));
         return ESP_OK;
     }
 
+    HttpLatencyScope latency(HttpLatency::WS_FRAME);
+
     httpd_ws_frame_t frame;
     memset(&frame, 0, sizeof(frame));
     frame.type = HTTPD_WS_TYPE_TEXT;
@@ -102,15 +430,79 @@ static esp_err_t wsHandler(httpd_req_t *req)
 
     if (frame.type == HTTPD_WS_TYPE_TEXT)
     {
-        std::string str(reinterpret_cast<char *>(buf), frame.len);
-        std::string response = actionRegistryInstance->execute(str, Transport::WS);
+        std::string text(reinterpret_cast<char *>(buf), frame.len);
+        std::shared_ptr<WsClient> client = wsFindClient(httpd_req_to_sockfd(req));
+        httpd_handle_t server = req->handle;
+        int fd = httpd_req_to_sockfd(req);
+        auto replyAsync = [server, fd, client](std::function<void(JsonWriter &)> write)
+        {
+            wsReply(
+                client, [server, fd](httpd_ws_frame_t *f) { return httpd_ws_send_frame_async(server, fd, f); }, write);
+        };
+        auto replyError = [req, client](const std::string &message)
+        {
+            return wsReply(
+                client, [req](httpd_ws_frame_t *f) { return httpd_ws_send_frame(req, f); },
+                [&message](JsonWriter &out) { out.beginObject().field("error", message).endObject(); });
+        };
 
-        httpd_ws_frame_t resp;
-        memset(&resp, 0, sizeof(resp));
-        resp.type = HTTPD_WS_TYPE_TEXT;
-        resp.payload = reinterpret_cast<uint8_t *>(const_cast<char *>(response.c_str()));
-        resp.len = response.length();
-        ret = httpd_ws_send_frame(req, &resp);
+        if (isCommandBatch(text))
+        {
+            // several commands, one reply; always on a worker since it may run for a while
+            auto batch = std::make_shared<CommandBatch>();
+            std::string error;
+            if (!parseCommandBatch(text, *batch, error))
+            {
+                ret = replyError(error);
+            }
+            else if (!httpWorkersSubmit(
+                         [replyAsync, batch]()
+                         {
+                             replyAsync([&batch](JsonWriter &out)
+                                        { actionRegistryInstance->executeBatch(*batch, Transport::WS, out); });
+                         }))
+            {
+                ret = replyError("Server busy, try again");
+            }
+        }
+        else
+        {
+            // split once; a copy stays valid, so the worker gets its own
+            CommandArgs args(std::move(text));
+            if (actionRegistryInstance->isAsync(args))
+            {
+                // slow action: reply from a worker so this task can serve other requests
+                bool queued = httpWorkersSubmit(
+                    [replyAsync, args]()
+                    {
+                        replyAsync([&args](JsonWriter &out)
+                                   { actionRegistryInstance->executeStream(args, Transport::WS, out); });
+                    });
+                if (!queued)
+                {
+                    ret = replyError("Server busy, try again");
+                }
+            }
+            else
+            {
+                ret = wsReply(
+                    client, [req](httpd_ws_frame_t *f) { return httpd_ws_send_frame(req, f); },
+                    [&args](JsonWriter &out) { actionRegistryInstance->executeStream(args, Transport::WS, out); });
+            }
+        }
+    }
+    else if (frame.type == HTTPD_WS_TYPE_BINARY)
+    {
+        WsBinaryHandler handler = buf[0] < WS_BINARY_TYPES ? wsBinaryHandlers[buf[0]] : nullptr;
+        ret = wsReply(
+            wsFindClient(httpd_req_to_sockfd(req)), [req](httpd_ws_frame_t *f) { return httpd_ws_send_frame(req, f); },
+            [&](JsonWriter &out)
+            {
+                if (handler)
+                    out.raw(handler(buf + 1, frame.len - 1));
+                else
+                    out.raw("{\"error\": \"Unknown binary message type " + std::to_string(buf[0]) + "\"}");
+            });
     }
     else if (frame.type == HTTPD_WS_TYPE_CLOSE)
     {
@@ -136,14 +528,28 @@ void initWebSockets()
         .uri = WEBSOCKETS_URL, .method = HTTP_GET, .handler = wsHandler, .user_ctx = nullptr, .is_websocket = true};
     httpd_register_uri_handler(server, &wsUri);
 
+    xTaskCreate(wsSenderTask, "ws_sender", 4096, nullptr, 4, &wsSenderTaskHandle);
+    watchTaskStack(wsSenderTaskHandle);
+    esp_register_shutdown_handler(wsDrainQueues);
+    actionRegistryInstance->registerAction(&wsAction);
+
     loggerInstance->AddListener(
-        [](const std::string &scope, const std::string &message)
+        [](const LogRecord *records, size_t count)
         {
+            // one frame per batch, one "<severity>:<message>" line per record
+            size_t length = 0;
+            for (size_t i = 0; i < count; i++)
+                length += records[i].length + 3;
             std::string buf;
-            buf.reserve(scope.length() + 1 + message.length());
-            buf += scope;
-            buf += ':';
-            buf += message;
+            buf.reserve(length);
+            for (size_t i = 0; i < count; i++)
+            {
+                if (i > 0)
+                    buf += '\n';
+                buf += records[i].severity;
+                buf += ':';
+                buf.append(records[i].message, records[i].length);
+            }
             wsBroadcast(buf);
         });
 
@@ -4,10 +4,23 @@
 
 #if ENABLE_WEBSERVER
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
+// Binary messages on the WebSocket start with one of these type bytes
+enum WsBinaryType : uint8_t
+{
+    WS_BINARY_DRAW_BATCH = 1, // packed screen draw commands, see UI/DrawBatch.h
+    WS_BINARY_TYPES
+};
+
+// Handles the payload after the type byte; the returned JSON is sent back as text
+using WsBinaryHandler = std::string (*)(const uint8_t *data, size_t len);
+
 void initWebSockets();
 void wsBroadcast(const std::string &msg);
 void wsOnSessionClose(int sockfd);
+void wsRegisterBinaryHandler(WsBinaryType type, WsBinaryHandler handler);
 
 #endif
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "../fs/FsMetrics.h"
+
+/**
+ * Sequential file writer that keeps one handle open and stages data in a
+ * word-aligned buffer, so the filesystem only ever sees whole blocks (plus one
+ * short tail on close). stdio buffering is disabled; the staging buffer
+ * replaces it.
+ *
+ * A writer that is destroyed without close() is treated as aborted and the
+ * partial file is removed. A close() that fails removes it too, so a failed
+ * write never leaves a truncated file behind.
+ */
+class BufferedFileWriter
+{
+public:
+    BufferedFileWriter() = default;
+    BufferedFileWriter(const BufferedFileWriter &) = delete;
+    BufferedFileWriter &operator=(const BufferedFileWriter &) = delete;
+
+    ~BufferedFileWriter()
+    {
+        abort();
+        free(_buf);
+    }
+
+    bool open(const std::string &path, size_t bufferSize)
+    {
+        abort();
+
+        if (bufferSize != _capacity)
+        {
+            free(_buf);
+            _capacity = (bufferSize + 3) & ~(size_t)3;
+            _buf = (uint8_t *)aligned_alloc(4, _capacity);
+            if (!_buf)
+            {
+                _capacity = 0;
+                return false;
+            }
+        }
+
+        _file = fopen(path.c_str(), "wb");
+        if (!_file)
+        {
+            return false;
+        }
+        setvbuf(_file, nullptr, _IONBF, 0);
+        _path = path;
+        _used = 0;
+        _written = 0;
+        _failed = false;
+        return true;
+    }
+
+    bool write(const uint8_t *data, size_t len)
+    {
+        if (!_file || _failed)
+        {
+            return false;
+        }
+        while (len > 0)
+        {
+            size_t n = _capacity - _used;
+            if (n > len)
+                n = len;
+            memcpy(_buf + _used, data, n);
+            _used += n;
+            data += n;
+            len -= n;
+            if (_used == _capacity && !flush())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Flush the tail and close. Returns false if any write failed, in which
+    // case the truncated file is removed like on abort().
+    bool close()
+    {
+        if (!_file)
+        {
+            return false;
+        }
+        bool ok = flush();
+        ok = (fclose(_file) == 0) && ok;
+        _file = nullptr;
+        if (!ok)
+        {
+            remove(_path.c_str());
+        }
+        return ok;
+    }
+
+    // Close and delete a partially written file
+    void abort()
+    {
+        if (!_file)
+        {
+            return;
+        }
+        fclose(_file);
+        _file = nullptr;
+        remove(_path.c_str());
+    }
+
+    bool isOpen() const
+    {
+        return _file != nullptr;
+    }
+
+    size_t bytesWritten() const
+    {
+        return _written + _used;
+    }
+
+private:
+    bool flush()
+    {
+        if (_used == 0)
+        {
+            return !_failed;
+        }
+        size_t written = fwrite(_buf, 1, _used, _file);
+        fsWrittenBytes.inc(written);
+        if (written != _used)
+        {
+            _failed = true;
+        }
+        _written += _used;
+        _used = 0;
+        return !_failed;
+    }
+
+    FILE *_file = nullptr;
+    std::string _path;
+    uint8_t *_buf = nullptr;
+    size_t _capacity = 0;
+    size_t _used = 0;
+    size_t _written = 0;
+    bool _failed = false;
+};
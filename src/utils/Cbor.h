@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// How a transport encodes action results
+enum class WireFormat : uint8_t
+{
+    JSON,
+    CBOR
+};
+
+/**
+ * CBOR (RFC 8949) building blocks for JsonWriter's binary mode. Maps and arrays
+ * are written with indefinite length so a document can be streamed without
+ * knowing item counts up front; everything else uses the shortest encoding.
+ *
+ * toJson() turns a CBOR document back into JSON text, for tests and
+ * debugging. It understands what JsonWriter writes, not all of CBOR.
+ */
+namespace Cbor
+{
+
+enum Major : uint8_t
+{
+    UNSIGNED = 0,
+    NEGATIVE = 1,
+    BYTES = 2,
+    TEXT = 3,
+    ARRAY = 4,
+    MAP = 5,
+    SIMPLE = 7
+};
+
+static const uint8_t BEGIN_ARRAY = 0x9F;
+static const uint8_t BEGIN_MAP = 0xBF;
+static const uint8_t BREAK = 0xFF;
+static const uint8_t FALSE_VALUE = 0xF4;
+static const uint8_t TRUE_VALUE = 0xF5;
+static const uint8_t NULL_VALUE = 0xF6;
+static const size_t MAX_HEAD = 9;
+
+// Writes the initial byte and argument into out, returns the length
+inline size_t head(uint8_t *out, uint8_t major, uint64_t value)
+{
+    uint8_t type = major << 5;
+    if (value < 24)
+    {
+        out[0] = type | (uint8_t)value;
+        return 1;
+    }
+    size_t bytes = value <= 0xFF ? 1 : value <= 0xFFFF ? 2 : value <= 0xFFFFFFFF ? 4 : 8;
+    out[0] = type | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27);
+    for (size_t i = 0; i < bytes; i++)
+        out[bytes - i] = (uint8_t)(value >> (8 * i));
+    return bytes + 1;
+}
+
+inline size_t integer(uint8_t *out, int64_t value)
+{
+    return value >= 0 ? head(out, UNSIGNED, (uint64_t)value) : head(out, NEGATIVE, (uint64_t)(-(value + 1)));
+}
+
+// Whole numbers become integers; others float32 when that is exact, else float64
+inline size_t number(uint8_t *out, double value)
+{
+    if (value == std::floor(value) && std::fabs(value) < 9.2e18)
+        return integer(out, (int64_t)value);
+    float f = (float)value;
+    if ((double)f == value || std::isnan(value))
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, 4);
+        out[0] = 0xFA;
+        for (size_t i = 0; i < 4; i++)
+            out[4 - i] = (uint8_t)(bits >> (8 * i));
+        return 5;
+    }
+    uint64_t bits;
+    memcpy(&bits, &value, 8);
+    out[0] = 0xFB;
+    for (size_t i = 0; i < 8; i++)
+        out[8 - i] = (uint8_t)(bits >> (8 * i));
+    return 9;
+}
+
+namespace detail
+{
+
+inline void appendString(std::string &json, const char *s, size_t len)
+{
+    json += '"';
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\')
+        {
+            json += '\\';
+            json += (char)c;
+        }
+        else if (c < 0x20)
+        {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            json += esc;
+        }
+        else
+        {
+            json += (char)c;
+        }
+    }
+    json += '"';
+}
+
+inline bool readArgument(const uint8_t *data, size_t len, size_t &pos, uint8_t info, uint64_t &value)
+{
+    if (info < 24)
+    {
+        value = info;
+        return true;
+    }
+    if (info > 27)
+        return false;
+    size_t bytes = (size_t)1 << (info - 24);
+    if (pos + bytes > len)
+        return false;
+    value = 0;
+    for (size_t i = 0; i < bytes; i++)
+        value = (value << 8) | data[pos++];
+    return true;
+}
+
+inline bool item(const uint8_t *data, size_t len, size_t &pos, std::string &json, int depth)
+{
+    if (pos >= len || depth > 32)
+        return false;
+    uint8_t initial = data[pos++];
+    uint8_t major = initial >> 5;
+    uint8_t info = initial & 0x1F;
+
+    if ((major == ARRAY || major == MAP) && info == 31)
+    {
+        bool isMap = major == MAP;
+        json += isMap ? '{' : '[';
+        for (bool first = true; pos < len && data[pos] != BREAK; first = false)
+        {
+            if (!first)
+                json += ',';
+            if (!item(data, len, pos, json, depth + 1))
+                return false;
+            if (isMap)
+            {
+                json += ':';
+                if (!item(data, len, pos, json, depth + 1))
+                    return false;
+            }
+        }
+        if (pos >= len)
+            return false;
+        pos++;
+        json += isMap ? '}' : ']';
+        return true;
+    }
+
+    if (major == SIMPLE)
+    {
+        char num[32];
+        if (initial == FALSE_VALUE || initial == TRUE_VALUE || initial == NULL_VALUE)
+        {
+            json += initial == FALSE_VALUE ? "false" : initial == TRUE_VALUE ? "true" : "null";
+            return true;
+        }
+        if (initial == 0xFA && pos + 4 <= len)
+        {
+            uint32_t bits = 0;
+            for (size_t i = 0; i < 4; i++)
+                bits = (bits << 8) | data[pos++];
+            float f;
+            memcpy(&f, &bits, 4);
+            snprintf(num, sizeof(num), "%.9g", f);
+            json += num;
+            return true;
+        }
+        if (initial == 0xFB && pos + 8 <= len)
+        {
+            uint64_t bits = 0;
+            for (size_t i = 0; i < 8; i++)
+                bits = (bits << 8) | data[pos++];
+            double d;
+            memcpy(&d, &bits, 8);
+            snprintf(num, sizeof(num), "%.17g", d);
+            json += num;
+            return true;
+        }
+        return false;
+    }
+
+    uint64_t value;
+    if (!readArgument(data, len, pos, info, value))
+        return false;
+    switch (major)
+    {
+    case UNSIGNED:
+        json += std::to_string(value);
+        return true;
+    case NEGATIVE:
+        json += "-" + std::to_string(value + 1);
+        return true;
+    case TEXT:
+        if (value > len - pos)
+            return false;
+        appendString(json, (const char *)data + pos, (size_t)value);
+        pos += (size_t)value;
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace detail
+
+// Returns false on anything malformed or outside what JsonWriter produces
+inline bool toJson(const uint8_t *data, size_t len, std::string &json)
+{
+    size_t pos = 0;
+    return detail::item(data, len, pos, json, 0) && pos == len;
+}
+
+} // namespace Cbor
@@ -0,0 +1,422 @@
+#pragma once
+
+#include "cJSON.h"
+#include "Cbor.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+/**
+ * Streaming JSON writer.
+ *
+ * Output is staged in a buffer of chunkSize bytes and handed to the sink
+ * whenever it fills up, so building a response never needs more memory than
+ * one chunk, no matter how large the document gets. finish() flushes the tail
+ * and tells the sink it is the last piece (e.g. to end a chunked HTTP response
+ * or set FIN on a WebSocket frame).
+ *
+ *     JsonWriter out(sink);
+ *     out.beginObject().field("name", "x").key("items").beginArray();
+ *     ...
+ *     out.endArray().endObject().finish();
+ *
+ * With WireFormat::CBOR the same calls produce CBOR instead (maps and arrays
+ * of indefinite length), so a handler written against JsonWriter serves both.
+ * raw() JSON is parsed and re-encoded in that mode; text that is not JSON
+ * becomes a string.
+ */
+class JsonWriter
+{
+public:
+    // Receives each chunk; isFinal is set on the last call (which may be empty).
+    // Return false to stop the writer; later writes become no-ops.
+    using Sink = std::function<bool(const char *data, size_t len, bool isFinal)>;
+
+    explicit JsonWriter(Sink sink, size_t chunkSize = 1024, WireFormat format = WireFormat::JSON)
+        : _sink(std::move(sink)), _chunkSize(chunkSize), _format(format)
+    {
+        _buf.reserve(chunkSize);
+    }
+
+    JsonWriter(const JsonWriter &) = delete;
+    JsonWriter &operator=(const JsonWriter &) = delete;
+
+    // Run fn against a writer that collects into a string
+    template <typename Fn> static std::string toString(Fn fn, size_t chunkSize = 256)
+    {
+        std::string result;
+        JsonWriter out(
+            [&result](const char *data, size_t len, bool)
+            {
+                result.append(data, len);
+                return true;
+            },
+            chunkSize);
+        fn(out);
+        out.finish();
+        return result;
+    }
+
+    WireFormat format() const
+    {
+        return _format;
+    }
+
+    bool isCbor() const
+    {
+        return _format == WireFormat::CBOR;
+    }
+
+    JsonWriter &beginObject()
+    {
+        separator();
+        put(isCbor() ? (char)Cbor::BEGIN_MAP : '{');
+        push();
+        return *this;
+    }
+
+    JsonWriter &endObject()
+    {
+        pop();
+        put(isCbor() ? (char)Cbor::BREAK : '}');
+        return *this;
+    }
+
+    JsonWriter &beginArray()
+    {
+        separator();
+        put(isCbor() ? (char)Cbor::BEGIN_ARRAY : '[');
+        push();
+        return *this;
+    }
+
+    JsonWriter &endArray()
+    {
+        pop();
+        put(isCbor() ? (char)Cbor::BREAK : ']');
+        return *this;
+    }
+
+    JsonWriter &key(const char *name)
+    {
+        separator();
+        putString(name, strlen(name));
+        if (!isCbor())
+            put(':');
+        _afterKey = true;
+        return *this;
+    }
+
+    JsonWriter &key(const std::string &name)
+    {
+        return key(name.c_str());
+    }
+
+    JsonWriter &value(const char *str)
+    {
+        if (!str)
+            return null();
+        separator();
+        putString(str, strlen(str));
+        return *this;
+    }
+
+    JsonWriter &value(const std::string &str)
+    {
+        separator();
+        putString(str.data(), str.size());
+        return *this;
+    }
+
+    JsonWriter &value(bool b)
+    {
+        separator();
+        if (isCbor())
+            put((char)(b ? Cbor::TRUE_VALUE : Cbor::FALSE_VALUE));
+        else
+            put(b ? "true" : "false");
+        return *this;
+    }
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value,
+                                                  int>::type = 0>
+    JsonWriter &value(T v)
+    {
+        if (isCbor())
+            return cborNumber(v, std::is_signed<T>::value);
+        char num[24];
+        if (std::is_signed<T>::value)
+            snprintf(num, sizeof(num), "%lld", (long long)v);
+        else
+            snprintf(num, sizeof(num), "%llu", (unsigned long long)v);
+        separator();
+        put(num);
+        return *this;
+    }
+
+    JsonWriter &value(double d)
+    {
+        if (!std::isfinite(d))
+            return null();
+        if (d == std::floor(d) && std::fabs(d) < 1e15)
+            return value((long long)d);
+        if (isCbor())
+        {
+            uint8_t head[Cbor::MAX_HEAD];
+            separator();
+            write((const char *)head, Cbor::number(head, d));
+            return *this;
+        }
+
+        char num[32];
+        snprintf(num, sizeof(num), "%.15g", d);
+        if (strtod(num, nullptr) != d)
+            snprintf(num, sizeof(num), "%.17g", d);
+        separator();
+        put(num);
+        return *this;
+    }
+
+    // Serialize an existing cJSON tree without printing it to a string first
+    JsonWriter &value(const cJSON *item)
+    {
+        if (!item || cJSON_IsNull(item) || cJSON_IsInvalid(item))
+            return null();
+        if (cJSON_IsBool(item))
+            return value((bool)cJSON_IsTrue(item));
+        if (cJSON_IsNumber(item))
+            return value(item->valuedouble);
+        if (cJSON_IsString(item))
+            return value((const char *)item->valuestring);
+        if (cJSON_IsRaw(item))
+            return raw(item->valuestring);
+
+        bool isObject = cJSON_IsObject(item);
+        isObject ? beginObject() : beginArray();
+        for (const cJSON *child = item->child; child != nullptr; child = child->next)
+        {
+            if (isObject)
+                key(child->string ? child->string : "");
+            value(child);
+        }
+        return isObject ? endObject() : endArray();
+    }
+
+    JsonWriter &null()
+    {
+        separator();
+        if (isCbor())
+            put((char)Cbor::NULL_VALUE);
+        else
+            put("null");
+        return *this;
+    }
+
+    // Insert an already serialized JSON value
+    JsonWriter &raw(const char *json, size_t len)
+    {
+        if (isCbor())
+            return cborFromJson(json, len);
+        separator();
+        write(json, len);
+        return *this;
+    }
+
+    JsonWriter &raw(const char *json)
+    {
+        return raw(json, strlen(json));
+    }
+
+    JsonWriter &raw(const std::string &json)
+    {
+        return raw(json.data(), json.size());
+    }
+
+    template <typename T> JsonWriter &field(const char *name, const T &v)
+    {
+        key(name);
+        return value(v);
+    }
+
+    // Flush what is buffered and signal the end of the document
+    bool finish()
+    {
+        if (_finished)
+            return _ok;
+        _finished = true;
+        if (_ok)
+            _ok = _sink(_buf.data(), _buf.size(), true);
+        _buf.clear();
+        return _ok;
+    }
+
+    bool ok() const
+    {
+        return _ok;
+    }
+
+private:
+    static const int MAX_DEPTH = 32;
+
+    Sink _sink;
+    size_t _chunkSize;
+    WireFormat _format;
+    std::string _buf;
+    bool _hasItems[MAX_DEPTH] = {};
+    int _depth = 0;
+    bool _afterKey = false;
+    bool _ok = true;
+    bool _finished = false;
+
+    void push()
+    {
+        if (_depth < MAX_DEPTH)
+            _hasItems[_depth] = false;
+        _depth++;
+    }
+
+    void pop()
+    {
+        if (_depth > 0)
+            _depth--;
+        _afterKey = false;
+    }
+
+    // Emit the comma between siblings; a value right after its key needs none
+    void separator()
+    {
+        if (isCbor())
+        {
+            _afterKey = false;
+            return;
+        }
+        if (_afterKey)
+        {
+            _afterKey = false;
+            return;
+        }
+        if (_depth > 0 && _depth <= MAX_DEPTH)
+        {
+            if (_hasItems[_depth - 1])
+                put(',');
+            _hasItems[_depth - 1] = true;
+        }
+    }
+
+    void flushFull()
+    {
+        if (_ok && !_finished)
+            _ok = _sink(_buf.data(), _buf.size(), false);
+        _buf.clear();
+    }
+
+    void write(const char *data, size_t len)
+    {
+        while (len > 0)
+        {
+            size_t room = _chunkSize - _buf.size();
+            size_t n = len < room ? len : room;
+            _buf.append(data, n);
+            data += n;
+            len -= n;
+            if (_buf.size() >= _chunkSize)
+                flushFull();
+        }
+    }
+
+    void put(char c)
+    {
+        write(&c, 1);
+    }
+
+    void put(const char *s)
+    {
+        write(s, strlen(s));
+    }
+
+    template <typename T> JsonWriter &cborNumber(T v, bool isSigned)
+    {
+        uint8_t head[Cbor::MAX_HEAD];
+        size_t n = isSigned && (long long)v < 0 ? Cbor::integer(head, (int64_t)v)
+                                                : Cbor::head(head, Cbor::UNSIGNED, (uint64_t)v);
+        separator();
+        write((const char *)head, n);
+        return *this;
+    }
+
+    JsonWriter &cborFromJson(const char *json, size_t len)
+    {
+        cJSON *parsed = cJSON_ParseWithLength(json, len);
+        if (parsed == nullptr)
+        {
+            separator();
+            putString(json, len);
+            return *this;
+        }
+        value((const cJSON *)parsed);
+        cJSON_Delete(parsed);
+        return *this;
+    }
+
+    void putString(const char *s, size_t len)
+    {
+        if (isCbor())
+        {
+            uint8_t head[Cbor::MAX_HEAD];
+            write((const char *)head, Cbor::head(head, Cbor::TEXT, len));
+            write(s, len);
+            return;
+        }
+        put('"');
+        size_t runStart = 0;
+        for (size_t i = 0; i < len; i++)
+        {
+            unsigned char c = (unsigned char)s[i];
+            const char *esc = nullptr;
+            char uni[8];
+            switch (c)
+            {
+            case '"':
+                esc = "\\\"";
+                break;
+            case '\\':
+                esc = "\\\\";
+                break;
+            case '\n':
+                esc = "\\n";
+                break;
+            case '\r':
+                esc = "\\r";
+                break;
+            case '\t':
+                esc = "\\t";
+                break;
+            case '\b':
+                esc = "\\b";
+                break;
+            case '\f':
+                esc = "\\f";
+                break;
+            default:
+                if (c < 0x20)
+                {
+                    snprintf(uni, sizeof(uni), "\\u%04x", c);
+                    esc = uni;
+                }
+                break;
+            }
+            if (esc)
+            {
+                write(s + runStart, i - runStart);
+                put(esc);
+                runStart = i + 1;
+            }
+        }
+        write(s + runStart, len - runStart);
+        put('"');
+    }
+};
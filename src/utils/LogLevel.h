@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../config.h"
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+/**
+ * Level-checked logging. The message arguments are only evaluated when the
+ * level passes the logger's runtime threshold, and the whole statement folds
+ * away below LOG_COMPILE_LEVEL:
+ *
+ *     LOG_AT_WITH(loggerInstance, LOG_LEVEL_DEBUG, "x=" + std::to_string(x));
+ *
+ * logger needs isEnabled(level) and log(level, args...). Logging.h wraps this
+ * as LOG_DEBUG/LOG_INFO/LOG_ERROR for the global logger.
+ */
+#define LOG_AT_WITH(logger, level, ...)                                                                                \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if ((level) >= LOG_COMPILE_LEVEL && (logger)->isEnabled(level))                                                \
+            (logger)->log((level), __VA_ARGS__);                                                                       \
+    } while (0)
+
+inline char logLevelSeverity(uint8_t level)
+{
+    return level >= LOG_LEVEL_ERROR ? 'E' : level == LOG_LEVEL_DEBUG ? 'D' : 'I';
+}
+
+inline const char *logLevelName(uint8_t level)
+{
+    return level >= LOG_LEVEL_ERROR ? "error" : level == LOG_LEVEL_DEBUG ? "debug" : "info";
+}
+
+inline bool parseLogLevel(const std::string &name, uint8_t &level)
+{
+    if (name == "debug")
+        level = LOG_LEVEL_DEBUG;
+    else if (name == "info")
+        level = LOG_LEVEL_INFO;
+    else if (name == "error")
+        level = LOG_LEVEL_ERROR;
+    else
+        return false;
+    return true;
+}
+
+/**
+ * ISO 8601 UTC text for an epoch time, formatted again only when the second
+ * changes. Not thread safe: give each task its own or guard it.
+ */
+class UtcTimeCache
+{
+public:
+    static const size_t SIZE = 24;
+
+    const char *format(time_t epochTime)
+    {
+        if (epochTime != _epochTime || !_valid)
+        {
+            struct tm timeinfo;
+            gmtime_r(&epochTime, &timeinfo);
+            strftime(_text, sizeof(_text), "%FT%TZ", &timeinfo);
+            _epochTime = epochTime;
+            _valid = true;
+        }
+        return _text;
+    }
+
+private:
+    time_t _epochTime = 0;
+    bool _valid = false;
+    char _text[SIZE] = {};
+};
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+/**
+ * Counters, gauges and fixed-bucket histograms in the Prometheus text
+ * exposition format.
+ *
+ * Metrics are static objects that add themselves to one list when they are
+ * constructed, so a module declares what it measures next to the code that
+ * measures it:
+ *
+ *     static Counter dropped("ws_dropped_messages_total", "Log messages dropped for slow clients");
+ *     dropped.inc();
+ *
+ * Updating is a relaxed atomic add, safe from any task and never allocating.
+ * Metrics sharing a name form one family, told apart by their labels
+ * (transport="rest"); Metric::writeAll() prints every family once.
+ */
+
+#define METRICS_MAX_BUCKETS 12
+
+// Text output, staged in a small buffer and handed to the sink when it fills
+class MetricsWriter
+{
+public:
+    // Return false to stop the writer; later writes become no-ops
+    using Sink = std::function<bool(const char *data, size_t len)>;
+
+    explicit MetricsWriter(Sink sink) : _sink(std::move(sink))
+    {
+    }
+
+    MetricsWriter(const MetricsWriter &) = delete;
+    MetricsWriter &operator=(const MetricsWriter &) = delete;
+
+    void family(const char *name, const char *help, const char *type)
+    {
+        put("# HELP ").put(name).put(" ").put(help).put("\n# TYPE ").put(name).put(" ").put(type).put("\n");
+    }
+
+    // name{labels,extra} value, where labels and extra are optional
+    void sample(const char *name, const char *suffix, const char *labels, double value, const char *extra = nullptr)
+    {
+        put(name).put(suffix);
+        bool hasLabels = labels != nullptr && *labels != '\0';
+        if (hasLabels || extra != nullptr)
+        {
+            put("{");
+            if (hasLabels)
+                put(labels);
+            if (hasLabels && extra != nullptr)
+                put(",");
+            if (extra != nullptr)
+                put(extra);
+            put("}");
+        }
+        char num[32];
+        if (std::fabs(value) < 9e18 && value == (double)(int64_t)value)
+            snprintf(num, sizeof(num), " %lld\n", (long long)value);
+        else
+            snprintf(num, sizeof(num), " %.9g\n", value);
+        put(num);
+    }
+
+    MetricsWriter &put(const char *text)
+    {
+        for (size_t len = strlen(text); len > 0;)
+        {
+            size_t n = len < sizeof(_buf) - _used ? len : sizeof(_buf) - _used;
+            memcpy(_buf + _used, text, n);
+            _used += n;
+            text += n;
+            len -= n;
+            if (_used == sizeof(_buf))
+                flush();
+        }
+        return *this;
+    }
+
+    // Hands over what is left; false if the sink gave up on the way
+    bool finish()
+    {
+        flush();
+        return _ok;
+    }
+
+private:
+    void flush()
+    {
+        if (_ok && _used > 0)
+            _ok = _sink(_buf, _used);
+        _used = 0;
+    }
+
+    Sink _sink;
+    char _buf[512];
+    size_t _used = 0;
+    bool _ok = true;
+};
+
+class Metric
+{
+public:
+    Metric(const Metric &) = delete;
+    Metric &operator=(const Metric &) = delete;
+
+    const char *name() const
+    {
+        return _name;
+    }
+
+    // Every registered family, each with its HELP and TYPE lines once
+    static bool writeAll(MetricsWriter &out)
+    {
+        Metric *head = s_head.load(std::memory_order_acquire);
+        for (Metric *m = head; m != nullptr; m = m->_next)
+        {
+            bool seen = false;
+            for (Metric *p = head; p != m && !seen; p = p->_next)
+                seen = strcmp(p->_name, m->_name) == 0;
+            if (seen)
+                continue;
+
+            out.family(m->_name, m->_help, m->type());
+            for (Metric *q = m; q != nullptr; q = q->_next)
+            {
+                if (strcmp(q->_name, m->_name) == 0)
+                    q->writeSamples(out);
+            }
+        }
+        return out.finish();
+    }
+
+protected:
+    Metric(const char *name, const char *help, const char *labels) : _name(name), _help(help), _labels(labels)
+    {
+        _next = s_head.load(std::memory_order_relaxed);
+        while (!s_head.compare_exchange_weak(_next, this, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    virtual ~Metric() = default;
+
+    virtual const char *type() const = 0;
+    virtual void writeSamples(MetricsWriter &out) const = 0;
+
+    const char *_name;
+    const char *_help;
+    const char *_labels;
+
+private:
+    Metric *_next = nullptr;
+    static inline std::atomic<Metric *> s_head{nullptr};
+};
+
+// Only goes up
+class Counter : public Metric
+{
+public:
+    Counter(const char *name, const char *help, const char *labels = nullptr) : Metric(name, help, labels)
+    {
+    }
+
+    void inc(uint64_t n = 1)
+    {
+        _value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        return _value.load(std::memory_order_relaxed);
+    }
+
+protected:
+    const char *type() const override
+    {
+        return "counter";
+    }
+
+    void writeSamples(MetricsWriter &out) const override
+    {
+        out.sample(_name, "", _labels, (double)value());
+    }
+
+private:
+    std::atomic<uint64_t> _value{0};
+};
+
+// Goes up and down; either set by the owner or read at scrape time
+class Gauge : public Metric
+{
+public:
+    using Reader = double (*)();
+
+    Gauge(const char *name, const char *help, const char *labels = nullptr, Reader read = nullptr)
+        : Metric(name, help, labels), _read(read)
+    {
+    }
+
+    void set(int32_t value)
+    {
+        _value.store(value, std::memory_order_relaxed);
+    }
+
+    void add(int32_t delta)
+    {
+        _value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    double value() const
+    {
+        return _read != nullptr ? _read() : _value.load(std::memory_order_relaxed);
+    }
+
+protected:
+    const char *type() const override
+    {
+        return "gauge";
+    }
+
+    void writeSamples(MetricsWriter &out) const override
+    {
+        out.sample(_name, "", _labels, value());
+    }
+
+private:
+    std::atomic<int32_t> _value{0};
+    Reader _read;
+};
+
+/**
+ * Observations counted into buckets with fixed upper bounds. Values are
+ * recorded as integers (e.g. microseconds) and multiplied by scale on output,
+ * so a histogram of microseconds can be exported in seconds:
+ *
+ *     static const uint32_t US_BOUNDS[] = {1000, 10000, 100000};
+ *     static Histogram drawTime("ui_frame_draw_seconds", "...", nullptr, US_BOUNDS, 1e-6);
+ */
+class Histogram : public Metric
+{
+public:
+    template <size_t N>
+    Histogram(const char *name, const char *help, const char *labels, const uint32_t (&bounds)[N], double scale = 1)
+        : Metric(name, help, labels), _bounds(bounds), _bucketCount(N), _scale(scale)
+    {
+        static_assert(N <= METRICS_MAX_BUCKETS, "raise METRICS_MAX_BUCKETS");
+    }
+
+    void observe(int64_t value)
+    {
+        uint32_t v = value < 0 ? 0 : value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+        size_t i = 0;
+        while (i < _bucketCount && v > _bounds[i])
+            i++;
+        _counts[i].fetch_add(1, std::memory_order_relaxed); // _counts[_bucketCount] is +Inf
+        _sum.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    uint32_t count() const
+    {
+        uint32_t total = 0;
+        for (size_t i = 0; i <= _bucketCount; i++)
+            total += _counts[i].load(std::memory_order_relaxed);
+        return total;
+    }
+
+protected:
+    const char *type() const override
+    {
+        return "histogram";
+    }
+
+    void writeSamples(MetricsWriter &out) const override
+    {
+        char le[32];
+        uint32_t cumulative = 0;
+        for (size_t i = 0; i <= _bucketCount; i++)
+        {
+            cumulative += _counts[i].load(std::memory_order_relaxed);
+            if (i < _bucketCount)
+                snprintf(le, sizeof(le), "le=\"%.9g\"", _bounds[i] * _scale);
+            else
+                snprintf(le, sizeof(le), "le=\"+Inf\"");
+            out.sample(_name, "_bucket", _labels, cumulative, le);
+        }
+        out.sample(_name, "_sum", _labels, _sum.load(std::memory_order_relaxed) * _scale);
+        out.sample(_name, "_count", _labels, cumulative);
+    }
+
+private:
+    const uint32_t *_bounds;
+    size_t _bucketCount;
+    double _scale;
+    std::atomic<uint32_t> _counts[METRICS_MAX_BUCKETS + 1] = {};
+    std::atomic<uint64_t> _sum{0};
+};
+
+// A family whose members are only known at scrape time (one sample per task):
+// collect() writes the samples, the registry writes HELP and TYPE
+class MetricsCollector : public Metric
+{
+public:
+    using Collect = void (*)(MetricsWriter &out, const char *name);
+
+    MetricsCollector(const char *name, const char *help, const char *type, Collect collect)
+        : Metric(name, help, nullptr), _type(type), _collect(collect)
+    {
+    }
+
+protected:
+    const char *type() const override
+    {
+        return _type;
+    }
+
+    void writeSamples(MetricsWriter &out) const override
+    {
+        _collect(out, _name);
+    }
+
+private:
+    const char *_type;
+    Collect _collect;
+};
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+using MultipartFieldCb = std::function<void(const std::string &name, const std::string &value)>;
+using MultipartFileDataCb = std::function<bool(const std::string &fieldName, const std::string &fileName,
+                                               const uint8_t *data, size_t len, bool isFirst, bool isFinal)>;
+
+// Pulls up to max bytes into dst. Returns the byte count, 0 at end of body, < 0 on error.
+using MultipartReadFn = std::function<int(uint8_t *dst, size_t max)>;
+
+#define MULTIPART_WINDOW_SIZE 4096
+#define MULTIPART_MAX_HEADER_SIZE 2048
+
+inline std::string mpExtractBoundary(const char *contentType)
+{
+    if (!contentType)
+        return "";
+    const char *b = strstr(contentType, "boundary=");
+    if (!b)
+        return "";
+    b += 9;
+    if (*b == '"')
+    {
+        b++;
+        const char *end = strchr(b, '"');
+        return end ? std::string(b, end - b) : "";
+    }
+    const char *end = b;
+    while (*end && *end != ';' && *end != ' ' && *end != '\r' && *end != '\n')
+        end++;
+    return std::string(b, end - b);
+}
+
+inline void mpParsePartHeaders(const std::string &headers, std::string &name, std::string &filename)
+{
+    name.clear();
+    filename.clear();
+
+    std::string lower = headers;
+    for (auto &c : lower)
+        c = tolower(static_cast<unsigned char>(c));
+
+    size_t cdPos = lower.find("content-disposition:");
+    if (cdPos == std::string::npos)
+        return;
+
+    size_t lineEnd = headers.find("\r\n", cdPos);
+    std::string cdLine = headers.substr(cdPos, lineEnd == std::string::npos ? std::string::npos : lineEnd - cdPos);
+
+    size_t namePos = cdLine.find("name=\"");
+    if (namePos != std::string::npos)
+    {
+        namePos += 6;
+        size_t nameEnd = cdLine.find('"', namePos);
+        if (nameEnd != std::string::npos)
+            name = cdLine.substr(namePos, nameEnd - namePos);
+    }
+
+    size_t fnPos = cdLine.find("filename=\"");
+    if (fnPos != std::string::npos)
+    {
+        fnPos += 10;
+        size_t fnEnd = cdLine.find('"', fnPos);
+        if (fnEnd != std::string::npos)
+            filename = cdLine.substr(fnPos, fnEnd - fnPos);
+    }
+}
+
+/**
+ * Transport independent multipart/form-data parser.
+ *
+ * The body is read straight into one fixed window buffer and the part
+ * delimiter ("\r\n--" + boundary) is located with Boyer-Moore-Horspool.
+ * File data is handed to onFileData as pointers into that window; after each
+ * scan only the last (delimiter length - 1) bytes, which could be the start of
+ * a split delimiter, are moved to the front. No allocation happens per chunk.
+ *
+ *  - onField(name, value) for non-file form fields
+ *  - onFileData(fieldName, fileName, data, len, isFirst, isFinal) for file data chunks
+ *    Return false from onFileData to abort parsing.
+ */
+class MultipartStream
+{
+public:
+    enum Result
+    {
+        OK,
+        ABORTED,    // onFileData returned false
+        READ_ERROR, // read callback failed
+        MALFORMED   // part headers too large
+    };
+
+    explicit MultipartStream(const std::string &boundary, size_t windowSize = MULTIPART_WINDOW_SIZE)
+        : _marker("\r\n--" + boundary)
+    {
+        size_t m = _marker.size();
+        for (auto &s : _skip)
+            s = m;
+        for (size_t i = 0; i + 1 < m; i++)
+            _skip[(uint8_t)_marker[i]] = m - 1 - i;
+
+        // the window must always have room for a new read after the kept tail
+        _windowSize = windowSize < 4 * m ? 4 * m : windowSize;
+    }
+
+    // Boyer-Moore-Horspool search for the delimiter in [hay, hay + n)
+    const uint8_t *findMarker(const uint8_t *hay, size_t n) const
+    {
+        const size_t m = _marker.size();
+        const uint8_t *needle = (const uint8_t *)_marker.data();
+        const uint8_t last = needle[m - 1];
+        size_t i = 0;
+        while (i + m <= n)
+        {
+            uint8_t c = hay[i + m - 1];
+            if (c == last && memcmp(hay + i, needle, m - 1) == 0)
+                return hay + i;
+            i += _skip[c];
+        }
+        return nullptr;
+    }
+
+    Result parse(const MultipartReadFn &read, const MultipartFieldCb &onField, const MultipartFileDataCb &onFileData)
+    {
+        enum State
+        {
+            PREAMBLE,
+            HEADER,
+            BODY,
+            AFTER_BOUNDARY
+        };
+
+        std::vector<uint8_t> window(_windowSize);
+        uint8_t *buf = window.data();
+        const size_t keep = _marker.size() - 1;
+
+        // The first delimiter has no leading CRLF; pretend the body starts with one
+        // so a single search handles both cases.
+        buf[0] = '\r';
+        buf[1] = '\n';
+        size_t start = 0;
+        size_t end = 2;
+
+        State state = PREAMBLE;
+        bool eof = false;
+        std::string headers;
+        std::string currentName, currentFileName, fieldValue;
+        bool isFile = false;
+        bool isFirstChunk = true;
+
+        auto emit = [&](const uint8_t *data, size_t len, bool isFinal) -> bool
+        {
+            if (isFile)
+            {
+                if (!onFileData)
+                    return true;
+                bool cont = onFileData(currentName, currentFileName, data, len, isFirstChunk, isFinal);
+                isFirstChunk = false;
+                return cont;
+            }
+            fieldValue.append((const char *)data, len);
+            if (isFinal && onField)
+                onField(currentName, fieldValue);
+            return true;
+        };
+
+        while (true)
+        {
+            // --- Process the window as far as possible ---
+            bool progress = true;
+            while (progress)
+            {
+                progress = false;
+
+                if (state == PREAMBLE || state == BODY)
+                {
+                    const uint8_t *hit = findMarker(buf + start, end - start);
+                    if (hit)
+                    {
+                        size_t pos = hit - buf;
+                        if (state == BODY && !emit(buf + start, pos - start, true))
+                            return ABORTED;
+                        start = pos + _marker.size();
+                        state = AFTER_BOUNDARY;
+                        progress = true;
+                    }
+                    else if (end - start > keep)
+                    {
+                        // everything but a possible split delimiter is part data
+                        size_t safe = end - keep;
+                        if (state == BODY && !emit(buf + start, safe - start, false))
+                            return ABORTED;
+                        start = safe;
+                    }
+                }
+                else if (state == AFTER_BOUNDARY)
+                {
+                    if (end - start >= 2)
+                    {
+                        if (buf[start] == '-' && buf[start + 1] == '-')
+                            return OK;
+                        start += 2; // skip \r\n
+                        headers.clear();
+                        state = HEADER;
+                        progress = true;
+                    }
+                }
+                else if (state == HEADER && end > start)
+                {
+                    size_t scanFrom = headers.size() < 3 ? 0 : headers.size() - 3;
+                    size_t before = headers.size();
+                    headers.append((const char *)buf + start, end - start);
+                    size_t pos = headers.find("\r\n\r\n", scanFrom);
+                    if (pos == std::string::npos)
+                    {
+                        if (headers.size() > MULTIPART_MAX_HEADER_SIZE)
+                            return MALFORMED;
+                        start = end;
+                        continue;
+                    }
+
+                    start += pos + 4 - before;
+                    headers.resize(pos);
+                    mpParsePartHeaders(headers, currentName, currentFileName);
+                    isFile = !currentFileName.empty();
+                    isFirstChunk = true;
+                    fieldValue.clear();
+                    state = BODY;
+                    progress = true;
+                }
+            }
+
+            if (eof)
+                break;
+
+            // --- Read more data behind the unprocessed tail ---
+            if (start > 0)
+            {
+                memmove(buf, buf + start, end - start);
+                end -= start;
+                start = 0;
+            }
+
+            int recvd = read(buf + end, _windowSize - end);
+            if (recvd < 0)
+                return READ_ERROR;
+            if (recvd == 0)
+                eof = true;
+            end += recvd;
+        }
+
+        // Body ended without a closing delimiter: hand over what is left of the part
+        if (state == BODY && !emit(buf + start, end - start, true))
+            return ABORTED;
+
+        return OK;
+    }
+
+private:
+    std::string _marker;
+    size_t _skip[256];
+    size_t _windowSize;
+};
@@ -62,4 +62,30 @@ inline std::string toHex(unsigned long value)
     return buf;
 }
 
+// Decode %XX escapes and '+' (query string encoding)
+inline std::string urlDecode(const std::string &str)
+{
+    std::string out;
+    out.reserve(str.size());
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        char c = str[i];
+        if (c == '+')
+        {
+            out += ' ';
+        }
+        else if (c == '%' && i + 2 < str.size() && isxdigit(static_cast<unsigned char>(str[i + 1])) &&
+                 isxdigit(static_cast<unsigned char>(str[i + 2])))
+        {
+            out += static_cast<char>(std::stoi(str.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    return out;
+}
+
 } // namespace StringUtil
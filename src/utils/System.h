@@ -1,8 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 
 #include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
 inline size_t getFreeHeap()
 {
     return esp_get_free_heap_size();
@@ -11,3 +15,22 @@ inline void systemRestart()
 {
     esp_restart();
 }
+
+/**
+ * Service tasks (those not owned by a Feature) whose stack high-water mark is
+ * reported in /metrics. Watched tasks must live until restart; feature tasks
+ * are reported without being watched.
+ */
+#define WATCHED_TASKS_MAX 12
+
+inline std::atomic<TaskHandle_t> watchedTasks[WATCHED_TASKS_MAX] = {};
+
+inline void watchTaskStack(TaskHandle_t task)
+{
+    for (std::atomic<TaskHandle_t> &slot : watchedTasks)
+    {
+        TaskHandle_t empty = nullptr;
+        if (task == nullptr || slot.compare_exchange_strong(empty, task))
+            return;
+    }
+}
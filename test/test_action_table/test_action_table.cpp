@@ -0,0 +1,143 @@
+#include <unity.h>
+#include "../../src/ActionRegistry/ActionTable.h"
+
+#include <chrono>
+#include <cstdio>
+
+struct Entry
+{
+    std::string name;
+};
+
+// The names registered on the device with every feature enabled
+static const char *NAMES[] = {"ws",     "http",     "format",   "list",  "berry",   "sd",
+                              "mirror", "wm",       "screen",   "page",  "ui_frame", "app_timer",
+                              "i2c",    "restart",  "features", "info",  "rgbLed",  "getLightSensorValue",
+                              "wifi",   "memory",   "log",      "logstore"};
+static const size_t NAME_COUNT = sizeof(NAMES) / sizeof(NAMES[0]);
+
+static std::vector<Entry> makeEntries(size_t extra)
+{
+    std::vector<Entry> entries;
+    for (const char *name : NAMES)
+        entries.push_back({name});
+    for (size_t i = 0; i < extra; i++)
+        entries.push_back({"action" + std::to_string(i)});
+    return entries;
+}
+
+void test_find_by_first_word(void)
+{
+    std::vector<Entry> entries = makeEntries(0);
+    ActionTable<Entry> table;
+    for (Entry &e : entries)
+        TEST_ASSERT_TRUE(table.insert(&e));
+
+    TEST_ASSERT_EQUAL_STRING("log", table.find("log")->name.c_str());
+    TEST_ASSERT_EQUAL_STRING("log", table.find("log stats")->name.c_str());
+    TEST_ASSERT_EQUAL_STRING("logstore", table.find("logstore read from=1")->name.c_str());
+    TEST_ASSERT_EQUAL_STRING("screen", table.find("screen text 1 2 hello world")->name.c_str());
+    TEST_ASSERT_NULL(table.find("logs"));
+    TEST_ASSERT_NULL(table.find("lo"));
+    TEST_ASSERT_NULL(table.find(""));
+    TEST_ASSERT_NULL(table.find(" log"));
+}
+
+void test_duplicate_name_is_refused(void)
+{
+    Entry a{"info"}, b{"info"};
+    ActionTable<Entry> table;
+    TEST_ASSERT_TRUE(table.insert(&a));
+    TEST_ASSERT_FALSE(table.insert(&b));
+    TEST_ASSERT_TRUE(table.find("info") == &a);
+    TEST_ASSERT_EQUAL(1, table.size());
+}
+
+void test_grows_past_the_old_limit(void)
+{
+    std::vector<Entry> entries = makeEntries(200);
+    ActionTable<Entry> table;
+    for (Entry &e : entries)
+        TEST_ASSERT_TRUE(table.insert(&e));
+    TEST_ASSERT_EQUAL(entries.size(), table.size());
+    for (Entry &e : entries)
+        TEST_ASSERT_TRUE(table.find(e.name + " arg") == &e);
+
+    // registration order is kept
+    size_t i = 0;
+    bool ordered = true;
+    table.forEach([&](Entry *e) { ordered = ordered && e == &entries[i++]; });
+    TEST_ASSERT_TRUE(ordered);
+}
+
+// The previous lookup: linear scan under a mutex, building name + " " for
+// every entry
+struct LegacyRegistry
+{
+    std::mutex mutex;
+    std::vector<Entry *> actions;
+
+    Entry *find(const std::string &command)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Entry *e : actions)
+        {
+            const std::string &name = e->name;
+            std::string prefix = name + " ";
+            if (command == name || (command.size() >= prefix.size() && command.compare(0, prefix.size(), prefix) == 0))
+                return e;
+        }
+        return nullptr;
+    }
+};
+
+void test_benchmark_dispatch(void)
+{
+    std::vector<Entry> entries = makeEntries(0);
+    ActionTable<Entry> table;
+    LegacyRegistry legacy;
+    for (Entry &e : entries)
+    {
+        table.insert(&e);
+        legacy.actions.push_back(&e);
+    }
+
+    // a mix of early, late and unknown commands, with arguments
+    std::vector<std::string> commands;
+    for (size_t i = 0; i < NAME_COUNT; i++)
+        commands.push_back(std::string(NAMES[i]) + " some args 1 2");
+    commands.push_back("unknown_command x");
+
+    const int ROUNDS = 20000;
+    size_t hits = 0, legacyHits = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+        for (const std::string &c : commands)
+            hits += table.find(c) != nullptr;
+    auto t1 = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+        for (const std::string &c : commands)
+            legacyHits += legacy.find(c) != nullptr;
+    auto t2 = std::chrono::steady_clock::now();
+
+    TEST_ASSERT_EQUAL(legacyHits, hits);
+    TEST_ASSERT_EQUAL((size_t)ROUNDS * NAME_COUNT, hits);
+
+    double lookups = (double)ROUNDS * commands.size();
+    char msg[160];
+    snprintf(msg, sizeof(msg), "%zu actions: hash lookup %.1f ns, linear scan %.1f ns per dispatch", NAME_COUNT,
+             std::chrono::duration<double, std::nano>(t1 - t0).count() / lookups,
+             std::chrono::duration<double, std::nano>(t2 - t1).count() / lookups);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_find_by_first_word);
+    RUN_TEST(test_duplicate_name_is_refused);
+    RUN_TEST(test_grows_past_the_old_limit);
+    RUN_TEST(test_benchmark_dispatch);
+    UNITY_END();
+    return 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+
+// Declarations JsonWriter.h needs to compile natively. The native build has no
+// cJSON; the tests never reach it (no raw() in CBOR mode, no cJSON trees), so
+// nothing here is linked.
+typedef struct cJSON
+{
+    struct cJSON *next;
+    struct cJSON *prev;
+    struct cJSON *child;
+    int type;
+    char *valuestring;
+    int valueint;
+    double valuedouble;
+    char *string;
+} cJSON;
+
+cJSON *cJSON_ParseWithLength(const char *value, size_t buffer_length);
+void cJSON_Delete(cJSON *item);
+int cJSON_IsInvalid(const cJSON *item);
+int cJSON_IsFalse(const cJSON *item);
+int cJSON_IsTrue(const cJSON *item);
+int cJSON_IsBool(const cJSON *item);
+int cJSON_IsNull(const cJSON *item);
+int cJSON_IsNumber(const cJSON *item);
+int cJSON_IsString(const cJSON *item);
+int cJSON_IsArray(const cJSON *item);
+int cJSON_IsObject(const cJSON *item);
+int cJSON_IsRaw(const cJSON *item);
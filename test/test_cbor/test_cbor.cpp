@@ -0,0 +1,207 @@
+#include <unity.h>
+#include "../../src/utils/Cbor.h"
+#include "../../src/utils/JsonWriter.h"
+
+#include <chrono>
+
+static std::string hex(const uint8_t *data, size_t len)
+{
+    std::string out;
+    char byte[3];
+    for (size_t i = 0; i < len; i++)
+    {
+        snprintf(byte, sizeof(byte), "%02x", data[i]);
+        out += byte;
+    }
+    return out;
+}
+
+static std::string encodeInt(int64_t v)
+{
+    uint8_t buf[Cbor::MAX_HEAD];
+    return hex(buf, Cbor::integer(buf, v));
+}
+
+static std::string encodeNumber(double v)
+{
+    uint8_t buf[Cbor::MAX_HEAD];
+    return hex(buf, Cbor::number(buf, v));
+}
+
+// Examples from RFC 8949 appendix A
+void test_integers(void)
+{
+    TEST_ASSERT_EQUAL_STRING("00", encodeInt(0).c_str());
+    TEST_ASSERT_EQUAL_STRING("17", encodeInt(23).c_str());
+    TEST_ASSERT_EQUAL_STRING("1818", encodeInt(24).c_str());
+    TEST_ASSERT_EQUAL_STRING("1903e8", encodeInt(1000).c_str());
+    TEST_ASSERT_EQUAL_STRING("1a000f4240", encodeInt(1000000).c_str());
+    TEST_ASSERT_EQUAL_STRING("1b000000e8d4a51000", encodeInt(1000000000000).c_str());
+    TEST_ASSERT_EQUAL_STRING("20", encodeInt(-1).c_str());
+    TEST_ASSERT_EQUAL_STRING("3863", encodeInt(-100).c_str());
+    TEST_ASSERT_EQUAL_STRING("3903e7", encodeInt(-1000).c_str());
+}
+
+void test_numbers(void)
+{
+    TEST_ASSERT_EQUAL_STRING("1864", encodeNumber(100.0).c_str());
+    TEST_ASSERT_EQUAL_STRING("fa3fc00000", encodeNumber(1.5).c_str());
+    TEST_ASSERT_EQUAL_STRING("fb3ff199999999999a", encodeNumber(1.1).c_str());
+}
+
+static void append(std::string &doc, const uint8_t *data, size_t len)
+{
+    doc.append((const char *)data, len);
+}
+
+static void appendText(std::string &doc, const char *s)
+{
+    uint8_t buf[Cbor::MAX_HEAD];
+    append(doc, buf, Cbor::head(buf, Cbor::TEXT, strlen(s)));
+    doc += s;
+}
+
+void test_to_json(void)
+{
+    uint8_t buf[Cbor::MAX_HEAD];
+    std::string doc;
+    doc += (char)Cbor::BEGIN_MAP;
+    appendText(doc, "name");
+    appendText(doc, "say \"hi\"\n");
+    appendText(doc, "items");
+    doc += (char)Cbor::BEGIN_ARRAY;
+    append(doc, buf, Cbor::integer(buf, -7));
+    append(doc, buf, Cbor::number(buf, 2.5));
+    doc += (char)Cbor::TRUE_VALUE;
+    doc += (char)Cbor::NULL_VALUE;
+    doc += (char)Cbor::BREAK;
+    doc += (char)Cbor::BREAK;
+
+    std::string json;
+    TEST_ASSERT_TRUE(Cbor::toJson((const uint8_t *)doc.data(), doc.size(), json));
+    TEST_ASSERT_EQUAL_STRING("{\"name\":\"say \\\"hi\\\"\\u000a\",\"items\":[-7,2.5,true,null]}", json.c_str());
+
+    // every truncation is rejected
+    for (size_t len = 0; len < doc.size(); len++)
+    {
+        std::string partial;
+        TEST_ASSERT_FALSE(Cbor::toJson((const uint8_t *)doc.data(), len, partial));
+    }
+}
+
+// Representative action results: info, a 100-entry list page, a 100-record log
+static void infoDoc(JsonWriter &out)
+{
+    out.beginObject()
+        .field("chipModel", "ESP32-D0WD-V3")
+        .field("chipRevision", 3)
+        .field("cores", 2)
+        .field("cpuFreqMHz", 240)
+        .field("flashSize", 4194304)
+        .field("freeHeap", 183204)
+        .field("minFreeHeap", 151228)
+        .field("largestFreeBlock", 110580)
+        .field("uptimeMs", 8123456)
+        .field("idfVersion", "v5.5")
+        .field("ip", "192.168.1.42")
+        .field("rssi", -61)
+        .field("ssid", "sticky")
+        .field("mac", "24:6F:28:AA:BB:CC")
+        .field("sdMounted", true)
+        .field("temperature", 47.5)
+        .endObject();
+}
+
+static void listDoc(JsonWriter &out)
+{
+    out.beginObject().field("path", "/flash/apps").field("total", 100).key("entries").beginArray();
+    for (int i = 0; i < 100; i++)
+        out.beginObject()
+            .field("name", "file_" + std::to_string(i) + ".be")
+            .field("size", 1000 + i * 37)
+            .field("isDirectory", i % 10 == 0)
+            .field("mtime", 1700000000 + i * 60)
+            .endObject();
+    out.endArray().field("offset", 0).field("limit", 100).endObject();
+}
+
+static void logDoc(JsonWriter &out)
+{
+    out.beginArray();
+    for (int i = 0; i < 100; i++)
+        out.beginObject()
+            .field("severity", i % 7 ? "I" : "E")
+            .field("message", "WS connected: fd=" + std::to_string(50 + i))
+            .field("epochTime", 1700000000 + i)
+            .field("isoDateTime", "2023-11-14T22:13:20Z")
+            .endObject();
+    out.endArray();
+}
+
+template <typename Fn> static std::string encode(Fn fn, WireFormat format)
+{
+    std::string result;
+    JsonWriter out(
+        [&result](const char *data, size_t len, bool)
+        {
+            result.append(data, len);
+            return true;
+        },
+        1024, format);
+    fn(out);
+    out.finish();
+    return result;
+}
+
+template <typename Fn> static void benchmarkDocument(const char *name, Fn fn)
+{
+    std::string json = encode(fn, WireFormat::JSON);
+    std::string cbor = encode(fn, WireFormat::CBOR);
+    std::string back;
+    TEST_ASSERT_TRUE(Cbor::toJson((const uint8_t *)cbor.data(), cbor.size(), back));
+    TEST_ASSERT_EQUAL_STRING(json.c_str(), back.c_str());
+    TEST_ASSERT_TRUE(cbor.size() < json.size());
+
+    const int ROUNDS = 2000;
+    size_t total = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+        total += encode(fn, WireFormat::JSON).size();
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+        total += encode(fn, WireFormat::CBOR).size();
+    auto t2 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        back.clear();
+        total += Cbor::toJson((const uint8_t *)cbor.data(), cbor.size(), back);
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    TEST_ASSERT_TRUE(total > 0);
+
+    auto perRound = [ROUNDS](std::chrono::steady_clock::duration d)
+    { return std::chrono::duration<double, std::micro>(d).count() / ROUNDS; };
+    char msg[200];
+    snprintf(msg, sizeof(msg), "%-4s %5zu -> %5zu B (%.0f%%), encode json %.1f us, cbor %.1f us, cbor walk %.1f us",
+             name, json.size(), cbor.size(), 100.0 * cbor.size() / json.size(), perRound(t1 - t0), perRound(t2 - t1),
+             perRound(t3 - t2));
+    TEST_MESSAGE(msg);
+}
+
+void test_benchmark_encoding(void)
+{
+    benchmarkDocument("info", infoDoc);
+    benchmarkDocument("list", listDoc);
+    benchmarkDocument("log", logDoc);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_integers);
+    RUN_TEST(test_numbers);
+    RUN_TEST(test_to_json);
+    RUN_TEST(test_benchmark_encoding);
+    UNITY_END();
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <unity.h>
+#include "../../src/ActionRegistry/CommandBatch.h"
+
+void test_detects_batches(void)
+{
+    TEST_ASSERT_FALSE(isCommandBatch("screen clear"));
+    TEST_ASSERT_FALSE(isCommandBatch("screen clear\r\n"));
+    TEST_ASSERT_FALSE(isCommandBatch("  \n "));
+    TEST_ASSERT_TRUE(isCommandBatch("batch\nscreen clear\npage info"));
+    TEST_ASSERT_TRUE(isCommandBatch("\r\n batch onError=continue\r\ninfo"));
+    TEST_ASSERT_FALSE(isCommandBatch("batchy\ninfo"));
+    TEST_ASSERT_TRUE(isCommandBatch("[\"info\"]"));
+    TEST_ASSERT_TRUE(isCommandBatch(" {\"commands\": []}"));
+}
+
+void test_multi_line_arguments_are_not_batches(void)
+{
+    // one command whose argument spans lines: only the header makes a batch
+    TEST_ASSERT_FALSE(isCommandBatch("screen clear\npage info"));
+    TEST_ASSERT_FALSE(isCommandBatch("berry eval \"def f(x)\n  return x * 2\nend\nprint(f(21))\""));
+    TEST_ASSERT_FALSE(isCommandBatch("write /flash/notes.txt \"first\nsecond\n\""));
+}
+
+void test_parses_lines(void)
+{
+    CommandBatch batch;
+    std::string error;
+    TEST_ASSERT_TRUE(parseCommandLines("screen clear\r\n\n  page info\nscreen text 0 0 1 0 2 \"a b\"\n", batch, error));
+    TEST_ASSERT_EQUAL(3, batch.commands.size());
+    TEST_ASSERT_TRUE(batch.stopOnError);
+    TEST_ASSERT_EQUAL_STRING("page", batch.commands[1].str(0).c_str());
+    TEST_ASSERT_EQUAL_STRING("a b", batch.commands[2].str(7).c_str());
+}
+
+void test_batch_header_sets_error_mode(void)
+{
+    CommandBatch batch;
+    std::string error;
+    TEST_ASSERT_TRUE(parseCommandLines("batch onError=continue\ninfo\nmemory", batch, error));
+    TEST_ASSERT_FALSE(batch.stopOnError);
+    TEST_ASSERT_EQUAL(2, batch.commands.size());
+
+    CommandBatch bad;
+    TEST_ASSERT_FALSE(parseCommandLines("batch onError=later\ninfo", bad, error));
+    TEST_ASSERT_EQUAL_STRING("Invalid batch option: onError=later", error.c_str());
+}
+
+void test_batch_size_is_capped(void)
+{
+    std::string text;
+    for (int i = 0; i <= COMMAND_BATCH_MAX; i++)
+        text += "info\n";
+    CommandBatch batch;
+    std::string error;
+    TEST_ASSERT_FALSE(parseCommandLines(text, batch, error));
+    TEST_ASSERT_EQUAL(COMMAND_BATCH_MAX, batch.commands.size());
+}
+
+void test_inspects_results_without_parsing(void)
+{
+    BatchResultShape shape = inspectBatchResult("{\"error\": \"bad\"}");
+    TEST_ASSERT_TRUE(shape.json);
+    TEST_ASSERT_TRUE(shape.failed);
+
+    // only a top-level key counts, not a nested one or a value
+    shape = inspectBatchResult(" {\"entries\": [{\"error\": 1}], \"note\": \"error\"} ");
+    TEST_ASSERT_TRUE(shape.json);
+    TEST_ASSERT_FALSE(shape.failed);
+    shape = inspectBatchResult("[{\"error\": \"x\"}]");
+    TEST_ASSERT_TRUE(shape.json);
+    TEST_ASSERT_FALSE(shape.failed);
+
+    TEST_ASSERT_TRUE(inspectBatchResult("{\"a\": [1, -2.5e3, true, false, null, \"q\\\"}\"]}").json);
+    TEST_ASSERT_TRUE(inspectBatchResult("42").json);
+    TEST_ASSERT_FALSE(inspectBatchResult("Written.").json);
+    TEST_ASSERT_FALSE(inspectBatchResult("{\"a\": 1").json);
+    TEST_ASSERT_FALSE(inspectBatchResult("{\"a\": 1} trailing").json);
+    TEST_ASSERT_FALSE(inspectBatchResult("").json);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_detects_batches);
+    RUN_TEST(test_multi_line_arguments_are_not_batches);
+    RUN_TEST(test_parses_lines);
+    RUN_TEST(test_batch_header_sets_error_mode);
+    RUN_TEST(test_batch_size_is_capped);
+    RUN_TEST(test_inspects_results_without_parsing);
+    UNITY_END();
+    return 0;
+}
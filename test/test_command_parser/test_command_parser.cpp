@@ -1,5 +1,6 @@
 #include <unity.h>
 #include "../../src/CommandInterpreter/CommandParser.h"
+#include "../../src/CommandInterpreter/CommandArgs.h"
 
 void test_get_command_name_single_word(void)
 {
@@ -51,6 +52,65 @@ void test_get_parameter_multiple_spaces_between(void)
     TEST_ASSERT_EQUAL_STRING("bar", CommandParser::getCommandParameter("foo   bar", 1).c_str());
 }
 
+void test_args_words(void)
+{
+    CommandArgs args("screen  text\t10 20");
+    TEST_ASSERT_EQUAL(4, args.size());
+    TEST_ASSERT_EQUAL_STRING("screen", args.str(0).c_str());
+    TEST_ASSERT_EQUAL_STRING("text", args.str(1).c_str());
+    TEST_ASSERT_EQUAL_STRING("20", args.str(3).c_str());
+    TEST_ASSERT_FALSE(args.has(4));
+    TEST_ASSERT_TRUE(args.at(4).empty());
+    TEST_ASSERT_EQUAL_STRING("screen  text\t10 20", args.command().c_str());
+}
+
+void test_args_quoted_words(void)
+{
+    CommandArgs args("wifi connect \"My Network\" 'pass word' text=\"a b\" \"say \\\"hi\\\"\" \"\"");
+    TEST_ASSERT_EQUAL(7, args.size());
+    TEST_ASSERT_EQUAL_STRING("My Network", args.str(2).c_str());
+    TEST_ASSERT_EQUAL_STRING("pass word", args.str(3).c_str());
+    TEST_ASSERT_EQUAL_STRING("text=a b", args.str(4).c_str());
+    TEST_ASSERT_EQUAL_STRING("say \"hi\"", args.str(5).c_str());
+    TEST_ASSERT_TRUE(args.has(6));
+    TEST_ASSERT_TRUE(args.at(6).empty());
+}
+
+void test_args_rest_is_raw(void)
+{
+    CommandArgs args("berry eval  print(\"a  b\")");
+    TEST_ASSERT_EQUAL_STRING("print(\"a  b\")", std::string(args.rest(2)).c_str());
+    TEST_ASSERT_TRUE(args.rest(3).empty());
+}
+
+void test_args_numbers(void)
+{
+    CommandArgs args("x 42 -7 0x1F 1F abc 12px #FF0000 #00FF00 0xF800");
+    TEST_ASSERT_EQUAL(42, args.toInt(1));
+    TEST_ASSERT_EQUAL(-7, args.toInt(2));
+    TEST_ASSERT_EQUAL(31, args.toInt(3));
+    TEST_ASSERT_EQUAL(5, args.toInt(5, 5));
+    TEST_ASSERT_EQUAL(5, args.toInt(6, 5));
+    TEST_ASSERT_EQUAL(5, args.toInt(99, 5));
+    TEST_ASSERT_EQUAL_HEX32(0x1F, args.toHex(3));
+    TEST_ASSERT_EQUAL_HEX32(0x1F, args.toHex(4));
+    TEST_ASSERT_EQUAL_HEX16(0xF800, args.toColor(7));
+    TEST_ASSERT_EQUAL_HEX16(0x07E0, args.toColor(8));
+    TEST_ASSERT_EQUAL_HEX16(0xF800, args.toColor(9));
+    TEST_ASSERT_EQUAL_HEX16(0x1234, args.toColor(5, 0x1234));
+}
+
+void test_args_copy_keeps_words(void)
+{
+    CommandArgs copy;
+    {
+        CommandArgs args(std::string("ws \"quoted word\" plain"));
+        copy = args;
+    }
+    TEST_ASSERT_EQUAL_STRING("quoted word", copy.str(1).c_str());
+    TEST_ASSERT_EQUAL_STRING("plain", copy.str(2).c_str());
+}
+
 int main(int argc, char **argv)
 {
     UNITY_BEGIN();
@@ -64,6 +124,11 @@ int main(int argc, char **argv)
     RUN_TEST(test_get_parameter_nullptr);
     RUN_TEST(test_get_command_name_with_trailing_spaces);
     RUN_TEST(test_get_parameter_multiple_spaces_between);
+    RUN_TEST(test_args_words);
+    RUN_TEST(test_args_quoted_words);
+    RUN_TEST(test_args_rest_is_raw);
+    RUN_TEST(test_args_numbers);
+    RUN_TEST(test_args_copy_keeps_words);
     UNITY_END();
     return 0;
 }
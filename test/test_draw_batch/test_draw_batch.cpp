@@ -0,0 +1,134 @@
+#include <unity.h>
+#include "../../src/FeatureRegistry/Features/UI/DrawBatch.h"
+
+#include <vector>
+
+using namespace UI;
+
+// Records calls instead of drawing
+struct FakeGfx
+{
+    int calls = 0;
+    void drawPixel(int, int, uint16_t) { calls++; }
+    void drawRect(int, int, int, int, uint16_t) { calls++; }
+    void fillRect(int, int, int, int, uint16_t) { calls++; }
+    void drawCircle(int, int, int, uint16_t) { calls++; }
+    void fillCircle(int, int, int, uint16_t) { calls++; }
+    void drawLine(int, int, int, int, uint16_t) { calls++; }
+    void setCursor(int, int) {}
+    void setTextColor(uint16_t, uint16_t) {}
+    void setTextSize(int) {}
+    void print(const char *) { calls++; }
+    void fillScreen(uint16_t) { calls++; }
+};
+
+struct BatchBuilder
+{
+    std::vector<uint8_t> data;
+
+    BatchBuilder &op(uint8_t code)
+    {
+        data.push_back(code);
+        return *this;
+    }
+
+    BatchBuilder &i16(int16_t v)
+    {
+        data.push_back(v & 0xFF);
+        data.push_back((uint16_t)v >> 8);
+        return *this;
+    }
+};
+
+static void run(const BatchBuilder &b, int expectedOps, DrawRows &rows)
+{
+    std::string error;
+    TEST_ASSERT_EQUAL(expectedOps, validateDrawBatch(b.data.data(), b.data.size(), error));
+    FakeGfx gfx;
+    rows = runDrawBatch(gfx, b.data.data(), b.data.size());
+    TEST_ASSERT_EQUAL(expectedOps, gfx.calls);
+}
+
+void test_rows_cover_each_op(void)
+{
+    BatchBuilder b;
+    b.op(DRAW_PIXEL).i16(5).i16(40).i16(0xFFFF);
+    DrawRows rows;
+    run(b, 1, rows);
+    TEST_ASSERT_EQUAL(40, rows.y0);
+    TEST_ASSERT_EQUAL(41, rows.y1);
+
+    b.op(DRAW_FILL_RECT).i16(0).i16(50).i16(10).i16(20).i16(0);
+    b.op(DRAW_LINE).i16(0).i16(90).i16(10).i16(30).i16(0);
+    run(b, 3, rows);
+    TEST_ASSERT_EQUAL(30, rows.y0);
+    TEST_ASSERT_EQUAL(91, rows.y1);
+}
+
+void test_negative_extents_are_normalised(void)
+{
+    // LovyanGFX draws a negative height upwards and a negative radius as its magnitude
+    BatchBuilder rect;
+    rect.op(DRAW_RECT).i16(10).i16(100).i16(-20).i16(-30).i16(0);
+    DrawRows rows;
+    run(rect, 1, rows);
+    TEST_ASSERT_EQUAL(70, rows.y0);
+    TEST_ASSERT_EQUAL(100, rows.y1);
+
+    BatchBuilder circle;
+    circle.op(DRAW_FILL_CIRCLE).i16(50).i16(60).i16(-8).i16(0);
+    run(circle, 1, rows);
+    TEST_ASSERT_EQUAL(52, rows.y0);
+    TEST_ASSERT_EQUAL(69, rows.y1);
+
+    DrawRows direct;
+    direct.addRect(10, 0);
+    TEST_ASSERT_TRUE(direct.y0 >= direct.y1); // nothing drawn, nothing sent
+}
+
+void test_clear_and_text_reach_the_bottom(void)
+{
+    BatchBuilder text;
+    text.op(DRAW_TEXT).i16(0).i16(200).i16(0xFFFF).i16(0);
+    text.data.push_back(2);
+    text.data.push_back(2);
+    text.data.push_back('h');
+    text.data.push_back('i');
+    DrawRows rows;
+    run(text, 1, rows);
+    TEST_ASSERT_EQUAL(200, rows.y0);
+    TEST_ASSERT_EQUAL(INT_MAX, rows.y1);
+
+    BatchBuilder clear;
+    clear.op(DRAW_CLEAR).i16(0);
+    run(clear, 1, rows);
+    TEST_ASSERT_EQUAL(INT_MIN, rows.y0);
+    TEST_ASSERT_EQUAL(INT_MAX, rows.y1);
+}
+
+void test_malformed_batches_are_rejected(void)
+{
+    std::string error;
+    const uint8_t unknown[] = {0x42};
+    TEST_ASSERT_EQUAL(-1, validateDrawBatch(unknown, sizeof(unknown), error));
+    TEST_ASSERT_EQUAL_STRING("unknown opcode 66 at op 0", error.c_str());
+
+    const uint8_t truncated[] = {DRAW_PIXEL, 1, 0, 2};
+    TEST_ASSERT_EQUAL(-1, validateDrawBatch(truncated, sizeof(truncated), error));
+    TEST_ASSERT_EQUAL_STRING("truncated op 0", error.c_str());
+
+    const uint8_t shortText[] = {DRAW_TEXT, 0, 0, 0, 0, 0, 0, 0, 0, 1, 5, 'a'};
+    TEST_ASSERT_EQUAL(-1, validateDrawBatch(shortText, sizeof(shortText), error));
+    TEST_ASSERT_EQUAL_STRING("truncated text in op 0", error.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rows_cover_each_op);
+    RUN_TEST(test_negative_extents_are_normalised);
+    RUN_TEST(test_clear_and_text_reach_the_bottom);
+    RUN_TEST(test_malformed_batches_are_rejected);
+    UNITY_END();
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <unity.h>
+#include "../../src/utils/LogLevel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Stands in for Logger: same threshold check, records what reached it. Only
+// the line formatting of the real handle() is copied; the ring write, its
+// mutex, the console output and listener dispatch need FreeRTOS and are not
+// part of this build.
+struct FakeLogger
+{
+    uint8_t level = LOG_LEVEL_INFO;
+    int calls = 0;
+    size_t bytes = 0;
+    UtcTimeCache utcTime;
+    time_t now = 1700000000;
+
+    bool isEnabled(uint8_t l) const
+    {
+        return l >= level;
+    }
+
+    void log(uint8_t l, const std::string &message)
+    {
+        char line[160];
+        snprintf(line, sizeof(line), "[%c] %s - %s", logLevelSeverity(l), utcTime.format(now), message.c_str());
+        bytes += strlen(line);
+        calls++;
+    }
+};
+
+static int evaluated = 0;
+
+static std::string expensiveMessage(int i)
+{
+    evaluated++;
+    return "value " + std::to_string(i) + " of " + std::to_string(i * 7);
+}
+
+void test_filtered_level_skips_formatting(void)
+{
+    FakeLogger logger;
+    evaluated = 0;
+    LOG_AT_WITH(&logger, LOG_LEVEL_DEBUG, expensiveMessage(1));
+    TEST_ASSERT_EQUAL(0, evaluated);
+    TEST_ASSERT_EQUAL(0, logger.calls);
+
+    LOG_AT_WITH(&logger, LOG_LEVEL_ERROR, expensiveMessage(2));
+    TEST_ASSERT_EQUAL(1, evaluated);
+    TEST_ASSERT_EQUAL(1, logger.calls);
+
+    logger.level = LOG_LEVEL_DEBUG;
+    LOG_AT_WITH(&logger, LOG_LEVEL_DEBUG, expensiveMessage(3));
+    TEST_ASSERT_EQUAL(2, evaluated);
+    TEST_ASSERT_EQUAL(2, logger.calls);
+}
+
+void test_parse_level_names(void)
+{
+    uint8_t level = 99;
+    TEST_ASSERT_TRUE(parseLogLevel("debug", level));
+    TEST_ASSERT_EQUAL(LOG_LEVEL_DEBUG, level);
+    TEST_ASSERT_TRUE(parseLogLevel("error", level));
+    TEST_ASSERT_EQUAL(LOG_LEVEL_ERROR, level);
+    TEST_ASSERT_FALSE(parseLogLevel("verbose", level));
+    TEST_ASSERT_EQUAL('I', logLevelSeverity(LOG_LEVEL_INFO));
+    TEST_ASSERT_EQUAL_STRING("debug", logLevelName(LOG_LEVEL_DEBUG));
+}
+
+void test_utc_cache_matches_strftime(void)
+{
+    UtcTimeCache cache;
+    const time_t times[] = {0, 1700000000, 1700000000, 1700000001, 1699999999, 4102444800};
+    for (time_t t : times)
+    {
+        char expected[UtcTimeCache::SIZE];
+        struct tm timeinfo;
+        gmtime_r(&t, &timeinfo);
+        strftime(expected, sizeof(expected), "%FT%TZ", &timeinfo);
+        TEST_ASSERT_EQUAL_STRING(expected, cache.format(t));
+    }
+}
+
+// The previous per-call work: timestamp through a fresh std::string, severity
+// compared as a string, message always built by the caller
+static std::string legacyUtcTime(time_t rawtime)
+{
+    char buffer[80];
+    struct tm *timeinfo = gmtime(&rawtime);
+    strftime(buffer, 80, "%FT%TZ", timeinfo);
+    return buffer;
+}
+
+static size_t legacyLog(const std::string &severity, const std::string &message, time_t now)
+{
+    std::string utcTime(legacyUtcTime(now).c_str());
+    char line[160];
+    if (severity == "E")
+        snprintf(line, sizeof(line), "[%s] %s - %s", severity.c_str(), utcTime.c_str(), message.c_str());
+    else if (severity == "D")
+        snprintf(line, sizeof(line), "[%s] %s - %s", severity.c_str(), utcTime.c_str(), message.c_str());
+    else
+        snprintf(line, sizeof(line), "[%s] %s - %s", severity.c_str(), utcTime.c_str(), message.c_str());
+    return strlen(line);
+}
+
+// Measures the caller side of logging against FakeLogger, not the real
+// Logger::handle(), so the numbers leave out the ring write and dispatch:
+// - legacy: the old eager call, message built and timestamp formatted
+//   through std::string every time
+// - filtered debug: LOG_AT_WITH below the level, i.e. the saving of not
+//   building the message at all
+// - enabled: the message built and a line formatted with the cached timestamp
+// The first two differ mostly in the message construction the macro skips.
+void test_benchmark_per_call(void)
+{
+    const int N = 200000;
+    FakeLogger logger;
+    size_t legacyBytes = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++)
+        legacyBytes += legacyLog("D", expensiveMessage(i), logger.now + i / 1000);
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++)
+        LOG_AT_WITH(&logger, LOG_LEVEL_DEBUG, expensiveMessage(i)); // filtered at runtime
+    auto t2 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++)
+    {
+        logger.now = 1700000000 + i / 1000;
+        LOG_AT_WITH(&logger, LOG_LEVEL_INFO, expensiveMessage(i));
+    }
+    auto t3 = std::chrono::steady_clock::now();
+
+    TEST_ASSERT_EQUAL(N, logger.calls);
+    TEST_ASSERT_TRUE(legacyBytes > 0);
+
+    auto ns = [N](std::chrono::steady_clock::duration d)
+    { return std::chrono::duration<double, std::nano>(d).count() / N; };
+    char msg[200];
+    snprintf(msg, sizeof(msg), "per call (fake logger): legacy %.0f ns, filtered debug %.1f ns, enabled with cached time %.0f ns",
+             ns(t1 - t0), ns(t2 - t1), ns(t3 - t2));
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_filtered_level_skips_formatting);
+    RUN_TEST(test_parse_level_names);
+    RUN_TEST(test_utc_cache_matches_strftime);
+    RUN_TEST(test_benchmark_per_call);
+    UNITY_END();
+    return 0;
+}
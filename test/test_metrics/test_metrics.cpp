@@ -0,0 +1,90 @@
+#include <unity.h>
+#include "../../src/utils/Metrics.h"
+
+#include <string>
+
+static const uint32_t TEST_BOUNDS[] = {10, 100};
+
+static Counter requests("test_requests_total", "Requests handled", "transport=\"rest\"");
+static Counter wsRequests("test_requests_total", "Requests handled", "transport=\"ws\"");
+static Gauge level("test_level", "A level");
+static Gauge readLevel("test_read_level", "A level read at scrape time", nullptr, []() { return 1.5; });
+static Histogram latency("test_latency_seconds", "Latency", nullptr, TEST_BOUNDS, 1e-3);
+
+static std::string scrape(size_t *chunks = nullptr)
+{
+    std::string text;
+    MetricsWriter out(
+        [&](const char *data, size_t len)
+        {
+            text.append(data, len);
+            if (chunks != nullptr)
+                (*chunks)++;
+            return true;
+        });
+    Metric::writeAll(out);
+    return text;
+}
+
+static bool contains(const std::string &text, const char *part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+void test_counters_share_a_family(void)
+{
+    requests.inc();
+    requests.inc(2);
+    wsRequests.inc();
+    std::string text = scrape();
+
+    TEST_ASSERT_TRUE(contains(text, "test_requests_total{transport=\"rest\"} 3\n"));
+    TEST_ASSERT_TRUE(contains(text, "test_requests_total{transport=\"ws\"} 1\n"));
+    size_t first = text.find("# TYPE test_requests_total counter\n");
+    TEST_ASSERT_TRUE(first != std::string::npos);
+    TEST_ASSERT_TRUE(text.find("# TYPE test_requests_total", first + 1) == std::string::npos);
+}
+
+void test_gauges(void)
+{
+    level.set(7);
+    level.add(-2);
+    std::string text = scrape();
+    TEST_ASSERT_TRUE(contains(text, "# TYPE test_level gauge\ntest_level 5\n"));
+    TEST_ASSERT_TRUE(contains(text, "test_read_level 1.5\n"));
+}
+
+void test_histogram_buckets_are_cumulative(void)
+{
+    latency.observe(5);
+    latency.observe(10);
+    latency.observe(50);
+    latency.observe(1000);
+    TEST_ASSERT_EQUAL(4, latency.count());
+
+    std::string text = scrape();
+    TEST_ASSERT_TRUE(contains(text, "test_latency_seconds_bucket{le=\"0.01\"} 2\n"
+                                    "test_latency_seconds_bucket{le=\"0.1\"} 3\n"
+                                    "test_latency_seconds_bucket{le=\"+Inf\"} 4\n"
+                                    "test_latency_seconds_sum 1.065\n"
+                                    "test_latency_seconds_count 4\n"));
+}
+
+void test_output_is_chunked(void)
+{
+    size_t chunks = 0;
+    std::string text = scrape(&chunks);
+    TEST_ASSERT_TRUE(text.size() > 512);
+    TEST_ASSERT_EQUAL((text.size() + 511) / 512, chunks);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_counters_share_a_family);
+    RUN_TEST(test_gauges);
+    RUN_TEST(test_histogram_buckets_are_cumulative);
+    RUN_TEST(test_output_is_chunked);
+    UNITY_END();
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <unity.h>
+#include "../../src/FeatureRegistry/Features/UI/MirrorCodec.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// Decodes one row the way a viewer does, -1 if the data is malformed
+static int decodeRow(const std::vector<uint8_t> &in, size_t &pos, uint16_t *px, int n)
+{
+    int done = 0;
+    while (done < n)
+    {
+        if (pos >= in.size())
+            return -1;
+        uint8_t c = in[pos++];
+        int count = c < 128 ? c + 1 : c - 125;
+        bool repeat = c >= 128;
+        if (done + count > n)
+            return -1;
+        for (int k = 0; k < count; k++)
+        {
+            if (!repeat || k == 0)
+            {
+                if (pos + 2 > in.size())
+                    return -1;
+                memcpy(&px[done + k], &in[pos], 2);
+                pos += 2;
+            }
+            else
+            {
+                px[done + k] = px[done];
+            }
+        }
+        done += count;
+    }
+    return done;
+}
+
+static void assertRoundTrip(const std::vector<uint16_t> &row)
+{
+    std::vector<uint8_t> out;
+    UI::encodeMirrorRow(out, row.data(), (int)row.size());
+    std::vector<uint16_t> back(row.size(), 0xDEAD);
+    size_t pos = 0;
+    TEST_ASSERT_EQUAL((int)row.size(), decodeRow(out, pos, back.data(), (int)back.size()));
+    TEST_ASSERT_EQUAL(out.size(), pos);
+    TEST_ASSERT_EQUAL_MEMORY(row.data(), back.data(), row.size() * 2);
+}
+
+void test_round_trips_short_rows(void)
+{
+    assertRoundTrip({0x1234});
+    assertRoundTrip({0x1234, 0x1234});
+    assertRoundTrip({0x1234, 0x5678});
+    assertRoundTrip({7, 7, 7});
+    assertRoundTrip({1, 7, 7, 7, 2});
+    assertRoundTrip({1, 1, 2, 2, 3, 3});
+}
+
+void test_round_trips_long_runs_and_literals(void)
+{
+    for (int n : {129, 130, 131, 132, 133, 260, 320})
+    {
+        assertRoundTrip(std::vector<uint16_t>(n, 0xF800));
+
+        std::vector<uint16_t> literals(n);
+        for (int i = 0; i < n; i++)
+            literals[i] = (uint16_t)i;
+        assertRoundTrip(literals);
+    }
+}
+
+void test_round_trips_random_rows(void)
+{
+    srand(38);
+    for (int r = 0; r < 500; r++)
+    {
+        // few colours give a mix of runs and literals of every length
+        std::vector<uint16_t> row(1 + rand() % 320);
+        int colours = 1 + rand() % 4;
+        uint16_t px = 0;
+        for (auto &p : row)
+        {
+            if (rand() % 8 == 0)
+                px = (uint16_t)(rand() % colours);
+            p = px;
+        }
+        assertRoundTrip(row);
+    }
+}
+
+void test_runs_are_compact(void)
+{
+    std::vector<uint8_t> out;
+    std::vector<uint16_t> row(320, 0x001F);
+    UI::encodeMirrorRow(out, row.data(), (int)row.size());
+    // 130 + 130 + 60: three control bytes and three pixels
+    TEST_ASSERT_EQUAL(9, out.size());
+    TEST_ASSERT_EQUAL(255, out[0]);
+    TEST_ASSERT_EQUAL(185, out[6]);
+}
+
+void test_hash_sees_single_pixel_changes(void)
+{
+    std::vector<uint16_t> seg(32, 0);
+    uint32_t base = UI::hashMirrorSegment(seg.data(), 32);
+    for (int i = 0; i < 32; i++)
+    {
+        seg[i] = 1;
+        TEST_ASSERT_NOT_EQUAL(base, UI::hashMirrorSegment(seg.data(), 32));
+        seg[i] = 0;
+    }
+    TEST_ASSERT_EQUAL(base, UI::hashMirrorSegment(seg.data(), 32));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trips_short_rows);
+    RUN_TEST(test_round_trips_long_runs_and_literals);
+    RUN_TEST(test_round_trips_random_rows);
+    RUN_TEST(test_runs_are_compact);
+    RUN_TEST(test_hash_sees_single_pixel_changes);
+    UNITY_END();
+    return 0;
+}
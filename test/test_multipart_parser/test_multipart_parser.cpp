@@ -0,0 +1,271 @@
+#include <unity.h>
+#include "../../src/utils/MultipartStream.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+static const std::string BOUNDARY = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+
+struct Part
+{
+    std::string name;
+    std::string fileName;
+    std::string data;
+};
+
+static std::string buildBody(const std::vector<Part> &parts)
+{
+    std::string body = "preamble to ignore\r\n";
+    for (const auto &p : parts)
+    {
+        body += "--" + BOUNDARY + "\r\n";
+        body += "Content-Disposition: form-data; name=\"" + p.name + "\"";
+        if (!p.fileName.empty())
+            body += "; filename=\"" + p.fileName + "\"\r\nContent-Type: application/octet-stream";
+        body += "\r\n\r\n" + p.data + "\r\n";
+    }
+    body += "--" + BOUNDARY + "--\r\n";
+    return body;
+}
+
+// Feeds the body in reads of at most chunk bytes
+static MultipartReadFn reader(const std::string &body, size_t chunk, size_t &offset)
+{
+    return [&body, chunk, &offset](uint8_t *dst, size_t max) -> int
+    {
+        size_t n = body.size() - offset;
+        if (n > max)
+            n = max;
+        if (n > chunk)
+            n = chunk;
+        memcpy(dst, body.data() + offset, n);
+        offset += n;
+        return (int)n;
+    };
+}
+
+struct Collected
+{
+    std::vector<Part> parts;
+    int finals = 0;
+    bool orderOk = true;
+};
+
+static MultipartStream::Result parseAll(const std::string &body, size_t chunk, Collected &out)
+{
+    size_t offset = 0;
+    MultipartStream parser(BOUNDARY);
+    return parser.parse(
+        reader(body, chunk, offset),
+        [&](const std::string &name, const std::string &value) { out.parts.push_back({name, "", value}); },
+        [&](const std::string &name, const std::string &fileName, const uint8_t *data, size_t len, bool isFirst,
+            bool isFinal) -> bool
+        {
+            if (isFirst)
+                out.parts.push_back({name, fileName, ""});
+            else if (out.parts.empty() || out.parts.back().fileName != fileName)
+                out.orderOk = false;
+            out.parts.back().data.append((const char *)data, len);
+            if (isFinal)
+                out.finals++;
+            return true;
+        });
+}
+
+static std::string randomData(size_t len, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::string s(len, '\0');
+    for (auto &c : s)
+        c = (char)(rng() & 0xFF);
+    // sprinkle near-miss delimiters into the payload
+    std::string nearMiss = "\r\n--" + BOUNDARY.substr(0, BOUNDARY.size() - 1) + "X";
+    for (size_t pos = 777; pos + nearMiss.size() < len; pos += 50000)
+        s.replace(pos, nearMiss.size(), nearMiss);
+    return s;
+}
+
+void test_fields_and_file(void)
+{
+    std::vector<Part> parts = {{"path", "", "/flash/a.txt"}, {"file", "a.txt", "hello world"}};
+    Collected c;
+    TEST_ASSERT_EQUAL(MultipartStream::OK, parseAll(buildBody(parts), 4096, c));
+    TEST_ASSERT_EQUAL(2, c.parts.size());
+    TEST_ASSERT_EQUAL_STRING("path", c.parts[0].name.c_str());
+    TEST_ASSERT_EQUAL_STRING("/flash/a.txt", c.parts[0].data.c_str());
+    TEST_ASSERT_EQUAL_STRING("a.txt", c.parts[1].fileName.c_str());
+    TEST_ASSERT_EQUAL_STRING("hello world", c.parts[1].data.c_str());
+    TEST_ASSERT_EQUAL(1, c.finals);
+}
+
+void test_empty_file(void)
+{
+    Collected c;
+    TEST_ASSERT_EQUAL(MultipartStream::OK, parseAll(buildBody({{"file", "empty.bin", ""}}), 4096, c));
+    TEST_ASSERT_EQUAL(1, c.parts.size());
+    TEST_ASSERT_EQUAL(0, c.parts[0].data.size());
+    TEST_ASSERT_EQUAL(1, c.finals);
+}
+
+void test_split_at_every_read_size(void)
+{
+    std::vector<Part> parts = {{"basePath", "", "/sd/x"},
+                               {"file", "one.bin", randomData(5000, 1)},
+                               {"file", "two.bin", randomData(3000, 2)}};
+    std::string body = buildBody(parts);
+
+    // every split of the delimiter and header terminator across reads, up to
+    // reads that fill the whole window
+    for (size_t chunk = 1; chunk <= MULTIPART_WINDOW_SIZE; chunk++)
+    {
+        Collected c;
+        TEST_ASSERT_EQUAL(MultipartStream::OK, parseAll(body, chunk, c));
+        TEST_ASSERT_TRUE(c.orderOk);
+        TEST_ASSERT_EQUAL(3, c.parts.size());
+        TEST_ASSERT_EQUAL_STRING("/sd/x", c.parts[0].data.c_str());
+        TEST_ASSERT_TRUE(parts[1].data == c.parts[1].data);
+        TEST_ASSERT_TRUE(parts[2].data == c.parts[2].data);
+        TEST_ASSERT_EQUAL(2, c.finals);
+    }
+}
+
+void test_abort_from_callback(void)
+{
+    std::string body = buildBody({{"file", "big.bin", randomData(20000, 3)}});
+    size_t offset = 0;
+    MultipartStream parser(BOUNDARY);
+    auto result = parser.parse(reader(body, 2048, offset), nullptr,
+                               [](const std::string &, const std::string &, const uint8_t *, size_t, bool, bool)
+                               { return false; });
+    TEST_ASSERT_EQUAL(MultipartStream::ABORTED, result);
+}
+
+void test_truncated_body_flushes_part(void)
+{
+    std::string body = buildBody({{"file", "cut.bin", "abcdefgh"}});
+    body = body.substr(0, body.find("abcdefgh") + 8);
+    Collected c;
+    TEST_ASSERT_EQUAL(MultipartStream::OK, parseAll(body, 4096, c));
+    TEST_ASSERT_EQUAL(1, c.parts.size());
+    TEST_ASSERT_EQUAL_STRING("abcdefgh", c.parts[0].data.c_str());
+    TEST_ASSERT_EQUAL(1, c.finals);
+}
+
+// The previous implementation: append every read to a std::string, find() the
+// delimiter, erase() what was consumed. Kept here as the benchmark baseline.
+static size_t legacyParse(const std::string &body, size_t chunk)
+{
+    std::string marker = "\r\n--" + BOUNDARY;
+    std::string first = "--" + BOUNDARY + "\r\n";
+    std::string buffer;
+    size_t offset = 0, consumed = 0;
+    int state = 0; // 0 preamble, 1 header, 2 body, 3 after boundary
+    while (true)
+    {
+        bool progress = true;
+        while (progress)
+        {
+            progress = false;
+            if (state == 0)
+            {
+                size_t pos = buffer.find(first);
+                if (pos != std::string::npos)
+                {
+                    buffer.erase(0, pos + first.size());
+                    state = 1;
+                    progress = true;
+                }
+            }
+            if (state == 1)
+            {
+                size_t pos = buffer.find("\r\n\r\n");
+                if (pos != std::string::npos)
+                {
+                    std::string headers = buffer.substr(0, pos);
+                    buffer.erase(0, pos + 4);
+                    state = 2;
+                    progress = true;
+                }
+            }
+            if (state == 2)
+            {
+                size_t pos = buffer.find(marker);
+                if (pos != std::string::npos)
+                {
+                    consumed += pos;
+                    buffer.erase(0, pos + marker.size());
+                    state = 3;
+                    progress = true;
+                }
+                else if (buffer.size() > marker.size())
+                {
+                    size_t safe = buffer.size() - marker.size();
+                    consumed += safe;
+                    buffer.erase(0, safe);
+                }
+            }
+            if (state == 3 && buffer.size() >= 2)
+            {
+                if (buffer[0] == '-' && buffer[1] == '-')
+                    return consumed;
+                buffer.erase(0, 2);
+                state = 1;
+                progress = true;
+            }
+        }
+        if (offset >= body.size())
+            return consumed;
+        size_t n = body.size() - offset < chunk ? body.size() - offset : chunk;
+        buffer.append(body.data() + offset, n);
+        offset += n;
+    }
+}
+
+void test_benchmark_throughput(void)
+{
+    const size_t sizes[] = {1 << 20, 4 << 20, 8 << 20};
+    for (size_t size : sizes)
+    {
+        std::string body = buildBody({{"file", "bench.bin", randomData(size, 42)}});
+
+        size_t bytes = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        size_t offset = 0;
+        MultipartStream parser(BOUNDARY);
+        auto result = parser.parse(reader(body, 2048, offset), nullptr,
+                                   [&](const std::string &, const std::string &, const uint8_t *, size_t len, bool,
+                                       bool)
+                                   {
+                                       bytes += len;
+                                       return true;
+                                   });
+        auto t1 = std::chrono::steady_clock::now();
+        size_t legacyBytes = legacyParse(body, 2048);
+        auto t2 = std::chrono::steady_clock::now();
+
+        TEST_ASSERT_EQUAL(MultipartStream::OK, result);
+        TEST_ASSERT_EQUAL(size, bytes);
+        TEST_ASSERT_EQUAL(size, legacyBytes);
+
+        double sec = std::chrono::duration<double>(t1 - t0).count();
+        double legacySec = std::chrono::duration<double>(t2 - t1).count();
+        char msg[160];
+        snprintf(msg, sizeof(msg), "%zu MB body: window/BMH %.1f MB/s, string/find %.1f MB/s", size >> 20,
+                 body.size() / sec / 1e6, body.size() / legacySec / 1e6);
+        TEST_MESSAGE(msg);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fields_and_file);
+    RUN_TEST(test_empty_file);
+    RUN_TEST(test_split_at_every_read_size);
+    RUN_TEST(test_abort_from_callback);
+    RUN_TEST(test_truncated_body_flushes_part);
+    RUN_TEST(test_benchmark_throughput);
+    UNITY_END();
+    return 0;
+}
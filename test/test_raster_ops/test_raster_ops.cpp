@@ -0,0 +1,293 @@
+#include <unity.h>
+#include "../../src/FeatureRegistry/Features/UI/RasterOps.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using UI::Raster::Surface;
+
+// A surface with its own buffer, rows padded like a sprite's
+struct Canvas
+{
+    std::vector<uint8_t> data;
+    Surface s;
+
+    Canvas(int width, int height, int bpp)
+    {
+        s.width = width;
+        s.height = height;
+        s.bpp = bpp;
+        s.stride = (width * bpp + 7) / 8;
+        data.assign((size_t)s.stride * height, 0);
+        s.buf = data.data();
+    }
+
+    Canvas(const Canvas &other) : data(other.data), s(other.s)
+    {
+        s.buf = data.data();
+    }
+};
+
+static void randomize(Canvas &c, unsigned seed, int values)
+{
+    srand(seed);
+    for (int y = 0; y < c.s.height; y++)
+        for (int x = 0; x < c.s.width; x++)
+            c.s.set(x, y, rand() % values);
+}
+
+// Pixel by pixel, breadth first: slow but obviously right
+static uint32_t referenceFill(const Surface &s, int x, int y, uint32_t fillRaw)
+{
+    uint32_t target = s.get(x, y);
+    if (target == fillRaw)
+        return 0;
+    std::vector<std::pair<int, int>> queue = {{x, y}};
+    s.set(x, y, fillRaw);
+    uint32_t filled = 0;
+    for (size_t i = 0; i < queue.size(); i++)
+    {
+        filled++;
+        static const int DX[] = {1, -1, 0, 0}, DY[] = {0, 0, 1, -1};
+        for (int d = 0; d < 4; d++)
+        {
+            int nx = queue[i].first + DX[d], ny = queue[i].second + DY[d];
+            if (s.contains(nx, ny) && s.get(nx, ny) == target)
+            {
+                s.set(nx, ny, fillRaw);
+                queue.push_back({nx, ny});
+            }
+        }
+    }
+    return filled;
+}
+
+static void referenceBlit(const Surface &dst, int dx, int dy, const Surface &src, int sx, int sy, int w, int h)
+{
+    Canvas copy(src.width, src.height, src.bpp);
+    memcpy(copy.s.buf, src.buf, (size_t)src.stride * src.height);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            if (copy.s.contains(sx + x, sy + y) && dst.contains(dx + x, dy + y))
+                dst.set(dx + x, dy + y, copy.s.get(sx + x, sy + y));
+        }
+}
+
+static void assertSame(const Canvas &expected, const Canvas &actual)
+{
+    TEST_ASSERT_EQUAL(expected.data.size(), actual.data.size());
+    TEST_ASSERT_EQUAL_MEMORY(expected.data.data(), actual.data.data(), expected.data.size());
+}
+
+static const int DEPTHS[] = {1, 2, 4, 8, 16, 24};
+
+void test_fill_matches_reference(void)
+{
+    // two colours of noise make ragged, concave regions that catch span leaks
+    for (int bpp : DEPTHS)
+    {
+        for (unsigned seed = 1; seed <= 20; seed++)
+        {
+            Canvas c(37, 23, bpp);
+            randomize(c, seed, 2);
+            Canvas expected(c);
+            int x = seed % 37, y = seed % 23;
+            uint32_t fill = bpp == 1 ? 1 - c.s.get(x, y) : 3;
+            uint32_t want = referenceFill(expected.s, x, y, fill);
+            TEST_ASSERT_EQUAL(want, UI::Raster::floodFill(c.s, x, y, fill));
+            assertSame(expected, c);
+        }
+    }
+}
+
+void test_fill_stays_inside_a_spiral(void)
+{
+    // a one pixel wide spiral corridor: every turn needs the span pushed back up
+    Canvas c(41, 41, 4);
+    for (int ring = 0; ring < 10; ring++)
+    {
+        int lo = ring * 2, hi = 40 - ring * 2;
+        for (int i = lo; i <= hi; i++)
+        {
+            c.s.set(i, lo, 1);
+            c.s.set(i, hi, 1);
+            c.s.set(lo, i, 1);
+            c.s.set(hi, i, 1);
+        }
+        c.s.set(lo, lo + 1, 0); // the door into the next ring
+    }
+    Canvas expected(c);
+    uint32_t want = referenceFill(expected.s, 20, 20, 7);
+    TEST_ASSERT_EQUAL(want, UI::Raster::floodFill(c.s, 20, 20, 7));
+    assertSame(expected, c);
+}
+
+void test_fill_ignores_same_colour_and_outside_seeds(void)
+{
+    Canvas c(8, 8, 16);
+    TEST_ASSERT_EQUAL(0, UI::Raster::floodFill(c.s, 3, 3, 0));
+    TEST_ASSERT_EQUAL(0, UI::Raster::floodFill(c.s, -1, 3, 5));
+    TEST_ASSERT_EQUAL(0, UI::Raster::floodFill(c.s, 3, 8, 5));
+    TEST_ASSERT_EQUAL(64, UI::Raster::floodFill(c.s, 3, 3, 5));
+}
+
+void test_blit_overlapping_in_every_direction(void)
+{
+    static const int OFFSETS[][2] = {{3, 0}, {-3, 0}, {0, 2}, {0, -2}, {5, 3}, {-5, -3}, {1, -1}, {-7, 2}};
+    for (int bpp : DEPTHS)
+    {
+        for (const auto &o : OFFSETS)
+        {
+            // sx = 2 puts the source and destination at different bit offsets within a byte
+            for (int sx = 2; sx <= 8; sx += 6)
+            {
+                Canvas c(29, 13, bpp);
+                randomize(c, bpp * 100 + o[0] * 10 + o[1], bpp >= 8 ? 250 : 1 << bpp);
+                Canvas expected(c);
+                referenceBlit(expected.s, sx + o[0], 3 + o[1], expected.s, sx, 3, 17, 8);
+                TEST_ASSERT_TRUE(UI::Raster::blit(c.s, sx + o[0], 3 + o[1], c.s, sx, 3, 17, 8));
+                assertSame(expected, c);
+            }
+        }
+    }
+}
+
+void test_blit_between_surfaces_is_clipped(void)
+{
+    for (int bpp : DEPTHS)
+    {
+        Canvas src(10, 10, bpp), dst(12, 6, bpp);
+        randomize(src, bpp, bpp >= 8 ? 250 : 1 << bpp);
+        Canvas expected(dst);
+        referenceBlit(expected.s, 7, -2, src.s, -1, 1, 9, 9);
+        TEST_ASSERT_TRUE(UI::Raster::blit(dst.s, 7, -2, src.s, -1, 1, 9, 9));
+        assertSame(expected, dst);
+    }
+
+    Canvas a(4, 4, 8), b(4, 4, 16);
+    TEST_ASSERT_FALSE(UI::Raster::blit(a.s, 0, 0, b.s, 0, 0, 4, 4));
+}
+
+void test_scroll_fills_exposed_area(void)
+{
+    static const int SHIFTS[][2] = {{3, 0}, {-3, 0}, {0, 2}, {0, -2}, {2, -1}, {-1, 3}};
+    for (int bpp : DEPTHS)
+    {
+        for (const auto &d : SHIFTS)
+        {
+            Canvas c(19, 9, bpp);
+            randomize(c, bpp + d[0] * 7 + d[1], bpp >= 8 ? 250 : 1 << bpp);
+            Canvas expected(c);
+            referenceBlit(expected.s, d[0], d[1], expected.s, 0, 0, 19, 9);
+            for (int y = 0; y < 9; y++)
+                for (int x = 0; x < 19; x++)
+                {
+                    bool exposed = x - d[0] < 0 || x - d[0] >= 19 || y - d[1] < 0 || y - d[1] >= 9;
+                    if (exposed)
+                        expected.s.set(x, y, 1);
+                }
+            UI::Raster::scroll(c.s, d[0], d[1], 1);
+            assertSame(expected, c);
+        }
+    }
+}
+
+// The fill ui.canvas_flood_fill used before: one readPixel/drawPixel per
+// pixel and per neighbour. Surface::get/set stand in for the sprite calls, so
+// this is a lower bound of the old cost (no LovyanGFX call overhead).
+static uint32_t perPixelFill(const Surface &s, int fx, int fy, uint32_t fillRaw)
+{
+    uint32_t target = s.get(fx, fy);
+    if (target == fillRaw)
+        return 0;
+    struct Seed
+    {
+        int16_t x, y;
+    };
+    std::vector<Seed> stack = {{(int16_t)fx, (int16_t)fy}};
+    uint32_t filled = 0;
+    while (!stack.empty())
+    {
+        Seed seed = stack.back();
+        stack.pop_back();
+        if (s.get(seed.x, seed.y) != target)
+            continue;
+        int left = seed.x;
+        while (left > 0 && s.get(left - 1, seed.y) == target)
+            left--;
+        bool aboveQ = false, belowQ = false;
+        for (int right = left; right < s.width && s.get(right, seed.y) == target; right++)
+        {
+            s.set(right, seed.y, fillRaw);
+            filled++;
+            if (seed.y > 0)
+            {
+                bool m = s.get(right, seed.y - 1) == target;
+                if (m && !aboveQ)
+                    stack.push_back({(int16_t)right, (int16_t)(seed.y - 1)});
+                aboveQ = m;
+            }
+            if (seed.y < s.height - 1)
+            {
+                bool m = s.get(right, seed.y + 1) == target;
+                if (m && !belowQ)
+                    stack.push_back({(int16_t)right, (int16_t)(seed.y + 1)});
+                belowQ = m;
+            }
+        }
+    }
+    return filled;
+}
+
+void test_benchmark_fill(void)
+{
+    // a full-window 16-bit canvas, empty and with a grid of obstacles
+    const int ROUNDS = 50;
+    for (int pattern = 0; pattern < 2; pattern++)
+    {
+        Canvas base(320, 240, 16);
+        if (pattern == 1)
+        {
+            for (int y = 0; y < 240; y += 8)
+                for (int x = (y / 8) % 2 * 4; x < 320; x += 8)
+                    base.s.fillSpan(x, x + 2, y, 0xFFFF);
+        }
+
+        uint32_t spans = 0, pixels = 0;
+        double spanUs = 0, pixelUs = 0;
+        for (int r = 0; r < ROUNDS; r++)
+        {
+            Canvas a(base), b(base);
+            auto t0 = std::chrono::steady_clock::now();
+            spans = UI::Raster::floodFill(a.s, 1, 1, 0x1234);
+            auto t1 = std::chrono::steady_clock::now();
+            pixels = perPixelFill(b.s, 1, 1, 0x1234);
+            auto t2 = std::chrono::steady_clock::now();
+            spanUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            pixelUs += std::chrono::duration<double, std::micro>(t2 - t1).count();
+            assertSame(b, a);
+        }
+        TEST_ASSERT_EQUAL(pixels, spans);
+
+        char msg[160];
+        snprintf(msg, sizeof(msg), "320x240 %-5s %6u px: span fill %.0f us, per-pixel fill %.0f us",
+                 pattern == 0 ? "empty" : "grid", (unsigned)spans, spanUs / ROUNDS, pixelUs / ROUNDS);
+        TEST_MESSAGE(msg);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fill_matches_reference);
+    RUN_TEST(test_fill_stays_inside_a_spiral);
+    RUN_TEST(test_fill_ignores_same_colour_and_outside_seeds);
+    RUN_TEST(test_blit_overlapping_in_every_direction);
+    RUN_TEST(test_blit_between_surfaces_is_clipped);
+    RUN_TEST(test_scroll_fills_exposed_area);
+    RUN_TEST(test_benchmark_fill);
+    UNITY_END();
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <unity.h>
+#include "../../src/ActionRegistry/RestArgs.h"
+
+static std::string fromQuery(const char *query)
+{
+    std::string command = "action";
+    appendQueryArgs(command, query);
+    return command;
+}
+
+void test_quote_round_trips(void)
+{
+    const char *words[] = {"plain", "two words", "", "say \"hi\"", "back\\slash", "it's"};
+    std::string command = "action";
+    for (const char *word : words)
+        command += ' ' + CommandArgs::quote(word);
+
+    CommandArgs args(command);
+    TEST_ASSERT_EQUAL(7, args.size());
+    for (size_t i = 0; i < 6; i++)
+        TEST_ASSERT_EQUAL_STRING(words[i], args.str(i + 1).c_str());
+    TEST_ASSERT_EQUAL_STRING("plain", CommandArgs::quote("plain").c_str());
+}
+
+void test_query_words_and_options(void)
+{
+    TEST_ASSERT_EQUAL_STRING("action read from=1700000000 format=text",
+                             fromQuery("read&from=1700000000&format=text").c_str());
+    TEST_ASSERT_EQUAL_STRING("action /flash/a.txt limit=5", fromQuery("%2Fflash%2Fa.txt&&limit=5").c_str());
+    TEST_ASSERT_EQUAL_STRING("action", fromQuery("").c_str());
+}
+
+void test_query_args_are_command_text(void)
+{
+    CommandArgs args(fromQuery("args=read%200x3c%202&note=a+b"));
+    TEST_ASSERT_EQUAL(5, args.size());
+    TEST_ASSERT_EQUAL_STRING("read", args.str(1).c_str());
+    TEST_ASSERT_EQUAL(0x3c, args.toInt(2));
+    TEST_ASSERT_EQUAL(2, args.toInt(3));
+    TEST_ASSERT_EQUAL_STRING("note=a b", args.str(4).c_str());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_quote_round_trips);
+    RUN_TEST(test_query_words_and_options);
+    RUN_TEST(test_query_args_are_command_text);
+    UNITY_END();
+    return 0;
+}